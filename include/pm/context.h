@@ -0,0 +1,113 @@
+#ifndef PM_CONTEXT_H_
+#define PM_CONTEXT_H_
+
+#include <stddef.h>
+
+#include <pm/pm.h>
+
+/*
+ * An independent monitor. Every context has its own targets, output and
+ * threads so several of them can run at the same time, each driven from
+ * one thread. The functions in pm.h work on a default context.
+ */
+struct pm_context;
+
+/*
+ * One sampled row. The values stay valid until the next pm_sample. The
+ * elapsed time is in ms, or in us with pm_context_set_microseconds.
+ */
+struct pm_sample {
+  long long time;
+  unsigned long long elapsed;
+  long long count;
+  size_t columns;
+  const unsigned long long* values;
+};
+
+/*
+ * A summary of one column over a window of the rows kept in memory, from
+ * and to being the elapsed time of the first and last row in the window.
+ */
+struct pm_window {
+  size_t count;
+  unsigned long long from;
+  unsigned long long to;
+  unsigned long long min;
+  unsigned long long max;
+  unsigned long long last;
+  double mean;
+};
+
+/*
+ * A sink is called on the sampling thread with every row instead of
+ * writing an output file. A nonzero return makes pm_sample fail.
+ */
+typedef int (*pm_sink)(const struct pm_sample* sample, void* user);
+
+struct pm_context* pm_create();
+void pm_destroy(struct pm_context* context);
+
+ int pm_context_add_ids(struct pm_context* context, char* ids);
+ int pm_context_add_names(struct pm_context* context, char* names);
+ int pm_context_add_trees(struct pm_context* context, char* roots);
+ int pm_context_set_types(struct pm_context* context, char* types);
+ int pm_context_set_format(struct pm_context* context, char* format);
+ int pm_context_set_output(struct pm_context* context, char* filename);
+ int pm_context_set_flush(struct pm_context* context, char* policy);
+ int pm_context_set_queue(struct pm_context* context, char* size);
+ int pm_context_set_capacity(struct pm_context* context, char* processes);
+ int pm_context_set_threads(struct pm_context* context, char* threads);
+ int pm_context_set_sink(struct pm_context* context, pm_sink sink, void* user);
+ int pm_context_set_retention(struct pm_context* context, char* rows);
+ int pm_context_set_rollup(struct pm_context* context, char* window);
+ int pm_context_set_top(struct pm_context* context, char* count);
+ int pm_context_set_by(struct pm_context* context, char* type);
+ int pm_context_set_self_stats(struct pm_context* context, int enabled);
+ int pm_context_set_microseconds(struct pm_context* context, int enabled);
+ int pm_context_set_trace(struct pm_context* context, char* filename);
+ int pm_context_set_procfs(struct pm_context* context, char* root);
+ int pm_context_set_cadence(struct pm_context* context, char* ticks);
+ int pm_context_set_adaptive(struct pm_context* context, char* ticks);
+ int pm_context_add_rules(struct pm_context* context, char* rules);
+ int pm_context_set_events(struct pm_context* context, char* filename);
+ int pm_context_set_listen(struct pm_context* context, char* address);
+ int pm_context_set_share(struct pm_context* context, char* name);
+
+ int pm_context_init(struct pm_context* context);
+void pm_context_start(struct pm_context* context);
+ int pm_sample(struct pm_context* context, struct pm_sample* sample);
+void pm_context_stop(struct pm_context* context);
+
+size_t pm_context_column_count(const struct pm_context* context);
+ int pm_context_column_name(
+  const struct pm_context* context,
+  size_t column,
+  char* name,
+  size_t size);
+
+/*
+ * Summarize a column over the last window ms of kept rows, or over all of
+ * them when window is zero. Call from the thread calling pm_sample.
+ */
+ int pm_query(
+  const struct pm_context* context,
+  size_t column,
+  unsigned long long window,
+  struct pm_window* result);
+
+void pm_context_report(const struct pm_context* context);
+
+void pm_context_get_syscall_count(
+  const struct pm_context* context,
+  struct pm_syscall_count* count);
+void pm_context_get_writer_count(
+  const struct pm_context* context,
+  struct pm_writer_count* count);
+void pm_context_get_sampler_count(
+  const struct pm_context* context,
+  struct pm_sampler_count* count);
+void pm_context_get_memory_count(
+  const struct pm_context* context,
+  struct pm_memory_count* count);
+
+#endif
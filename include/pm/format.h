@@ -0,0 +1,78 @@
+#ifndef PM_FORMAT_H_
+#define PM_FORMAT_H_
+
+/* The us in one unit of the elapsed time of a row, in files from version 3 */
+#define PM_FORMAT_UNIT_MS 1000
+#define PM_FORMAT_UNIT_US 1
+
+/*
+ * The binary output file. All numbers are little endian.
+ *
+ *   0  magic "PMBN"
+ *   4  u32 version
+ *   8  u32 header size, the offset of the first record
+ *  12  u32 record size
+ *  16  u32 target count
+ *  20  u32 type count
+ *  24  u64 record count, updated after every record
+ *  32  u32 type for each type
+ *      u32 length and the characters for each target name
+ *      u32 extra column count
+ *      u32 length and the characters for each extra column name
+ *      u32 elapsed time unit, PM_FORMAT_UNIT_MS or PM_FORMAT_UNIT_US
+ *      zero padding up to the header size
+ *
+ * Each record is the i64 UTC time in seconds, the u64 elapsed time in the
+ * unit, always ms before version 3, one u64 value for each target and
+ * type, target major, one u64 value for each extra column and the i64
+ * process count. The extra columns are the member counts of the process
+ * trees.
+ */
+
+#define PM_FORMAT_MAGIC "PMBN"
+#define PM_FORMAT_MAGIC_SIZE 4
+#define PM_FORMAT_VERSION 3
+
+#define PM_FORMAT_OFFSET_VERSION 4
+#define PM_FORMAT_OFFSET_HEADER_SIZE 8
+#define PM_FORMAT_OFFSET_RECORD_SIZE 12
+#define PM_FORMAT_OFFSET_TARGET_COUNT 16
+#define PM_FORMAT_OFFSET_TYPE_COUNT 20
+#define PM_FORMAT_OFFSET_RECORD_COUNT 24
+#define PM_FORMAT_FIXED_HEADER_SIZE 32
+
+#define PM_FORMAT_ALIGNMENT 8
+#define PM_FORMAT_RECORD_FIXED_COUNT 3
+#define PM_FORMAT_RECORD_SIZE(columns) \
+  (8 * ((columns) + PM_FORMAT_RECORD_FIXED_COUNT))
+
+/*
+ * The packed output file. All numbers are little endian.
+ *
+ *   0  magic "PMPK"
+ *   4  u32 version
+ *   8  u32 target count
+ *  12  u32 type count
+ *  16  u32 type for each type
+ *      u32 length and the characters for each target name
+ *      u32 extra column count
+ *      u32 length and the characters for each extra column name
+ *      u32 elapsed time unit as in the binary file, from version 3
+ *
+ * The header is followed by blocks that can each be decoded on their own.
+ * A block is its u32 payload size and u32 row count followed by the
+ * payload. The payload starts with the first row as in a binary record
+ * and is followed by a bit stream of the other rows, see pm/pack.h.
+ */
+
+#define PM_PACK_MAGIC "PMPK"
+#define PM_PACK_MAGIC_SIZE 4
+#define PM_PACK_VERSION 3
+
+#define PM_PACK_OFFSET_VERSION 4
+#define PM_PACK_OFFSET_TARGET_COUNT 8
+#define PM_PACK_OFFSET_TYPE_COUNT 12
+#define PM_PACK_FIXED_HEADER_SIZE 16
+#define PM_PACK_BLOCK_HEADER_SIZE 8
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef PM_PACK_H_
+#define PM_PACK_H_
+
+#include <stddef.h>
+
+/*
+ * The block codec of the packed format. After the first row of a block
+ * the time and the elapsed time are stored as the delta of their delta
+ * and every value and the process count as the zig-zag delta from the row
+ * before. A delta of delta is a 0 bit for zero, otherwise 10, 110 or 1110
+ * with 7, 9 or 12 bits or 1111 with 64 bits of the zig-zag value. A delta
+ * is a 0 bit for zero, otherwise 10 with its bits in the leading and
+ * trailing zero window of the previous delta of the column, or 11 with 6
+ * bits of leading zeros, 6 bits of the bit count less one and the bits.
+ * Bits are stored from the most significant bit of each byte.
+ */
+#define PM_PACK_BLOCK_ROWS 1024
+
+/* The window state of the columns of a block, for the encoder and decoder */
+#define PM_PACK_WINDOW_SIZE(columns) (2 * ((columns) + 1))
+
+struct pm_pack_encoder {
+  unsigned char* buffer;
+  size_t capacity;
+  size_t position;
+  size_t columns;
+  size_t rows;
+  unsigned long long bits;
+  unsigned int fill;
+  long long time;
+  long long timedelta;
+  unsigned long long elapsed;
+  unsigned long long elapseddelta;
+  unsigned long long* previous;
+  unsigned char* window;
+};
+
+/*
+ * The encoder works in memory of pm_pack_encoder_bytes for its columns
+ * that the caller provides and keeps until the encoder is destroyed.
+ */
+ int pm_pack_encoder_create(
+  struct pm_pack_encoder* encoder,
+  size_t columns,
+  void* memory);
+void pm_pack_encoder_destroy(struct pm_pack_encoder* encoder);
+
+size_t pm_pack_encoder_bytes(size_t columns);
+
+/* Add a row to the block, which holds at most PM_PACK_BLOCK_ROWS rows */
+ int pm_pack_encoder_add(
+  struct pm_pack_encoder* encoder,
+  long long time,
+  unsigned long long elapsed,
+  const unsigned long long* values,
+  long long count);
+
+/*
+ * Complete the block and return it with its block header. The encoder is
+ * empty again once the block has been used.
+ */
+const unsigned char* pm_pack_encoder_finish(
+  struct pm_pack_encoder* encoder,
+  size_t* size);
+void pm_pack_encoder_clear(struct pm_pack_encoder* encoder);
+
+/*
+ * Decode the payload of a block of rows rows. The values are row major
+ * with columns values for each row. The window is PM_PACK_WINDOW_SIZE of
+ * the columns bytes the caller keeps for every block it decodes.
+ */
+ int pm_pack_decode(
+  const unsigned char* payload,
+  size_t size,
+  size_t rows,
+  size_t columns,
+  unsigned char* window,
+  long long* time,
+  unsigned long long* elapsed,
+  unsigned long long* values,
+  long long* count);
+
+#endif
@@ -1,9 +1,17 @@
 #ifndef PM_H_
 #define PM_H_
 
-#define PM_TYPE_COUNT 9
+#include <stddef.h>
+
+#define PM_TYPE_COUNT 16
 #define PM_TYPE_DEFAULT_INDEX 2
 
+#define PM_COST_CHEAP 0
+#define PM_COST_EXPENSIVE 1
+
+/* The age of a target whose expensive types were not read yet */
+#define PM_AGE_NEVER 18446744073709551615ULL
+
 enum Pm_Type {
   PM_TYPE_UNDEFINED,
   PM_TYPE_PAGE_FAULT_COUNT,
@@ -15,22 +23,94 @@ enum Pm_Type {
   PM_TYPE_QUOTA_NON_PAGED_POOL_USAGE,
   PM_TYPE_PAGEFILE_USAGE,
   PM_TYPE_PEAK_PAGEFILE_USAGE,
+  PM_TYPE_CPU_USAGE,
+  PM_TYPE_READ_BYTES,
+  PM_TYPE_WRITE_BYTES,
+  PM_TYPE_DESCRIPTOR_COUNT,
+  PM_TYPE_THREAD_COUNT,
+  PM_TYPE_PROPORTIONAL_SET_SIZE,
+  PM_TYPE_UNIQUE_SET_SIZE,
   PM_TYPE_UNKNOWN
 };
 
+/*
+ * A type with its long and short name. Cheap types are read on every tick
+ * and expensive ones on every cadence ticks, see pm_set_cadence.
+ */
 struct pm_type {
   const char* lt;
   const char* st;
   int type;
+  int cost;
+};
+
+/* System calls made by the sampling backend during the last tick */
+struct pm_syscall_count {
+  unsigned long total;
+  unsigned long reads;
+  unsigned long files;
+};
+
+/* Rows handed from the sampler to the writer thread */
+struct pm_writer_count {
+  unsigned long long written;
+  unsigned long long dropped;
+  unsigned long long flushes;
+  size_t highwater;
+  size_t capacity;
+};
+
+/*
+ * The sampler threads and the time in ns between the first and the last
+ * sample of a tick, for the last tick, the worst tick and summed over all
+ */
+struct pm_sampler_count {
+  unsigned int threads;
+  unsigned long long ticks;
+  unsigned long long stolen;
+  unsigned long long spread;
+  unsigned long long spreadmax;
+  unsigned long long spreadsum;
+};
+
+/*
+ * The arena holding the state sized at init, the processes its tables have
+ * room for and how often a process was left out of a tick as they were
+ * full. Sampling makes no heap allocations.
+ */
+struct pm_memory_count {
+  size_t arena;
+  size_t processes;
+  unsigned long long overflow;
 };
 
 extern struct pm_type pm_type_arr[PM_TYPE_COUNT];
 
  int pm_add_ids(char* ids);
  int pm_add_names(char* names);
+ int pm_add_trees(char* roots);
 
  int pm_set_types(char* types);
+ int pm_set_format(char* format);
  int pm_set_output(char* filename);
+ int pm_set_flush(char* policy);
+ int pm_set_queue(char* size);
+ int pm_set_capacity(char* processes);
+ int pm_set_threads(char* threads);
+ int pm_set_retention(char* rows);
+ int pm_set_rollup(char* window);
+ int pm_set_top(char* count);
+ int pm_set_by(char* type);
+ int pm_set_self_stats(int enabled);
+ int pm_set_microseconds(int enabled);
+ int pm_set_trace(char* filename);
+ int pm_set_procfs(char* root);
+ int pm_set_cadence(char* ticks);
+ int pm_set_adaptive(char* ticks);
+ int pm_add_rules(char* rules);
+ int pm_set_events(char* filename);
+ int pm_set_listen(char* address);
+ int pm_set_share(char* name);
 
  int pm_init();
 void pm_start();
@@ -38,4 +118,9 @@ void pm_start();
  int pm_loop();
 void pm_shutdown();
 
+void pm_get_syscall_count(struct pm_syscall_count* count);
+void pm_get_writer_count(struct pm_writer_count* count);
+void pm_get_sampler_count(struct pm_sampler_count* count);
+void pm_get_memory_count(struct pm_memory_count* count);
+
 #endif
@@ -0,0 +1,123 @@
+#ifndef PM_SHARE_H_
+#define PM_SHARE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define PM_SHARE_MAGIC 0x564d5050U
+#define PM_SHARE_VERSION 1
+#define PM_SHARE_NAME_SIZE 64
+#define PM_SHARE_TYPE_SIZE 16
+
+/* What the extra column of a target holds */
+#define PM_SHARE_EXTRA_NONE 0
+#define PM_SHARE_EXTRA_PID 1
+#define PM_SHARE_EXTRA_MEMBERS 2
+
+/*
+ * The columns of a row as libpm lays them out. The value of target t and
+ * type k is at t * types + k. The extra of target t, its pid in top mode
+ * or its member count for a tree, is at extrastart + t - extrafirst for
+ * the extracount targets from extrafirst. Its age, if any, is at
+ * agestart + t.
+ */
+struct pm_share_layout {
+  size_t targets;
+  size_t types;
+  size_t columns;
+  int extrakind;
+  size_t extrafirst;
+  size_t extrastart;
+  size_t extracount;
+  size_t agestart;
+  size_t agecount;
+};
+
+/*
+ * The start of the segment. The target names, the type names and then the
+ * values of the last row follow it at the offsets. The writer bumps the
+ * sequence to odd, copies the row and bumps it to even, and never waits.
+ * The process ID of the writer tells a segment left by a monitor that
+ * exited without stopping.
+ */
+struct pm_share_header {
+  unsigned int magic;
+  unsigned int version;
+  long long pid;
+  size_t size;
+  struct pm_share_layout layout;
+  size_t nameoffset;
+  size_t typeoffset;
+  size_t valueoffset;
+  size_t sequence;
+  size_t stopped;
+  long long time;
+  unsigned long long elapsed;
+  unsigned long long tick;
+  long long count;
+};
+
+/* A row as the reader copied it */
+struct pm_share_row {
+  size_t sequence;
+  long long time;
+  unsigned long long elapsed;
+  unsigned long long tick;
+  long long count;
+  bool stopped;
+};
+
+struct pm_share {
+  struct pm_share_header* header;
+  char* names;
+  char* types;
+  unsigned long long* values;
+  size_t size;
+  char name[PM_SHARE_NAME_SIZE];
+  bool owner;
+  unsigned long long retries;
+};
+
+void pm_share_reset(struct pm_share* share);
+
+/*
+ * Create the named POSIX shared memory segment for the layout and map it.
+ * A name in use by a running monitor is refused; a segment left by one
+ * that stopped or exited is replaced. The names are then filled through
+ * pm_share_target and pm_share_type before the first row is published.
+ */
+int pm_share_create(
+  struct pm_share* share,
+  const char* name,
+  const struct pm_share_layout* layout);
+char* pm_share_target(struct pm_share* share, size_t target);
+char* pm_share_type(struct pm_share* share, size_t type);
+void pm_share_publish(
+  struct pm_share* share,
+  long long time,
+  unsigned long long elapsed,
+  unsigned long long tick,
+  const unsigned long long* values,
+  long long count);
+
+/* Mark the segment stopped for the readers, unmap and remove it */
+void pm_share_destroy(struct pm_share* share);
+
+/* Map a segment another process created, read only */
+int pm_share_attach(struct pm_share* share, const char* name);
+const struct pm_share_layout* pm_share_get_layout(const struct pm_share* share);
+const char* pm_share_get_target(const struct pm_share* share, size_t target);
+const char* pm_share_get_type(const struct pm_share* share, size_t type);
+
+/*
+ * Copy the last row into the row and the values, sized for the columns of
+ * the layout, without a system call. Fails when the writer kept the row
+ * busy over all the retries.
+ */
+int pm_share_read(
+  struct pm_share* share,
+  struct pm_share_row* row,
+  unsigned long long* values);
+void pm_share_detach(struct pm_share* share);
+
+#endif
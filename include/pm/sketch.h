@@ -0,0 +1,44 @@
+#ifndef PM_SKETCH_H_
+#define PM_SKETCH_H_
+
+#include <stddef.h>
+
+/*
+ * A mergeable quantile sketch with a relative error of at most
+ * PM_SKETCH_ALPHA. Positive values are counted in logarithmic bins, bin
+ * key k holding the values in (gamma^(k-1), gamma^k]. Only PM_SKETCH_BINS
+ * consecutive keys from offset are kept; lower keys are collapsed into the
+ * first bin so the high quantiles stay accurate.
+ */
+#define PM_SKETCH_ALPHA 0.02
+#define PM_SKETCH_BINS 128
+
+/* Room for the text of a full sketch */
+#define PM_SKETCH_TEXT_SIZE (PM_SKETCH_BINS * 11 + 128)
+
+struct pm_sketch {
+  unsigned long long count;
+  unsigned long long zeros;
+  unsigned long long min;
+  unsigned long long max;
+  unsigned long long sum;
+  int offset;
+  unsigned int bins[PM_SKETCH_BINS];
+};
+
+void pm_sketch_reset(struct pm_sketch* sketch);
+void pm_sketch_add(struct pm_sketch* sketch, unsigned long long value);
+void pm_sketch_merge(struct pm_sketch* sketch, const struct pm_sketch* other);
+
+unsigned long long pm_sketch_quantile(
+  const struct pm_sketch* sketch,
+  double quantile);
+
+/*
+ * The text form is the count, min, max, sum, zero count, offset and the
+ * bins up to the last one used, separated by spaces.
+ */
+ int pm_sketch_format(const struct pm_sketch* sketch, char* text, size_t size);
+ int pm_sketch_parse(struct pm_sketch* sketch, const char* text);
+
+#endif
@@ -0,0 +1,47 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "arena.h"
+
+void pm_arena_reset(struct pm_arena* arena) {
+  memset(arena, 0x00, sizeof(struct pm_arena));
+}
+
+int pm_arena_create(struct pm_arena* arena, size_t size) {
+  pm_arena_reset(arena);
+  if (size == 0) {
+    return EXIT_SUCCESS;
+  }
+  /* Allocated with room to align the first part */
+  arena->base = (unsigned char*)(calloc(1, size + PM_ARENA_ALIGNMENT));
+  if (arena->base == NULL) {
+    return EXIT_FAILURE;
+  }
+  arena->size = size + PM_ARENA_ALIGNMENT;
+  arena->used = (PM_ARENA_ALIGNMENT -
+    (size_t)(arena->base) % PM_ARENA_ALIGNMENT) % PM_ARENA_ALIGNMENT;
+  return EXIT_SUCCESS;
+}
+
+void pm_arena_destroy(struct pm_arena* arena) {
+  free(arena->base);
+  pm_arena_reset(arena);
+}
+
+/* The room a part of size bytes takes in the arena */
+size_t pm_arena_size(size_t size) {
+  return (size + PM_ARENA_ALIGNMENT - 1) / PM_ARENA_ALIGNMENT *
+    PM_ARENA_ALIGNMENT;
+}
+
+/* Zeroed memory, or NULL when the arena was sized too small */
+void* pm_arena_alloc(struct pm_arena* arena, size_t size) {
+  void* p;
+  size = pm_arena_size(size);
+  if (size == 0 || arena->base == NULL || arena->used + size > arena->size) {
+    return NULL;
+  }
+  p = arena->base + arena->used;
+  arena->used += size;
+  return p;
+}
@@ -0,0 +1,27 @@
+#ifndef PM_ARENA_H_
+#define PM_ARENA_H_
+
+#include <stddef.h>
+
+#define PM_ARENA_ALIGNMENT 64
+
+/*
+ * One block holding the memory whose size is fixed once a context has been
+ * initialized. It is sized up front from the sum of pm_arena_size for each
+ * part, carved in order with pm_arena_alloc and released as a whole.
+ * Every part starts on its own cache line.
+ */
+struct pm_arena {
+  unsigned char* base;
+  size_t size;
+  size_t used;
+};
+
+void pm_arena_reset(struct pm_arena* arena);
+ int pm_arena_create(struct pm_arena* arena, size_t size);
+void pm_arena_destroy(struct pm_arena* arena);
+
+size_t pm_arena_size(size_t size);
+void* pm_arena_alloc(struct pm_arena* arena, size_t size);
+
+#endif
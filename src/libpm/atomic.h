@@ -0,0 +1,26 @@
+#ifndef PM_ATOMIC_H_
+#define PM_ATOMIC_H_
+
+/*
+ * Acquire loads and release stores for indexes shared between threads.
+ * Aligned volatile accesses have these semantics with MSVC on x86 and x64.
+ * PM_FETCH_ADD adds to a size_t and returns the value before the add; with
+ * MSVC it needs windows.h and a 64 bit size_t. The fences order the plain
+ * accesses around them, as a seqlock needs for the data it guards.
+ */
+#ifdef _MSC_VER
+#define PM_LOAD_ACQUIRE(p) (*(volatile size_t*)(p))
+#define PM_STORE_RELEASE(p, v) (*(volatile size_t*)(p) = (v))
+#define PM_FETCH_ADD(p, v) \
+  ((size_t)(InterlockedExchangeAdd64((volatile LONG64*)(p), (LONG64)(v))))
+#define PM_FENCE_ACQUIRE() MemoryBarrier()
+#define PM_FENCE_RELEASE() MemoryBarrier()
+#else
+#define PM_LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define PM_STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define PM_FETCH_ADD(p, v) __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+#define PM_FENCE_ACQUIRE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define PM_FENCE_RELEASE() __atomic_thread_fence(__ATOMIC_RELEASE)
+#endif
+
+#endif
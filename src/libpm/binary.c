@@ -0,0 +1,265 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+#include "binary.h"
+
+#define PM_BINARY_INITIAL_SIZE 0x100000
+
+static int pm_binary_map(struct pm_binary* binary, size_t size);
+static void pm_binary_unmap(struct pm_binary* binary);
+static int pm_binary_reserve(struct pm_binary* binary, size_t size);
+static void pm_binary_store32(unsigned char* p, unsigned int value);
+static void pm_binary_store64(unsigned char* p, unsigned long long value);
+
+int pm_binary_open(struct pm_binary* binary, const char* filename) {
+  memset(binary, 0x00, sizeof(struct pm_binary));
+#ifdef _WIN32
+  binary->mapping = NULL;
+  binary->file = CreateFileA(
+    filename,
+    GENERIC_READ | GENERIC_WRITE,
+    FILE_SHARE_READ,
+    NULL,
+    CREATE_ALWAYS,
+    FILE_ATTRIBUTE_NORMAL,
+    NULL);
+  if (binary->file == INVALID_HANDLE_VALUE) {
+    return EXIT_FAILURE;
+  }
+#else
+  binary->fd = open(
+    filename,
+    O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+    S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (binary->fd < 0) {
+    return EXIT_FAILURE;
+  }
+#endif
+  if (pm_binary_map(binary, PM_BINARY_INITIAL_SIZE) != EXIT_SUCCESS) {
+    pm_binary_close(binary);
+    return EXIT_FAILURE;
+  }
+  memcpy(binary->base, PM_FORMAT_MAGIC, PM_FORMAT_MAGIC_SIZE);
+  pm_binary_store32(binary->base + PM_FORMAT_OFFSET_VERSION, PM_FORMAT_VERSION);
+  binary->position = PM_FORMAT_FIXED_HEADER_SIZE;
+  return EXIT_SUCCESS;
+}
+
+int pm_binary_header(
+  struct pm_binary* binary,
+  const int* types,
+  size_t typecount,
+  size_t targetcount) {
+  size_t k;
+  binary->columns = typecount * targetcount;
+  binary->recordsize = PM_FORMAT_RECORD_SIZE(binary->columns);
+  pm_binary_store32(
+    binary->base + PM_FORMAT_OFFSET_RECORD_SIZE,
+    (unsigned int)(binary->recordsize));
+  pm_binary_store32(
+    binary->base + PM_FORMAT_OFFSET_TARGET_COUNT,
+    (unsigned int)(targetcount));
+  pm_binary_store32(
+    binary->base + PM_FORMAT_OFFSET_TYPE_COUNT,
+    (unsigned int)(typecount));
+  if (pm_binary_reserve(binary, 4 * typecount) != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+  for (k = 0; k < typecount; ++k) {
+    pm_binary_store32(binary->base + binary->position, (unsigned int)(types[k]));
+    binary->position += 4;
+  }
+  return EXIT_SUCCESS;
+}
+
+int pm_binary_target(struct pm_binary* binary, const char* name) {
+  size_t length = strlen(name);
+  if (pm_binary_reserve(binary, 4 + length) != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+  pm_binary_store32(binary->base + binary->position, (unsigned int)(length));
+  memcpy(binary->base + binary->position + 4, name, length);
+  binary->position += 4 + length;
+  return EXIT_SUCCESS;
+}
+
+/* The count of columns after the target values, each named by a target */
+int pm_binary_extra(struct pm_binary* binary, size_t count) {
+  if (pm_binary_reserve(binary, 4) != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+  binary->columns += count;
+  binary->recordsize = PM_FORMAT_RECORD_SIZE(binary->columns);
+  pm_binary_store32(
+    binary->base + PM_FORMAT_OFFSET_RECORD_SIZE,
+    (unsigned int)(binary->recordsize));
+  pm_binary_store32(binary->base + binary->position, (unsigned int)(count));
+  binary->position += 4;
+  return EXIT_SUCCESS;
+}
+
+/* The unit of the elapsed time, PM_FORMAT_UNIT_MS or PM_FORMAT_UNIT_US */
+int pm_binary_unit(struct pm_binary* binary, unsigned int unit) {
+  if (pm_binary_reserve(binary, 4) != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+  pm_binary_store32(binary->base + binary->position, unit);
+  binary->position += 4;
+  return EXIT_SUCCESS;
+}
+
+int pm_binary_start(struct pm_binary* binary) {
+  size_t padding = (PM_FORMAT_ALIGNMENT -
+    binary->position % PM_FORMAT_ALIGNMENT) % PM_FORMAT_ALIGNMENT;
+  if (pm_binary_reserve(binary, padding) != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+  memset(binary->base + binary->position, 0x00, padding);
+  binary->position += padding;
+  pm_binary_store32(
+    binary->base + PM_FORMAT_OFFSET_HEADER_SIZE,
+    (unsigned int)(binary->position));
+  pm_binary_store64(binary->base + PM_FORMAT_OFFSET_RECORD_COUNT, 0);
+  return EXIT_SUCCESS;
+}
+
+int pm_binary_write(
+  struct pm_binary* binary,
+  long long time,
+  unsigned long long elapsed,
+  const unsigned long long* values,
+  long long count) {
+  unsigned char* p;
+  size_t k;
+  if (pm_binary_reserve(binary, binary->recordsize) != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+  p = binary->base + binary->position;
+  pm_binary_store64(p, (unsigned long long)(time));
+  pm_binary_store64(p + 8, elapsed);
+  p += 16;
+  for (k = 0; k < binary->columns; ++k) {
+    pm_binary_store64(p, values[k]);
+    p += 8;
+  }
+  pm_binary_store64(p, (unsigned long long)(count));
+  binary->position += binary->recordsize;
+  pm_binary_store64(
+    binary->base + PM_FORMAT_OFFSET_RECORD_COUNT,
+    ++binary->records);
+  return EXIT_SUCCESS;
+}
+
+/* Unmap and trim the preallocated tail so the file ends after the last record */
+int pm_binary_close(struct pm_binary* binary) {
+  int result = EXIT_SUCCESS;
+#ifdef _WIN32
+  LARGE_INTEGER end;
+  pm_binary_unmap(binary);
+  if (binary->file != NULL && binary->file != INVALID_HANDLE_VALUE) {
+    end.QuadPart = (LONGLONG)(binary->position);
+    if (!SetFilePointerEx(binary->file, end, NULL, FILE_BEGIN) ||
+      !SetEndOfFile(binary->file)) {
+      result = EXIT_FAILURE;
+    }
+    if (!CloseHandle(binary->file)) {
+      result = EXIT_FAILURE;
+    }
+  }
+  binary->file = NULL;
+#else
+  pm_binary_unmap(binary);
+  if (binary->fd >= 0) {
+    if (ftruncate(binary->fd, (off_t)(binary->position)) != 0) {
+      result = EXIT_FAILURE;
+    }
+    if (close(binary->fd) != 0) {
+      result = EXIT_FAILURE;
+    }
+  }
+  binary->fd = -1;
+#endif
+  return result;
+}
+
+int pm_binary_map(struct pm_binary* binary, size_t size) {
+#ifdef _WIN32
+  binary->mapping = CreateFileMappingA(
+    binary->file,
+    NULL,
+    PAGE_READWRITE,
+    (DWORD)((unsigned long long)(size) >> 32),
+    (DWORD)(size & 0xffffffff),
+    NULL);
+  if (binary->mapping == NULL) {
+    return EXIT_FAILURE;
+  }
+  binary->base = (unsigned char*)(
+    MapViewOfFile(binary->mapping, FILE_MAP_WRITE, 0, 0, size));
+  if (binary->base == NULL) {
+    CloseHandle(binary->mapping);
+    binary->mapping = NULL;
+    return EXIT_FAILURE;
+  }
+#else
+  void* base;
+  if (ftruncate(binary->fd, (off_t)(size)) != 0) {
+    return EXIT_FAILURE;
+  }
+  base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, binary->fd, 0);
+  if (base == MAP_FAILED) {
+    return EXIT_FAILURE;
+  }
+  binary->base = (unsigned char*)(base);
+#endif
+  binary->size = size;
+  return EXIT_SUCCESS;
+}
+
+void pm_binary_unmap(struct pm_binary* binary) {
+  if (binary->base != NULL) {
+#ifdef _WIN32
+    UnmapViewOfFile(binary->base);
+    CloseHandle(binary->mapping);
+    binary->mapping = NULL;
+#else
+    munmap(binary->base, binary->size);
+#endif
+    binary->base = NULL;
+    binary->size = 0;
+  }
+}
+
+/* Make room for size more bytes, doubling the mapped file when needed */
+int pm_binary_reserve(struct pm_binary* binary, size_t size) {
+  size_t grown;
+  if (binary->position + size <= binary->size) {
+    return EXIT_SUCCESS;
+  }
+  grown = binary->size;
+  while (binary->position + size > grown) {
+    grown *= 2;
+  }
+  pm_binary_unmap(binary);
+  return pm_binary_map(binary, grown);
+}
+
+void pm_binary_store32(unsigned char* p, unsigned int value) {
+  p[0] = (unsigned char)(value);
+  p[1] = (unsigned char)(value >> 8);
+  p[2] = (unsigned char)(value >> 16);
+  p[3] = (unsigned char)(value >> 24);
+}
+
+void pm_binary_store64(unsigned char* p, unsigned long long value) {
+  pm_binary_store32(p, (unsigned int)(value));
+  pm_binary_store32(p + 4, (unsigned int)(value >> 32));
+}
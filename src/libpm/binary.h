@@ -0,0 +1,51 @@
+#ifndef PM_BINARY_H_
+#define PM_BINARY_H_
+
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include <pm/format.h>
+
+/*
+ * Writer for the binary output file. The file is preallocated and mapped
+ * into memory so a record is written with plain stores. The mapping is
+ * doubled when it fills up and the file is trimmed to its content when
+ * closed.
+ */
+struct pm_binary {
+#ifdef _WIN32
+  HANDLE file;
+  HANDLE mapping;
+#else
+  int fd;
+#endif
+  unsigned char* base;
+  size_t size;
+  size_t position;
+  size_t columns;
+  size_t recordsize;
+  unsigned long long records;
+};
+
+ int pm_binary_open(struct pm_binary* binary, const char* filename);
+ int pm_binary_header(
+  struct pm_binary* binary,
+  const int* types,
+  size_t typecount,
+  size_t targetcount);
+ int pm_binary_target(struct pm_binary* binary, const char* name);
+ int pm_binary_extra(struct pm_binary* binary, size_t count);
+ int pm_binary_unit(struct pm_binary* binary, unsigned int unit);
+ int pm_binary_start(struct pm_binary* binary);
+ int pm_binary_write(
+  struct pm_binary* binary,
+  long long time,
+  unsigned long long elapsed,
+  const unsigned long long* values,
+  long long count);
+ int pm_binary_close(struct pm_binary* binary);
+
+#endif
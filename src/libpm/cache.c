@@ -0,0 +1,117 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "cache.h"
+
+#define PM_CACHE_GOLDEN 0x9e3779b1u
+
+static size_t pm_cache_home(const struct pm_cache* cache, int pid);
+static size_t pm_cache_slot(const struct pm_cache* cache, int pid);
+static size_t pm_cache_index_size(size_t capacity);
+
+/* The entries and the index are carved as one part of pm_cache_bytes */
+int pm_cache_create(
+  struct pm_cache* cache,
+  size_t capacity,
+  struct pm_arena* arena) {
+  memset(cache, 0x00, sizeof(struct pm_cache));
+  cache->entry = (struct pm_cache_entry*)(
+    pm_arena_alloc(arena, pm_cache_bytes(capacity)));
+  if (cache->entry == NULL) {
+    return EXIT_FAILURE;
+  }
+  cache->index = (int*)(cache->entry + capacity);
+  cache->capacity = capacity;
+  cache->mask = pm_cache_index_size(capacity) - 1;
+  return EXIT_SUCCESS;
+}
+
+void pm_cache_destroy(struct pm_cache* cache) {
+  memset(cache, 0x00, sizeof(struct pm_cache));
+}
+
+/* The index keeps at least half of its slots empty */
+size_t pm_cache_bytes(size_t capacity) {
+  return capacity * sizeof(struct pm_cache_entry) +
+    pm_cache_index_size(capacity) * sizeof(int);
+}
+
+struct pm_cache_entry* pm_cache_find(struct pm_cache* cache, int pid) {
+  int position;
+  if (cache->index == NULL) {
+    return NULL;
+  }
+  position = cache->index[pm_cache_slot(cache, pid)];
+  return position > 0 ? &cache->entry[position - 1] : NULL;
+}
+
+/* The returned entry only has its process ID set */
+struct pm_cache_entry* pm_cache_insert(struct pm_cache* cache, int pid) {
+  size_t slot;
+  if (cache->count == cache->capacity) {
+    return NULL;
+  }
+  slot = pm_cache_slot(cache, pid);
+  cache->index[slot] = (int)(++cache->count);
+  memset(&cache->entry[cache->count - 1], 0x00, sizeof(struct pm_cache_entry));
+  cache->entry[cache->count - 1].pid = pid;
+  return &cache->entry[cache->count - 1];
+}
+
+/*
+ * Remove the entry at a dense position. The last entry takes its place,
+ * so a sweep must look at the same position again. The hash slot is freed
+ * with backward shift deletion so no tombstones are left behind.
+ */
+void pm_cache_remove(struct pm_cache* cache, size_t position) {
+  size_t slot, next, home;
+  int last;
+  slot = pm_cache_slot(cache, cache->entry[position].pid);
+  for (;;) {
+    cache->index[slot] = 0;
+    next = slot;
+    for (;;) {
+      next = (next + 1) & cache->mask;
+      if (cache->index[next] == 0) {
+        goto pm_cache_remove_moved;
+      }
+      home = pm_cache_home(cache, cache->entry[cache->index[next] - 1].pid);
+      if (((next - home) & cache->mask) >= ((next - slot) & cache->mask)) {
+        break;
+      }
+    }
+    cache->index[slot] = cache->index[next];
+    slot = next;
+  }
+
+pm_cache_remove_moved:
+  last = (int)(cache->count--);
+  if ((size_t)(last) != position + 1) {
+    cache->entry[position] = cache->entry[last - 1];
+    cache->index[pm_cache_slot(cache, cache->entry[position].pid)] =
+      (int)(position + 1);
+  }
+}
+
+size_t pm_cache_home(const struct pm_cache* cache, int pid) {
+  return ((unsigned int)(pid) * PM_CACHE_GOLDEN) & cache->mask;
+}
+
+/* The slot holding the process ID, or the empty slot where it belongs */
+size_t pm_cache_slot(const struct pm_cache* cache, int pid) {
+  size_t slot = pm_cache_home(cache, pid);
+  int position;
+  while ((position = cache->index[slot]) != 0 &&
+    cache->entry[position - 1].pid != pid) {
+    slot = (slot + 1) & cache->mask;
+  }
+  return slot;
+}
+
+size_t pm_cache_index_size(size_t capacity) {
+  size_t size = 1;
+  while (size < 2 * capacity) {
+    size <<= 1;
+  }
+  return size;
+}
@@ -0,0 +1,55 @@
+#ifndef PM_CACHE_H_
+#define PM_CACHE_H_
+
+#include <stddef.h>
+
+#include "arena.h"
+
+#ifndef _WIN32
+#include "procfs.h"
+#endif
+
+/*
+ * What is known about a process between ticks. An entry is created the
+ * first time a process ID is enumerated and removed when the process is
+ * no longer enumerated, so names are only resolved for new processes.
+ */
+struct pm_cache_entry {
+  int pid;
+  int parent;
+  int target;
+  int tree;
+  unsigned long long start;
+  unsigned long tick;
+#ifndef _WIN32
+  struct pm_procfs_process process;
+#endif
+};
+
+/*
+ * The entries are kept dense for sweeping and indexed by an open
+ * addressing table of entry positions keyed by process ID. Both are
+ * carved from the arena for a capacity fixed at init and never grow.
+ */
+struct pm_cache {
+  struct pm_cache_entry* entry;
+  size_t count;
+  size_t capacity;
+  int* index;
+  size_t mask;
+};
+
+ int pm_cache_create(
+  struct pm_cache* cache,
+  size_t capacity,
+  struct pm_arena* arena);
+void pm_cache_destroy(struct pm_cache* cache);
+
+size_t pm_cache_bytes(size_t capacity);
+
+struct pm_cache_entry* pm_cache_find(struct pm_cache* cache, int pid);
+/* NULL when the cache holds capacity entries */
+struct pm_cache_entry* pm_cache_insert(struct pm_cache* cache, int pid);
+void pm_cache_remove(struct pm_cache* cache, size_t position);
+
+#endif
@@ -0,0 +1,137 @@
+#include <string.h>
+#include <time.h>
+
+#include "encode.h"
+
+static const char pm_encode_pairs[] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+/* The first is 0 so that 0 has one digit like 1 to 9 */
+static const unsigned long long pm_encode_power[20] = {
+  0ULL,
+  10ULL,
+  100ULL,
+  1000ULL,
+  10000ULL,
+  100000ULL,
+  1000000ULL,
+  10000000ULL,
+  100000000ULL,
+  1000000000ULL,
+  10000000000ULL,
+  100000000000ULL,
+  1000000000000ULL,
+  10000000000000ULL,
+  100000000000000ULL,
+  1000000000000000ULL,
+  10000000000000000ULL,
+  100000000000000000ULL,
+  1000000000000000000ULL,
+  10000000000000000000ULL
+};
+
+static unsigned int pm_encode_digits(unsigned long long value);
+static void pm_encode_stamp(struct pm_encoder* encoder, long long time);
+
+size_t pm_encode_bytes(size_t columns) {
+  return PM_ENCODE_STAMP_SIZE + (columns + 2) * PM_ENCODE_NUMBER_SIZE + 2;
+}
+
+/* The buffer holds pm_encode_bytes for the most columns encoded */
+void pm_encoder_init(struct pm_encoder* encoder, char* buffer) {
+  encoder->buffer = buffer;
+  encoder->second = -1;
+  encoder->stamp[0] = '\0';
+  encoder->stamplength = 0;
+}
+
+size_t pm_encode_row(
+  struct pm_encoder* encoder,
+  long long time,
+  unsigned long long elapsed,
+  const unsigned long long* values,
+  size_t columns,
+  long long count) {
+  char* p = encoder->buffer;
+  size_t k;
+  if (time != encoder->second) {
+    pm_encode_stamp(encoder, time);
+  }
+  memcpy(p, encoder->stamp, encoder->stamplength);
+  p += encoder->stamplength;
+  *p++ = ',';
+  p = pm_encode_number(p, elapsed);
+  for (k = 0; k < columns; ++k) {
+    *p++ = ',';
+    p = pm_encode_number(p, values[k]);
+  }
+  *p++ = ',';
+  if (count < 0) {
+    *p++ = '-';
+    p = pm_encode_number(p, 0ULL - (unsigned long long)(count));
+  } else {
+    p = pm_encode_number(p, (unsigned long long)(count));
+  }
+  *p++ = '\n';
+  return (size_t)(p - encoder->buffer);
+}
+
+/*
+ * The digits are counted up front from the highest set bit, as 1233 / 4096
+ * is just above log10(2), and one compare to a power of ten. They are then
+ * written from the end two at a time.
+ */
+char* pm_encode_number(char* p, unsigned long long value) {
+  char* end = p + pm_encode_digits(value);
+  char* q = end;
+  while (value >= 100) {
+    q -= 2;
+    memcpy(q, &pm_encode_pairs[2 * (value % 100)], 2);
+    value /= 100;
+  }
+  if (value >= 10) {
+    memcpy(q - 2, &pm_encode_pairs[2 * value], 2);
+  } else {
+    q[-1] = (char)('0' + value);
+  }
+  return end;
+}
+
+unsigned int pm_encode_digits(unsigned long long value) {
+  unsigned int bits, t;
+#if defined(__GNUC__) || defined(__clang__)
+  bits = 64 - (unsigned int)(__builtin_clzll(value | 1));
+#else
+  unsigned long long v = value | 1;
+  for (bits = 0; v != 0; v >>= 1) {
+    ++bits;
+  }
+#endif
+  t = (bits * 1233) >> 12;
+  return t + (value >= pm_encode_power[t]);
+}
+
+void pm_encode_stamp(struct pm_encoder* encoder, long long time) {
+  struct tm tsr;
+  time_t t = (time_t)(time);
+#ifdef _WIN32
+  gmtime_s(&tsr, &t);
+#else
+  gmtime_r(&t, &tsr);
+#endif
+  encoder->stamplength = strftime(
+    encoder->stamp,
+    PM_ENCODE_STAMP_SIZE,
+    "%y-%m-%d,%H:%M:%S",
+    &tsr);
+  encoder->second = time;
+}
@@ -0,0 +1,42 @@
+#ifndef PM_ENCODE_H_
+#define PM_ENCODE_H_
+
+#include <stddef.h>
+
+#define PM_ENCODE_STAMP_SIZE 32
+#define PM_ENCODE_NUMBER_SIZE 21
+
+/*
+ * Builds csv rows in one buffer that is written as a whole. The date and
+ * time prefix is formatted only when the second changes, which at short
+ * intervals is once for many rows, and the numbers are converted two
+ * digits at a time from a table instead of through printf.
+ */
+struct pm_encoder {
+  char* buffer;
+  long long second;
+  char stamp[PM_ENCODE_STAMP_SIZE];
+  size_t stamplength;
+};
+
+/* The buffer size a row of columns values can take at most */
+size_t pm_encode_bytes(size_t columns);
+
+void pm_encoder_init(struct pm_encoder* encoder, char* buffer);
+
+/*
+ * Encode a row as date,time,elapsed,values...,count and a newline. Returns
+ * the length of the row in the encoder buffer.
+ */
+size_t pm_encode_row(
+  struct pm_encoder* encoder,
+  long long time,
+  unsigned long long elapsed,
+  const unsigned long long* values,
+  size_t columns,
+  long long count);
+
+/* Write the decimal digits of value at p and return the end of them */
+char* pm_encode_number(char* p, unsigned long long value);
+
+#endif
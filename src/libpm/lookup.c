@@ -0,0 +1,175 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "lookup.h"
+
+#define PM_LOOKUP_MINIMUM_SIZE 16
+
+#define PM_LOOKUP_FNV_OFFSET 2166136261u
+#define PM_LOOKUP_FNV_PRIME 16777619u
+#define PM_LOOKUP_GOLDEN 0x9e3779b1u
+
+static size_t pm_lookup_size(size_t count);
+static unsigned int pm_lookup_hash_id(int id);
+static unsigned int pm_lookup_hash_name(const char* name);
+
+/* The room a table for count entries takes in the arena */
+size_t pm_lookup_bytes(size_t count) {
+  return pm_arena_size(pm_lookup_size(count) * sizeof(struct pm_lookup_slot));
+}
+
+int pm_lookup_create(
+  struct pm_lookup* lookup,
+  size_t count,
+  struct pm_arena* arena) {
+  size_t size = pm_lookup_size(count);
+  lookup->slot = (struct pm_lookup_slot*)(
+    pm_arena_alloc(arena, size * sizeof(struct pm_lookup_slot)));
+  if (lookup->slot == NULL) {
+    lookup->mask = 0;
+    return EXIT_FAILURE;
+  }
+  lookup->mask = size - 1;
+  return EXIT_SUCCESS;
+}
+
+void pm_lookup_destroy(struct pm_lookup* lookup) {
+  lookup->slot = NULL;
+  lookup->mask = 0;
+}
+
+/* The first index added for an ID is kept, as the linear scan did */
+int pm_lookup_add_id(struct pm_lookup* lookup, int id, int index) {
+  struct pm_lookup_slot* slot;
+  size_t position = pm_lookup_hash_id(id) & lookup->mask;
+  for (;;) {
+    slot = &lookup->slot[position];
+    if (slot->index == 0) {
+      slot->id = id;
+      slot->index = index + 1;
+      return EXIT_SUCCESS;
+    }
+    if (slot->id == id) {
+      return EXIT_SUCCESS;
+    }
+    position = (position + 1) & lookup->mask;
+  }
+}
+
+int pm_lookup_add_name(struct pm_lookup* lookup, const char* name, int index) {
+  struct pm_lookup_slot* slot;
+  unsigned int hash = pm_lookup_hash_name(name);
+  size_t position = hash & lookup->mask;
+  for (;;) {
+    slot = &lookup->slot[position];
+    if (slot->index == 0) {
+      slot->hash = hash;
+      slot->name = name;
+      slot->index = index + 1;
+      return EXIT_SUCCESS;
+    }
+    if (slot->hash == hash && strcmp(slot->name, name) == 0) {
+      return EXIT_SUCCESS;
+    }
+    position = (position + 1) & lookup->mask;
+  }
+}
+
+int pm_lookup_id(const struct pm_lookup* lookup, int id) {
+  const struct pm_lookup_slot* slot;
+  size_t position;
+  if (lookup->slot == NULL) {
+    return -1;
+  }
+  position = pm_lookup_hash_id(id) & lookup->mask;
+  for (;;) {
+    slot = &lookup->slot[position];
+    if (slot->index == 0) {
+      return -1;
+    }
+    if (slot->id == id) {
+      return slot->index - 1;
+    }
+    position = (position + 1) & lookup->mask;
+  }
+}
+
+int pm_lookup_name(const struct pm_lookup* lookup, const char* name) {
+  const struct pm_lookup_slot* slot;
+  unsigned int hash;
+  size_t position;
+  if (lookup->slot == NULL) {
+    return -1;
+  }
+  hash = pm_lookup_hash_name(name);
+  position = hash & lookup->mask;
+  for (;;) {
+    slot = &lookup->slot[position];
+    if (slot->index == 0) {
+      return -1;
+    }
+    if (slot->hash == hash && strcmp(slot->name, name) == 0) {
+      return slot->index - 1;
+    }
+    position = (position + 1) & lookup->mask;
+  }
+}
+
+size_t pm_lookup_probes_id(const struct pm_lookup* lookup, int id) {
+  const struct pm_lookup_slot* slot;
+  size_t position, probes = 0;
+  if (lookup->slot == NULL) {
+    return 0;
+  }
+  position = pm_lookup_hash_id(id) & lookup->mask;
+  for (;;) {
+    slot = &lookup->slot[position];
+    ++probes;
+    if (slot->index == 0 || slot->id == id) {
+      return probes;
+    }
+    position = (position + 1) & lookup->mask;
+  }
+}
+
+size_t pm_lookup_probes_name(const struct pm_lookup* lookup, const char* name) {
+  const struct pm_lookup_slot* slot;
+  unsigned int hash;
+  size_t position, probes = 0;
+  if (lookup->slot == NULL) {
+    return 0;
+  }
+  hash = pm_lookup_hash_name(name);
+  position = hash & lookup->mask;
+  for (;;) {
+    slot = &lookup->slot[position];
+    ++probes;
+    if (slot->index == 0 ||
+      (slot->hash == hash && strcmp(slot->name, name) == 0)) {
+      return probes;
+    }
+    position = (position + 1) & lookup->mask;
+  }
+}
+
+size_t pm_lookup_size(size_t count) {
+  size_t size = PM_LOOKUP_MINIMUM_SIZE;
+  while (size < 2 * count) {
+    size <<= 1;
+  }
+  return size;
+}
+
+unsigned int pm_lookup_hash_id(int id) {
+  unsigned int hash = (unsigned int)(id) * PM_LOOKUP_GOLDEN;
+  return hash ^ (hash >> 16);
+}
+
+unsigned int pm_lookup_hash_name(const char* name) {
+  unsigned int hash = PM_LOOKUP_FNV_OFFSET;
+  while (*name) {
+    hash ^= (unsigned char)(*name++);
+    hash *= PM_LOOKUP_FNV_PRIME;
+  }
+  return hash;
+}
@@ -0,0 +1,42 @@
+#ifndef PM_LOOKUP_H_
+#define PM_LOOKUP_H_
+
+#include <stddef.h>
+
+#include "arena.h"
+
+/*
+ * Open addressing hash index from a process ID or a process name to the
+ * monitoring slot. The table is built once in pm_init and is never more
+ * than half full so a lookup touches one or two slots.
+ */
+struct pm_lookup_slot {
+  unsigned int hash;
+  int id;
+  int index;
+  const char* name;
+};
+
+struct pm_lookup {
+  struct pm_lookup_slot* slot;
+  size_t mask;
+};
+
+size_t pm_lookup_bytes(size_t count);
+ int pm_lookup_create(
+  struct pm_lookup* lookup,
+  size_t count,
+  struct pm_arena* arena);
+void pm_lookup_destroy(struct pm_lookup* lookup);
+
+ int pm_lookup_add_id(struct pm_lookup* lookup, int id, int index);
+ int pm_lookup_add_name(struct pm_lookup* lookup, const char* name, int index);
+
+ int pm_lookup_id(const struct pm_lookup* lookup, int id);
+ int pm_lookup_name(const struct pm_lookup* lookup, const char* name);
+
+/* The slots a lookup touches, for checking how full the probe runs are */
+size_t pm_lookup_probes_id(const struct pm_lookup* lookup, int id);
+size_t pm_lookup_probes_name(const struct pm_lookup* lookup, const char* name);
+
+#endif
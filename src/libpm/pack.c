@@ -0,0 +1,393 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include <pm/format.h>
+#include <pm/pack.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define PM_PACK_NO_WINDOW 0xff
+#define PM_PACK_ROW_FIXED_BITS 136
+#define PM_PACK_VALUE_BITS 78
+
+/* A bit reader over a payload, reading zero bits past its end */
+struct pm_pack_reader {
+  const unsigned char* data;
+  size_t size;
+  size_t position;
+  unsigned long long bits;
+  unsigned int fill;
+};
+
+static void pm_pack_put(
+  struct pm_pack_encoder* encoder,
+  unsigned long long value,
+  unsigned int count);
+static void pm_pack_put_delta(
+  struct pm_pack_encoder* encoder,
+  unsigned long long zigzag);
+static void pm_pack_put_value(
+  struct pm_pack_encoder* encoder,
+  size_t column,
+  unsigned long long zigzag);
+static void pm_pack_store32(unsigned char* p, unsigned int value);
+static void pm_pack_store64(unsigned char* p, unsigned long long value);
+static unsigned long long pm_pack_load64(const unsigned char* p);
+static unsigned long long pm_pack_zigzag(long long value);
+static long long pm_pack_unzigzag(unsigned long long value);
+static unsigned int pm_pack_leading(unsigned long long value);
+static unsigned int pm_pack_trailing(unsigned long long value);
+static unsigned long long pm_pack_get(
+  struct pm_pack_reader* reader,
+  unsigned int count);
+static unsigned long long pm_pack_get_delta(struct pm_pack_reader* reader);
+static size_t pm_pack_encoder_capacity(size_t columns);
+
+/* The previous values come first, then the block and the windows */
+int pm_pack_encoder_create(
+  struct pm_pack_encoder* encoder,
+  size_t columns,
+  void* memory) {
+  memset(encoder, 0x00, sizeof(struct pm_pack_encoder));
+  if (memory == NULL) {
+    return EXIT_FAILURE;
+  }
+  encoder->columns = columns;
+  encoder->capacity = pm_pack_encoder_capacity(columns);
+  encoder->previous = (unsigned long long*)(memory);
+  encoder->buffer = (unsigned char*)(encoder->previous + columns + 1);
+  encoder->window = encoder->buffer + encoder->capacity;
+  pm_pack_encoder_clear(encoder);
+  return EXIT_SUCCESS;
+}
+
+void pm_pack_encoder_destroy(struct pm_pack_encoder* encoder) {
+  memset(encoder, 0x00, sizeof(struct pm_pack_encoder));
+}
+
+size_t pm_pack_encoder_bytes(size_t columns) {
+  return (columns + 1) * sizeof(unsigned long long) +
+    pm_pack_encoder_capacity(columns) + PM_PACK_WINDOW_SIZE(columns);
+}
+
+int pm_pack_encoder_add(
+  struct pm_pack_encoder* encoder,
+  long long time,
+  unsigned long long elapsed,
+  const unsigned long long* values,
+  long long count) {
+  long long delta;
+  size_t c;
+  if (encoder->rows == PM_PACK_BLOCK_ROWS) {
+    return EXIT_FAILURE;
+  }
+  if (encoder->rows == 0) {
+    pm_pack_store64(
+      encoder->buffer + encoder->position,
+      (unsigned long long)(time));
+    pm_pack_store64(encoder->buffer + encoder->position + 8, elapsed);
+    encoder->position += 16;
+    for (c = 0; c < encoder->columns; ++c) {
+      pm_pack_store64(encoder->buffer + encoder->position, values[c]);
+      encoder->position += 8;
+    }
+    pm_pack_store64(
+      encoder->buffer + encoder->position,
+      (unsigned long long)(count));
+    encoder->position += 8;
+  } else {
+    delta = time - encoder->time;
+    pm_pack_put_delta(encoder, pm_pack_zigzag(delta - encoder->timedelta));
+    encoder->timedelta = delta;
+    delta = (long long)(elapsed - encoder->elapsed);
+    pm_pack_put_delta(
+      encoder,
+      pm_pack_zigzag(delta - (long long)(encoder->elapseddelta)));
+    encoder->elapseddelta = (unsigned long long)(delta);
+    for (c = 0; c < encoder->columns; ++c) {
+      pm_pack_put_value(
+        encoder,
+        c,
+        pm_pack_zigzag((long long)(values[c] - encoder->previous[c])));
+    }
+    pm_pack_put_value(
+      encoder,
+      c,
+      pm_pack_zigzag(
+        (long long)((unsigned long long)(count) - encoder->previous[c])));
+  }
+  encoder->time = time;
+  encoder->elapsed = elapsed;
+  for (c = 0; c < encoder->columns; ++c) {
+    encoder->previous[c] = values[c];
+  }
+  encoder->previous[c] = (unsigned long long)(count);
+  ++encoder->rows;
+  return EXIT_SUCCESS;
+}
+
+const unsigned char* pm_pack_encoder_finish(
+  struct pm_pack_encoder* encoder,
+  size_t* size) {
+  if (encoder->fill > 0) {
+    encoder->buffer[encoder->position++] = (unsigned char)(
+      encoder->bits << (8 - encoder->fill));
+    encoder->fill = 0;
+  }
+  pm_pack_store32(
+    encoder->buffer,
+    (unsigned int)(encoder->position - PM_PACK_BLOCK_HEADER_SIZE));
+  pm_pack_store32(encoder->buffer + 4, (unsigned int)(encoder->rows));
+  *size = encoder->position;
+  return encoder->buffer;
+}
+
+void pm_pack_encoder_clear(struct pm_pack_encoder* encoder) {
+  encoder->position = PM_PACK_BLOCK_HEADER_SIZE;
+  encoder->rows = 0;
+  encoder->bits = 0;
+  encoder->fill = 0;
+  encoder->timedelta = 0;
+  encoder->elapseddelta = 0;
+  memset(
+    encoder->window,
+    PM_PACK_NO_WINDOW,
+    PM_PACK_WINDOW_SIZE(encoder->columns));
+}
+
+int pm_pack_decode(
+  const unsigned char* payload,
+  size_t size,
+  size_t rows,
+  size_t columns,
+  unsigned char* window,
+  long long* time,
+  unsigned long long* elapsed,
+  unsigned long long* values,
+  long long* count) {
+  struct pm_pack_reader reader;
+  unsigned int leading, significant;
+  unsigned long long delta, elapseddelta = 0, bits;
+  unsigned long long* previous;
+  unsigned long long* value;
+  long long timedelta = 0;
+  size_t r, c;
+  if (rows == 0 || rows > PM_PACK_BLOCK_ROWS || size < 8 * (columns + 3)) {
+    return EXIT_FAILURE;
+  }
+  memset(window, PM_PACK_NO_WINDOW, PM_PACK_WINDOW_SIZE(columns));
+  time[0] = (long long)(pm_pack_load64(payload));
+  elapsed[0] = pm_pack_load64(payload + 8);
+  for (c = 0; c < columns; ++c) {
+    values[c] = pm_pack_load64(payload + 16 + 8 * c);
+  }
+  count[0] = (long long)(pm_pack_load64(payload + 16 + 8 * columns));
+  reader.data = payload;
+  reader.size = size;
+  reader.position = 8 * (columns + 3);
+  reader.bits = 0;
+  reader.fill = 0;
+  for (r = 1; r < rows; ++r) {
+    timedelta += pm_pack_unzigzag(pm_pack_get_delta(&reader));
+    time[r] = time[r - 1] + timedelta;
+    elapseddelta += (unsigned long long)(
+      pm_pack_unzigzag(pm_pack_get_delta(&reader)));
+    elapsed[r] = elapsed[r - 1] + elapseddelta;
+    previous = &values[(r - 1) * columns];
+    value = &values[r * columns];
+    for (c = 0; c <= columns; ++c) {
+      if (pm_pack_get(&reader, 1) == 0) {
+        delta = 0;
+      } else if (pm_pack_get(&reader, 1) == 0) {
+        if (window[2 * c] == PM_PACK_NO_WINDOW) {
+          return EXIT_FAILURE;
+        }
+        significant = 64 - window[2 * c] - window[2 * c + 1];
+        bits = significant > 32 ?
+          pm_pack_get(&reader, significant - 32) << 32 |
+          pm_pack_get(&reader, 32) :
+          pm_pack_get(&reader, significant);
+        delta = bits << window[2 * c + 1];
+      } else {
+        leading = (unsigned int)(pm_pack_get(&reader, 6));
+        significant = (unsigned int)(pm_pack_get(&reader, 6)) + 1;
+        if (leading + significant > 64) {
+          return EXIT_FAILURE;
+        }
+        bits = significant > 32 ?
+          pm_pack_get(&reader, significant - 32) << 32 |
+          pm_pack_get(&reader, 32) :
+          pm_pack_get(&reader, significant);
+        window[2 * c] = (unsigned char)(leading);
+        window[2 * c + 1] = (unsigned char)(64 - leading - significant);
+        delta = bits << window[2 * c + 1];
+      }
+      if (c < columns) {
+        value[c] = previous[c] + (unsigned long long)(pm_pack_unzigzag(delta));
+      } else {
+        count[r] = count[r - 1] + pm_pack_unzigzag(delta);
+      }
+    }
+  }
+  return 8 * reader.position - reader.fill <= 8 * size ?
+    EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Append count bits of value, count being at most 32 */
+void pm_pack_put(
+  struct pm_pack_encoder* encoder,
+  unsigned long long value,
+  unsigned int count) {
+  encoder->bits = (encoder->bits << count) | value;
+  encoder->fill += count;
+  while (encoder->fill >= 8) {
+    encoder->fill -= 8;
+    encoder->buffer[encoder->position++] = (unsigned char)(
+      encoder->bits >> encoder->fill);
+  }
+}
+
+void pm_pack_put_delta(
+  struct pm_pack_encoder* encoder,
+  unsigned long long zigzag) {
+  if (zigzag == 0) {
+    pm_pack_put(encoder, 0x0, 1);
+  } else if (zigzag < (1ULL << 7)) {
+    pm_pack_put(encoder, 0x2, 2);
+    pm_pack_put(encoder, zigzag, 7);
+  } else if (zigzag < (1ULL << 9)) {
+    pm_pack_put(encoder, 0x6, 3);
+    pm_pack_put(encoder, zigzag, 9);
+  } else if (zigzag < (1ULL << 12)) {
+    pm_pack_put(encoder, 0xe, 4);
+    pm_pack_put(encoder, zigzag, 12);
+  } else {
+    pm_pack_put(encoder, 0xf, 4);
+    pm_pack_put(encoder, zigzag >> 32, 32);
+    pm_pack_put(encoder, zigzag & 0xffffffffULL, 32);
+  }
+}
+
+void pm_pack_put_value(
+  struct pm_pack_encoder* encoder,
+  size_t column,
+  unsigned long long zigzag) {
+  unsigned char* window = &encoder->window[2 * column];
+  unsigned int leading, trailing, significant;
+  unsigned long long bits;
+  if (zigzag == 0) {
+    pm_pack_put(encoder, 0x0, 1);
+    return;
+  }
+  leading = pm_pack_leading(zigzag);
+  trailing = pm_pack_trailing(zigzag);
+  if (window[0] != PM_PACK_NO_WINDOW &&
+    leading >= window[0] && trailing >= window[1]) {
+    pm_pack_put(encoder, 0x2, 2);
+    leading = window[0];
+    trailing = window[1];
+  } else {
+    pm_pack_put(encoder, 0x3, 2);
+    pm_pack_put(encoder, leading, 6);
+    pm_pack_put(encoder, 63 - leading - trailing, 6);
+    window[0] = (unsigned char)(leading);
+    window[1] = (unsigned char)(trailing);
+  }
+  significant = 64 - leading - trailing;
+  bits = zigzag >> trailing;
+  if (significant > 32) {
+    pm_pack_put(encoder, bits >> 32, significant - 32);
+    pm_pack_put(encoder, bits & 0xffffffffULL, 32);
+  } else {
+    pm_pack_put(encoder, bits, significant);
+  }
+}
+
+void pm_pack_store32(unsigned char* p, unsigned int value) {
+  p[0] = (unsigned char)(value);
+  p[1] = (unsigned char)(value >> 8);
+  p[2] = (unsigned char)(value >> 16);
+  p[3] = (unsigned char)(value >> 24);
+}
+
+void pm_pack_store64(unsigned char* p, unsigned long long value) {
+  pm_pack_store32(p, (unsigned int)(value));
+  pm_pack_store32(p + 4, (unsigned int)(value >> 32));
+}
+
+unsigned long long pm_pack_load64(const unsigned char* p) {
+  unsigned long long value = 0;
+  int k;
+  for (k = 7; k >= 0; --k) {
+    value = (value << 8) | p[k];
+  }
+  return value;
+}
+
+unsigned long long pm_pack_zigzag(long long value) {
+  return ((unsigned long long)(value) << 1) ^
+    (unsigned long long)(value >> 63);
+}
+
+long long pm_pack_unzigzag(unsigned long long value) {
+  return (long long)(value >> 1) ^ -(long long)(value & 1);
+}
+
+unsigned int pm_pack_leading(unsigned long long value) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return 63 - (unsigned int)(index);
+#else
+  return (unsigned int)(__builtin_clzll(value));
+#endif
+}
+
+unsigned int pm_pack_trailing(unsigned long long value) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return (unsigned int)(index);
+#else
+  return (unsigned int)(__builtin_ctzll(value));
+#endif
+}
+
+/* Take count bits, count being at most 32 */
+unsigned long long pm_pack_get(
+  struct pm_pack_reader* reader,
+  unsigned int count) {
+  while (reader->fill <= 56) {
+    reader->bits <<= 8;
+    if (reader->position < reader->size) {
+      reader->bits |= reader->data[reader->position];
+    }
+    ++reader->position;
+    reader->fill += 8;
+  }
+  reader->fill -= count;
+  return (reader->bits >> reader->fill) & ((1ULL << count) - 1);
+}
+
+unsigned long long pm_pack_get_delta(struct pm_pack_reader* reader) {
+  if (pm_pack_get(reader, 1) == 0) {
+    return 0;
+  } else if (pm_pack_get(reader, 1) == 0) {
+    return pm_pack_get(reader, 7);
+  } else if (pm_pack_get(reader, 1) == 0) {
+    return pm_pack_get(reader, 9);
+  } else if (pm_pack_get(reader, 1) == 0) {
+    return pm_pack_get(reader, 12);
+  }
+  return pm_pack_get(reader, 32) << 32 | pm_pack_get(reader, 32);
+}
+
+/* The block header, the first row in full and every later row at most */
+size_t pm_pack_encoder_capacity(size_t columns) {
+  return PM_PACK_BLOCK_HEADER_SIZE + 8 * (columns + 3) +
+    (PM_PACK_BLOCK_ROWS - 1) *
+    ((PM_PACK_ROW_FIXED_BITS + PM_PACK_VALUE_BITS * (columns + 1)) / 8 + 1) +
+    8;
+}
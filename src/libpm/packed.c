@@ -0,0 +1,121 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "packed.h"
+
+static int pm_packed_write32(struct pm_packed* packed, unsigned int value);
+
+int pm_packed_open(struct pm_packed* packed, const char* filename) {
+  memset(packed, 0x00, sizeof(struct pm_packed));
+  packed->file = fopen(filename, "wb");
+  if (packed->file == NULL) {
+    return EXIT_FAILURE;
+  }
+  if (fwrite(PM_PACK_MAGIC, 1, PM_PACK_MAGIC_SIZE, packed->file) !=
+    PM_PACK_MAGIC_SIZE) {
+    return EXIT_FAILURE;
+  }
+  return pm_packed_write32(packed, PM_PACK_VERSION);
+}
+
+int pm_packed_header(
+  struct pm_packed* packed,
+  const int* types,
+  size_t typecount,
+  size_t targetcount) {
+  size_t k;
+  packed->columns = typecount * targetcount;
+  if (pm_packed_write32(packed, (unsigned int)(targetcount)) != EXIT_SUCCESS ||
+    pm_packed_write32(packed, (unsigned int)(typecount)) != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+  for (k = 0; k < typecount; ++k) {
+    if (pm_packed_write32(packed, (unsigned int)(types[k])) != EXIT_SUCCESS) {
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+int pm_packed_target(struct pm_packed* packed, const char* name) {
+  size_t length = strlen(name);
+  if (pm_packed_write32(packed, (unsigned int)(length)) != EXIT_SUCCESS ||
+    fwrite(name, 1, length, packed->file) != length) {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/* The count of columns after the target values, each named by a target */
+int pm_packed_extra(struct pm_packed* packed, size_t count) {
+  packed->columns += count;
+  return pm_packed_write32(packed, (unsigned int)(count));
+}
+
+/* The unit of the elapsed time, PM_FORMAT_UNIT_MS or PM_FORMAT_UNIT_US */
+int pm_packed_unit(struct pm_packed* packed, unsigned int unit) {
+  return pm_packed_write32(packed, unit);
+}
+
+int pm_packed_start(struct pm_packed* packed, void* memory) {
+  if (pm_pack_encoder_create(&packed->encoder, packed->columns, memory) !=
+    EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+  return fflush(packed->file) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int pm_packed_write(
+  struct pm_packed* packed,
+  long long time,
+  unsigned long long elapsed,
+  const unsigned long long* values,
+  long long count) {
+  if (packed->encoder.rows == PM_PACK_BLOCK_ROWS &&
+    pm_packed_flush(packed) != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+  return pm_pack_encoder_add(&packed->encoder, time, elapsed, values, count);
+}
+
+/* Append the rows encoded so far as a block */
+int pm_packed_flush(struct pm_packed* packed) {
+  const unsigned char* block;
+  size_t size;
+  if (packed->encoder.rows == 0) {
+    return EXIT_SUCCESS;
+  }
+  block = pm_pack_encoder_finish(&packed->encoder, &size);
+  if (fwrite(block, 1, size, packed->file) != size ||
+    fflush(packed->file) != 0) {
+    return EXIT_FAILURE;
+  }
+  pm_pack_encoder_clear(&packed->encoder);
+  ++packed->blocks;
+  return EXIT_SUCCESS;
+}
+
+int pm_packed_close(struct pm_packed* packed) {
+  int result = EXIT_SUCCESS;
+  if (packed->file != NULL) {
+    if (packed->encoder.buffer != NULL &&
+      pm_packed_flush(packed) != EXIT_SUCCESS) {
+      result = EXIT_FAILURE;
+    }
+    if (fclose(packed->file) != 0) {
+      result = EXIT_FAILURE;
+    }
+    packed->file = NULL;
+  }
+  pm_pack_encoder_destroy(&packed->encoder);
+  return result;
+}
+
+int pm_packed_write32(struct pm_packed* packed, unsigned int value) {
+  unsigned char p[4];
+  p[0] = (unsigned char)(value);
+  p[1] = (unsigned char)(value >> 8);
+  p[2] = (unsigned char)(value >> 16);
+  p[3] = (unsigned char)(value >> 24);
+  return fwrite(p, 1, 4, packed->file) == 4 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,43 @@
+#ifndef PM_PACKED_H_
+#define PM_PACKED_H_
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include <pm/format.h>
+#include <pm/pack.h>
+
+/*
+ * Writer for the packed output file. Rows are encoded into a block that
+ * is appended to the file when it is full or when the output is flushed,
+ * so every flush ends a block.
+ */
+struct pm_packed {
+  FILE* file;
+  struct pm_pack_encoder encoder;
+  size_t columns;
+  unsigned long long blocks;
+};
+
+ int pm_packed_open(struct pm_packed* packed, const char* filename);
+ int pm_packed_header(
+  struct pm_packed* packed,
+  const int* types,
+  size_t typecount,
+  size_t targetcount);
+ int pm_packed_target(struct pm_packed* packed, const char* name);
+ int pm_packed_extra(struct pm_packed* packed, size_t count);
+ int pm_packed_unit(struct pm_packed* packed, unsigned int unit);
+
+/* The encoder works in memory of pm_pack_encoder_bytes for the columns */
+ int pm_packed_start(struct pm_packed* packed, void* memory);
+ int pm_packed_write(
+  struct pm_packed* packed,
+  long long time,
+  unsigned long long elapsed,
+  const unsigned long long* values,
+  long long count);
+ int pm_packed_flush(struct pm_packed* packed);
+ int pm_packed_close(struct pm_packed* packed);
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef _WIN32
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "parse.h"
+
+/* The four characters after Vm that tell the keys apart */
+static const char pm_parse_status_tag[PM_PARSE_STATUS_KEY_COUNT][4] = {
+  { 'P', 'e', 'a', 'k' },
+  { 'L', 'c', 'k', ':' },
+  { 'H', 'W', 'M', ':' },
+  { 'P', 'T', 'E', ':' }
+};
+
+static int pm_parse_highest(unsigned int mask);
+
+/*
+ * Leading blanks are skipped. The digit test is a single unsigned compare
+ * so the loop has one branch per digit.
+ */
+unsigned long long pm_parse_number(const char** s) {
+  unsigned long long value = 0;
+  const char* p = *s;
+  unsigned int digit;
+  while (*p == ' ' || *p == '\t') {
+    ++p;
+  }
+  while ((digit = (unsigned int)(unsigned char)(*p) - '0') < 10) {
+    value = 10 * value + digit;
+    ++p;
+  }
+  *s = p;
+  return value;
+}
+
+const char* pm_parse_comm(
+  const char* buffer,
+  size_t length,
+  const char** name,
+  size_t* namelength) {
+  const char* first = memchr(buffer, '(', length);
+  const char* last = memrchr(buffer, ')', length);
+  if (first == NULL || last == NULL || last < first) {
+    return NULL;
+  }
+  if (name != NULL) {
+    *name = first + 1;
+    *namelength = (size_t)(last - first - 1);
+  }
+  return last;
+}
+
+/*
+ * The fields after comm are separated by single spaces. Walking stops at
+ * the last field asked for, so the fields after it are never scanned.
+ */
+int pm_parse_stat(
+  const char* buffer,
+  size_t length,
+  unsigned int fields,
+  unsigned long long* value) {
+  const char* p = pm_parse_comm(buffer, length, NULL, NULL);
+  int field, last = pm_parse_highest(fields);
+  if (p == NULL) {
+    return EXIT_FAILURE;
+  }
+  for (++p, field = 0; field <= last && *p == ' '; ++field) {
+    ++p;
+    if (fields & PM_PARSE_STAT_FIELD(field)) {
+      value[field] = pm_parse_number(&p);
+    }
+    while (*p != ' ' && *p != '\0') {
+      ++p;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+/*
+ * The Vm lines come after a dozen lines of identity, which are skipped at
+ * once by looking for the first of them. From there it is one pass over
+ * the lines, comparing the four characters after Vm of each line as one
+ * word to the keys still missing, and stopping once all are found.
+ */
+int pm_parse_status(
+  const char* buffer,
+  size_t length,
+  unsigned int keys,
+  unsigned long long* value) {
+  const char* end = buffer + length;
+  const char *p, *next, *number;
+  unsigned int missing = keys, tag, want;
+  int key;
+  for (p = buffer; (p = memchr(p, 'V', (size_t)(end - p))) != NULL; ++p) {
+    if (p > buffer && p[-1] == '\n' && p[1] == 'm') {
+      break;
+    }
+  }
+  for (; p != NULL && p < end && missing != 0; p = next + 1) {
+    next = memchr(p, '\n', (size_t)(end - p));
+    if (next == NULL) {
+      next = end;
+    }
+    if (next - p < 8 || p[0] != 'V' || p[1] != 'm') {
+      continue;
+    }
+    memcpy(&tag, p + 2, sizeof(tag));
+    for (key = 0; key < PM_PARSE_STATUS_KEY_COUNT; ++key) {
+      memcpy(&want, pm_parse_status_tag[key], sizeof(want));
+      if (tag == want && (missing & PM_PARSE_STATUS_KEY(key))) {
+        number = p + 6;
+        if (*number == ':') {
+          ++number;
+        }
+        value[key] = pm_parse_number(&number);
+        missing &= ~PM_PARSE_STATUS_KEY(key);
+        break;
+      }
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+int pm_parse_highest(unsigned int mask) {
+  int highest = -1;
+  while (mask != 0) {
+    mask >>= 1;
+    ++highest;
+  }
+  return highest;
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef PM_PARSE_H_
+#define PM_PARSE_H_
+
+#ifndef _WIN32
+
+#include <stddef.h>
+
+/* Fields of stat counted from the state after the comm field */
+#define PM_PARSE_STAT_PPID 1
+#define PM_PARSE_STAT_MINFLT 7
+#define PM_PARSE_STAT_MAJFLT 9
+#define PM_PARSE_STAT_UTIME 11
+#define PM_PARSE_STAT_STIME 12
+#define PM_PARSE_STAT_THREADS 17
+#define PM_PARSE_STAT_STARTTIME 19
+#define PM_PARSE_STAT_FIELD_COUNT 20
+
+#define PM_PARSE_STAT_FIELD(field) (1u << (field))
+
+/* Keys of status, with their values in kB */
+#define PM_PARSE_STATUS_VMPEAK 0
+#define PM_PARSE_STATUS_VMLCK 1
+#define PM_PARSE_STATUS_VMHWM 2
+#define PM_PARSE_STATUS_VMPTE 3
+#define PM_PARSE_STATUS_KEY_COUNT 4
+
+#define PM_PARSE_STATUS_KEY(key) (1u << (key))
+
+/*
+ * Parsers for the procfs text files. They take the length read and rely on
+ * the buffer being terminated after it, and only convert what the fields
+ * or keys masks ask for, leaving the other values untouched. Lines and the
+ * end of comm are found with memchr and memrchr, which libc vectorizes.
+ */
+unsigned long long pm_parse_number(const char** s);
+
+/*
+ * The comm field is everything between the first '(' and the last ')' as
+ * the name itself may hold spaces and parentheses. Returns the position of
+ * the last ')' or NULL when the line is not a stat line.
+ */
+const char* pm_parse_comm(
+  const char* buffer,
+  size_t length,
+  const char** name,
+  size_t* namelength);
+
+ int pm_parse_stat(
+  const char* buffer,
+  size_t length,
+  unsigned int fields,
+  unsigned long long* value);
+ int pm_parse_status(
+  const char* buffer,
+  size_t length,
+  unsigned int keys,
+  unsigned long long* value);
+
+#endif
+
+#endif
@@ -1,4 +1,6 @@
 #include <stdbool.h>
+#include <stdarg.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -7,12 +9,37 @@
 #ifdef _WIN32
 #include <windows.h>
 #include <psapi.h>
+#include <tlhelp32.h>
 #else
+#include "procfs.h"
 #endif
 
 #include <pm/pm.h>
+#include <pm/context.h>
+#include <pm/share.h>
+#include <pm/sketch.h>
+
+#include "arena.h"
+#include "binary.h"
+#include "packed.h"
+#include "cache.h"
+#include "encode.h"
+#include "lookup.h"
+#include "rules.h"
+#include "sampler.h"
+#include "serve.h"
+#include "stats.h"
+#include "store.h"
+#include "writer.h"
 
 #define DEFAULT_OUTPUT_FILE_NAME "pm.csv"
+#define DEFAULT_EVENTS_FILE_NAME "pm_events.csv"
+#define PM_SERVE_EXTRA_LINES 16
+#define PM_SERVE_LINE_SIZE (PM_TEXT_BUFFER_SIZE + 128)
+#define PM_SERVE_BODY_SIZE(columns, types) \
+  (((columns) + (types) + PM_SERVE_EXTRA_LINES) * PM_SERVE_LINE_SIZE)
+#define DEFAULT_BINARY_OUTPUT_FILE_NAME "pm.bin"
+#define DEFAULT_PACKED_OUTPUT_FILE_NAME "pm.pack"
 
 #define ERROR_TEXT_MEMORY \
   "Memory error\n"
@@ -28,161 +55,488 @@
   "Process Monitoring output file name has already been set\n"
 
 #define PM_TEXT_BUFFER_SIZE 256
+#define PM_FORMAT_CSV 0
+#define PM_FORMAT_BIN 1
+#define PM_FORMAT_NONE 2
+#define PM_FORMAT_PACK 3
+#define PM_CACHE_MIN_SIZE 1024
+#define PM_ITEM_MIN_SIZE 64
+#define PM_TREE_PENDING -2
+#define PM_CADENCE_DEFAULT 30
+#define PM_ADAPTIVE_SHIFT 6
 #define PM_DEFAULT_TYPE PM_TYPE_WORKING_SET_SIZE
+#define PM_ROLLUP_QUEUE_SIZE 16
+#define PM_EVENT_QUEUE_SIZE 64
+#define PM_EVENT_RULE 0
+#define PM_EVENT_TARGET 1
+#define PM_EVENT_VALUE 2
+#define PM_EVENT_SLOPE 3
+#define PM_EVENT_WORDS 4
+#define PM_TRACE_TID_SAMPLE 1
+#define PM_TRACE_TID_WRITER 2
+#define PM_ROLLUP_WORDS \
+  ((sizeof(struct pm_sketch) + sizeof(unsigned long long) - 1) / \
+  sizeof(unsigned long long))
 
 #ifdef _WIN32
 #define PM_PROCESS_ARRAY_SIZE 1024
+#define PM_PROCESS_ARRAY_MAX_SIZE 0x1000000
 #define PM_PROCESS_NAME_SIZE MAX_PATH
+#define PM_STRTOK(s, d, p) strtok_s((s), (d), (p))
 #else
+#define PM_PROCESS_ARRAY_SIZE 64
+#define PM_PROCESS_NAME_SIZE 256
+#define PM_STRTOK(s, d, p) strtok_r((s), (d), (p))
 #endif
 
 struct pm_type pm_type_arr[PM_TYPE_COUNT] = {
   {
     "Page fault count",
     "pfc",
-    PM_TYPE_PAGE_FAULT_COUNT },
+    PM_TYPE_PAGE_FAULT_COUNT,
+    PM_COST_CHEAP },
   {
     "Peak working set size",
     "pwss",
-    PM_TYPE_PEAK_WORKING_SET_SIZE },
+    PM_TYPE_PEAK_WORKING_SET_SIZE,
+    PM_COST_CHEAP },
   {
     "Working set size",
     "wss",
-    PM_TYPE_WORKING_SET_SIZE },
+    PM_TYPE_WORKING_SET_SIZE,
+    PM_COST_CHEAP },
   {
     "Quota peak paged pool usage",
     "qpppu",
-    PM_TYPE_QUOTA_PEAK_PAGED_POOL_USAGE },
+    PM_TYPE_QUOTA_PEAK_PAGED_POOL_USAGE,
+    PM_COST_CHEAP },
   {
     "Quota paged pool usage",
     "qppu",
-    PM_TYPE_QUOTA_PAGED_POOL_USAGE },
+    PM_TYPE_QUOTA_PAGED_POOL_USAGE,
+    PM_COST_CHEAP },
   {
     "Quota peak non paged pool usage",
     "qpnppu",
-    PM_TYPE_QUOTA_PEAK_NON_PAGED_POOL_USAGE },
+    PM_TYPE_QUOTA_PEAK_NON_PAGED_POOL_USAGE,
+    PM_COST_CHEAP },
   {
     "Quota non paged pool usage",
     "qnppu",
-    PM_TYPE_QUOTA_NON_PAGED_POOL_USAGE },
+    PM_TYPE_QUOTA_NON_PAGED_POOL_USAGE,
+    PM_COST_CHEAP },
   {
     "Page file usage",
     "pfu",
-    PM_TYPE_PAGEFILE_USAGE },
+    PM_TYPE_PAGEFILE_USAGE,
+    PM_COST_CHEAP },
   {
     "Peak page file usage",
     "ppfu",
-    PM_TYPE_PEAK_PAGEFILE_USAGE },
+    PM_TYPE_PEAK_PAGEFILE_USAGE,
+    PM_COST_CHEAP },
+  {
+    "CPU usage in hundredths of a percent",
+    "cpu",
+    PM_TYPE_CPU_USAGE,
+    PM_COST_CHEAP },
+  {
+    "Read bytes",
+    "rb",
+    PM_TYPE_READ_BYTES,
+    PM_COST_CHEAP },
+  {
+    "Write bytes",
+    "wb",
+    PM_TYPE_WRITE_BYTES,
+    PM_COST_CHEAP },
+  {
+    "Open file descriptor count",
+    "fd",
+    PM_TYPE_DESCRIPTOR_COUNT,
+    PM_COST_CHEAP },
+  {
+    "Thread count",
+    "thr",
+    PM_TYPE_THREAD_COUNT,
+    PM_COST_CHEAP },
+  {
+    "Proportional set size",
+    "pss",
+    PM_TYPE_PROPORTIONAL_SET_SIZE,
+    PM_COST_EXPENSIVE },
+  {
+    "Unique set size",
+    "uss",
+    PM_TYPE_UNIQUE_SET_SIZE,
+    PM_COST_EXPENSIVE },
+};
+
+/*
+ * The sampling plan compiled by pm_context_init. One entry per selected
+ * type with the offset of the field in the sampled counters and a mask for
+ * fields narrower than the copied width.
+ */
+struct pm_plan {
+  size_t offset;
+  unsigned long long mask;
+};
+
+/*
+ * The monitored processes found during a tick. The samplers fill one
+ * slice of samples per item, which is copied to the target columns in
+ * enumeration order once all of them are done.
+ */
+struct pm_item {
+  size_t entry;
+  int id;
+  bool failed;
+  bool carried;
+};
+
+#ifdef _WIN32
+#define PM_PLAN_FIELD SIZE_T
+static const size_t pm_type_offset[PM_TYPE_UNKNOWN] = {
+  0,
+  offsetof(PROCESS_MEMORY_COUNTERS, PageFaultCount),
+  offsetof(PROCESS_MEMORY_COUNTERS, PeakWorkingSetSize),
+  offsetof(PROCESS_MEMORY_COUNTERS, WorkingSetSize),
+  offsetof(PROCESS_MEMORY_COUNTERS, QuotaPeakPagedPoolUsage),
+  offsetof(PROCESS_MEMORY_COUNTERS, QuotaPagedPoolUsage),
+  offsetof(PROCESS_MEMORY_COUNTERS, QuotaPeakNonPagedPoolUsage),
+  offsetof(PROCESS_MEMORY_COUNTERS, QuotaNonPagedPoolUsage),
+  offsetof(PROCESS_MEMORY_COUNTERS, PagefileUsage),
+  offsetof(PROCESS_MEMORY_COUNTERS, PeakPagefileUsage)
 };
+#else
+#define PM_PLAN_FIELD unsigned long long
+#endif
+
+struct pm_context {
+  char* outputfilename;
+  FILE* outputfile;
+  int outputformat;
+  struct pm_binary binary;
+  struct pm_packed packed;
+  void* packmemory;
+
+  pm_sink sink;
+  void* sinkuser;
+
+  size_t writercapacity;
+  size_t writercolumns;
+  unsigned long writerrows;
+  unsigned long writerms;
+  struct pm_writer writer;
+
+  size_t retention;
+  struct pm_store store;
+
+  unsigned long rollup;
+  long long window;
+  unsigned long rolled;
+  unsigned long long rollupelapsed;
+  long long rolluppcount;
+  struct pm_sketch* sketches;
+
+  int monitoringtype[PM_TYPE_COUNT];
+  size_t monitoringtypecount;
+
+  int* monitoringid;
+  char** monitoringname;
+  char* monitoringnames;
+  int* monitoringtree;
+  unsigned long long* monitoring;
+
+  size_t monitoringidcount;
+  size_t monitoringnamecount;
+  size_t monitoringtreecount;
+  size_t monitoringextracount;
+  size_t monitoringagestart;
+  size_t monitoringagecount;
+  size_t monitoringcount;
+  size_t monitoringvaluecount;
+  size_t monitoringcolumncount;
+
+  struct pm_lookup idlookup;
+  struct pm_lookup namelookup;
+  struct pm_lookup treelookup;
+
+  unsigned long long* monitoringstart;
+  unsigned long long* treestart;
+  size_t* pending;
+  size_t pendingcount;
+  size_t pendingcapacity;
+
+  size_t top;
+  int topby;
+  size_t topk;
+  size_t* heap;
+  size_t ranked;
+
+  struct pm_encoder encoder;
+
+  char* listenaddress;
+#ifndef _WIN32
+  struct pm_serve serve;
+#endif
 
-static char* outputfilename = NULL;
-static FILE* outputfile = NULL;
+  char* sharename;
+  struct pm_share share;
 
-static type = PM_TYPE_UNDEFINED;
+  struct pm_rules rules;
+  bool* seen;
+  char* eventsfilename;
+  FILE* eventsfile;
+  struct pm_writer eventwriter;
 
-static int* monitoringid = NULL;
-static char** monitoringname = NULL;
-static unsigned long long* monitoring = NULL;
+  bool selfstats;
+  char* tracefilename;
+  char* procfsroot;
+  FILE* tracefile;
+  unsigned long long tracestart;
+  struct pm_stats_histogram phase[PM_PHASE_COUNT];
 
-static size_t monitoringidcount = 0;
-static size_t monitoringnamecount = 0;
-static size_t monitoringcount = 0;
+  struct pm_arena arena;
+  size_t cachecapacity;
+  size_t capacity;
+  unsigned long long overflow;
+  bool overflowed;
 
-static size_t length;
+  struct pm_cache cache;
+  unsigned long tick;
+  bool initialized;
+
+  unsigned int samplerthreads;
+  unsigned long cadence;
+  unsigned long adaptive;
+  size_t readcount;
+  size_t previtemcount;
+  struct pm_sampler sampler;
+  struct pm_item* items;
+  unsigned long long* samples;
+  size_t itemcount;
+  size_t itemcapacity;
+
+  struct pm_plan plan[PM_TYPE_COUNT];
+
+  unsigned long long elapsed;
+  bool microseconds;
+  unsigned long long initstamp;
+  long long pcount;
 
 #ifdef _WIN32
-static ULONGLONG inittime, current;
-static DWORD pids[PM_PROCESS_ARRAY_SIZE];
-static DWORD penums;
-static DWORD menums;
-PROCESS_MEMORY_COUNTERS pmc;
-HMODULE hmodule;
-HANDLE hprocess;
+  ULONGLONG inittime;
+  DWORD* pids;
+  DWORD pidcapacity;
+  PROCESSENTRY32 * parents;
+  size_t parentcount;
+  size_t parentcapacity;
+  unsigned long parenttick;
 #else
-struct timespec begining, conclusion;
+  struct timespec inittime;
+  struct pm_procfs_plan procfs;
+  struct pm_procfs_directory directory;
+  struct pm_syscall_count count;
+  struct pm_syscall_count* workercount;
 #endif
 
-static int j;
-static int i;
-static int pcount;
-static unsigned long long elapsed;
-static char processname[PM_PROCESS_NAME_SIZE];
-static time_t currtime;
+  struct pm_syscall_count syscallcount;
+};
 
-static char pm_text_buffer[PM_TEXT_BUFFER_SIZE];
+static struct pm_context* pm_default_context = NULL;
 
-static unsigned long long pm_get_value(void* p, int id, int type);
+static struct pm_context* pm_default();
 
-static int pm_is_monitored_id(const int id);
-static int pm_is_monitored_name(const char* name);
-static int pm_write_header();
-static size_t pm_count_delimiters(char* s, char ch);
+static int pm_get_values(
+  const struct pm_context* context,
+  void* p,
+  int id,
+  bool slow,
+  unsigned long long* values,
+  struct pm_syscall_count* count);
+static void pm_add_item(
+  struct pm_context* context,
+  const struct pm_cache_entry* entry,
+  int id);
+static void pm_sample_item(void* user, size_t index, unsigned int worker);
+static void pm_merge(struct pm_context* context);
+#ifndef _WIN32
+static void pm_carry(
+  const struct pm_context* context,
+  const struct pm_procfs_process* process,
+  unsigned long long* values);
+static void pm_adapt(
+  const struct pm_context* context,
+  struct pm_procfs_process* process,
+  const unsigned long long* previous,
+  const unsigned long long* values);
+#endif
+static unsigned long long pm_age(
+  const struct pm_context* context,
+  const struct pm_cache_entry* entry);
+static void pm_rank(struct pm_context* context);
+static void pm_sift(
+  const struct pm_context* context,
+  size_t* heap,
+  size_t count,
+  size_t position);
+static int pm_deliver(struct pm_context* context, struct pm_sample* sample);
+static int pm_roll(struct pm_context* context, const struct pm_sample* sample);
+static int pm_roll_emit(struct pm_context* context);
+static unsigned long long pm_phase(
+  struct pm_context* context,
+  int phase,
+  unsigned long long start);
 
-int pm_add_ids(char* ids) {
-  int id;
-  char* token;
-  monitoringidcount = pm_count_delimiters(ids, ',');
-  if (monitoringidcount > 0) {
-    monitoringid = (int*)(malloc(monitoringidcount * sizeof(int)));
-    if (monitoringid) {
-      j = 0;
-      token = strtok(ids, ",");
-      while (token != NULL) {
-        length = strlen(token);
-        if (length > 0) {
-          id = atoi(token);
-          if(id > 0) {
-            monitoringid[j++] = id;
-            printf("Adding ID %d for monitoring\n", id);
-            if (j > monitoringidcount) {
-              fprintf(stderr, "To many ids!\n");
-              return EXIT_FAILURE;
-            }
-          } else {
-            fprintf(stderr, "The id '%s' is not a number\n", token);
-            return EXIT_FAILURE;
-          }
-        } else {
-          fprintf(stderr, "Error: Empty process ID number\n");
-          return EXIT_FAILURE;
-        }
-        token = strtok(NULL, ",");
-      }
-    } else {
-      fprintf(stderr, ERROR_TEXT_MEMORY);
-      return EXIT_FAILURE;
-    }
+static struct pm_cache_entry* pm_resolve(
+  struct pm_context* context,
+  const int id,
+  const unsigned long long start,
+  const char* name,
+  const int parent);
+static int pm_resolve_tree(
+  struct pm_context* context,
+  const struct pm_cache_entry* entry);
+static int pm_resolve_pending(struct pm_context* context);
+static void pm_evict(struct pm_context* context);
+
+#ifdef _WIN32
+static int pm_enumerate(struct pm_context* context, DWORD* count);
+static int pm_parent(struct pm_context* context, DWORD pid);
+#endif
+
+#ifndef _WIN32
+static struct pm_cache_entry* pm_resolve_procfs(
+  struct pm_context* context,
+  const int id);
+#endif
+
+static int pm_parse_ids(
+  char* ids,
+  int** list,
+  size_t* count,
+  const char* what);
+static int pm_target_name(
+  const struct pm_context* context,
+  size_t target,
+  char* name,
+  size_t size);
+static void pm_list(struct pm_context* context);
+static int pm_is_monitored_id(const struct pm_context* context, const int id);
+static int pm_is_monitored_name(
+  const struct pm_context* context,
+  const char* name);
+static int pm_build_lookup(struct pm_context* context);
+static void pm_rank_type(struct pm_context* context);
+static int pm_reserve(struct pm_context* context);
+static int pm_carve(struct pm_context* context);
+static int pm_compile_plan(struct pm_context* context);
+static int pm_bind_rules(struct pm_context* context);
+static int pm_open_events(struct pm_context* context);
+static void pm_check_rules(struct pm_context* context);
+static int pm_create_share(struct pm_context* context);
+#ifndef _WIN32
+static size_t pm_render_metrics(
+  const struct pm_serve_snapshot* snapshot,
+  char* buffer,
+  size_t size,
+  void* user);
+static void pm_render_append(
+  char* buffer,
+  size_t size,
+  size_t* length,
+  const char* format,
+  ...);
+static void pm_render_label(
+  const struct pm_context* context,
+  size_t target,
+  const struct pm_serve_snapshot* snapshot,
+  char* label,
+  size_t size);
+#endif
+static void pm_queue_event(
+  struct pm_context* context,
+  size_t rule,
+  size_t target,
+  unsigned long long value,
+  double slope);
+static int pm_write_event(const struct pm_writer_record* record, void* user);
+static int pm_flush_events(void* user);
+static int pm_open_output(struct pm_context* context);
+static int pm_write_header(struct pm_context* context);
+static int pm_write_record(const struct pm_writer_record* record, void* user);
+static int pm_format_record(
+  struct pm_context* context,
+  const struct pm_writer_record* record);
+static int pm_write_rollup(
+  struct pm_context* context,
+  const struct pm_sketch* sketch);
+static int pm_flush_output(void* user);
+static size_t pm_count_delimiters(const char* s, char ch);
+
+struct pm_context* pm_create() {
+  struct pm_context* context;
+  context = (struct pm_context*)(calloc(1, sizeof(struct pm_context)));
+  if (context == NULL) {
+    fprintf(stderr, ERROR_TEXT_MEMORY);
+    return NULL;
   }
-  return EXIT_SUCCESS;
+  context->outputformat = PM_FORMAT_CSV;
+  context->writercapacity = PM_WRITER_DEFAULT_CAPACITY;
+  context->writerrows = PM_WRITER_DEFAULT_ROWS;
+  context->samplerthreads = 1;
+  context->cadence = PM_CADENCE_DEFAULT;
+  pm_store_reset(&context->store);
+  pm_rules_reset(&context->rules);
+  pm_share_reset(&context->share);
+#ifndef _WIN32
+  context->binary.fd = -1;
+  pm_procfs_directory_reset(&context->directory);
+  pm_serve_reset(&context->serve);
+#endif
+  return context;
 }
 
-int pm_add_names(char* names) {
+int pm_context_add_ids(struct pm_context* context, char* ids) {
+  return pm_parse_ids(
+    ids,
+    &context->monitoringid,
+    &context->monitoringidcount,
+    "ID");
+}
+
+/* The names point into one copy of the list split in place */
+int pm_context_add_names(struct pm_context* context, char* names) {
+  size_t j = 0, length = strlen(names) + 1;
   char* token;
-  monitoringnamecount = pm_count_delimiters(names, ';');
-  if (monitoringnamecount > 0) {
-    monitoringname = (char**)(malloc(monitoringnamecount * sizeof(char*)));
-    if (monitoringname) {
-      j = 0;
-      token = strtok(names, ";");
+  char* save;
+  context->monitoringnamecount = pm_count_delimiters(names, ';');
+  if (context->monitoringnamecount > 0) {
+    context->monitoringname = (char**)(
+      calloc(context->monitoringnamecount, sizeof(char*)));
+    context->monitoringnames = (char*)(malloc(length));
+    if (context->monitoringname && context->monitoringnames) {
+      memcpy(context->monitoringnames, names, length);
+      token = PM_STRTOK(context->monitoringnames, ";", &save);
       while (token != NULL) {
-        length = strlen(token);
-        if (length > 0) {
-          monitoringname[j] = (char*)(malloc(++length));
-          if (monitoringname[j] != NULL) {
-            strncpy(monitoringname[j], token, length);
-            printf("Adding Process '%s' for monitoring\n", monitoringname[j]);
-            j++;
-            if (j > monitoringnamecount) {
-              fprintf(stderr, "To many names!\n");
-              return EXIT_FAILURE;
-            }
+        if (strlen(token) > 0) {
+          if (j >= context->monitoringnamecount) {
+            fprintf(stderr, "To many names!\n");
+            return EXIT_FAILURE;
           }
+          context->monitoringname[j] = token;
+          printf(
+            "Adding Process '%s' for monitoring\n",
+            context->monitoringname[j]);
+          j++;
         } else {
           fprintf(stderr, "Error: Empty process name\n");
           return EXIT_FAILURE;
         }
-        token = strtok(NULL, ";");
+        token = PM_STRTOK(NULL, ";", &save);
       }
+      context->monitoringnamecount = j;
     } else {
       fprintf(stderr, ERROR_TEXT_MEMORY);
       return EXIT_FAILURE;
@@ -194,335 +548,3165 @@ int pm_add_names(char* names) {
   return EXIT_SUCCESS;
 }
 
-int pm_set_types(char* types) {
-  length = strlen(types);
-  if (length > 0) {
-    for (i = 0; i < PM_TYPE_COUNT; ++i) {
-      if (strncmp(pm_type_arr[i].st, types, 0x10) == 0) {
-        type = pm_type_arr[i].type;
-        printf("Setting memory type to %s\n", pm_type_arr[i].lt);
-        return EXIT_SUCCESS;
+/* A tree target is a root process ID and every process it has started */
+int pm_context_add_trees(struct pm_context* context, char* roots) {
+  return pm_parse_ids(
+    roots,
+    &context->monitoringtree,
+    &context->monitoringtreecount,
+    "process tree of ID");
+}
+
+int pm_context_set_types(struct pm_context* context, char* types) {
+  char* token;
+  char* save;
+  size_t i, j;
+  int selected;
+  if (strlen(types) > 0) {
+    token = PM_STRTOK(types, ",", &save);
+    while (token != NULL) {
+      selected = PM_TYPE_UNKNOWN;
+      for (i = 0; i < PM_TYPE_COUNT; ++i) {
+        if (strncmp(pm_type_arr[i].st, token, 0x10) == 0) {
+          selected = pm_type_arr[i].type;
+          break;
+        }
       }
+      if (selected == PM_TYPE_UNKNOWN) {
+        fprintf(stderr, "Unknown memory type '%s'\n", token);
+        return EXIT_FAILURE;
+      }
+      for (j = 0; j < context->monitoringtypecount; ++j) {
+        if (context->monitoringtype[j] == selected) {
+          fprintf(stderr, "Memory type '%s' is already selected\n", token);
+          return EXIT_FAILURE;
+        }
+      }
+      context->monitoringtype[context->monitoringtypecount++] = selected;
+      printf("Adding memory type %s\n", pm_type_arr[i].lt);
+      token = PM_STRTOK(NULL, ",", &save);
+    }
+    if (context->monitoringtypecount > 0) {
+      return EXIT_SUCCESS;
     }
-    fprintf(stderr, "Unknown memory type '%s'\n", types);
-  } else {
-    fprintf(stderr, "Error: Type is empty!\n");
   }
+  fprintf(stderr, "Error: Type is empty!\n");
   return EXIT_FAILURE;
 }
 
-int pm_set_output(char* filename) {
-  if (!outputfilename) {
-    length = strlen(filename) + 1;
-    outputfilename = malloc(length);
-    if (outputfilename) {
-      strncpy(outputfilename, filename, length);
-      printf("Output file name is %s\n", outputfilename);
-    } else {
-      fprintf(stderr, ERROR_TEXT_MEMORY);
-      return EXIT_FAILURE;
-    }
-    return EXIT_SUCCESS;
+int pm_context_set_format(struct pm_context* context, char* format) {
+  if (strncmp(format, "csv", 0x10) == 0) {
+    context->outputformat = PM_FORMAT_CSV;
+  } else if (strncmp(format, "bin", 0x10) == 0) {
+    context->outputformat = PM_FORMAT_BIN;
+  } else if (strncmp(format, "pack", 0x10) == 0) {
+    context->outputformat = PM_FORMAT_PACK;
+  } else if (strncmp(format, "none", 0x10) == 0) {
+    context->outputformat = PM_FORMAT_NONE;
   } else {
-    fprintf(stderr, ERROR_TEXT_OUTPUT_ALREADY_SET);
+    fprintf(stderr, "Unknown output format '%s'\n", format);
     return EXIT_FAILURE;
   }
+  printf("Output format is %s\n", format);
+  return EXIT_SUCCESS;
 }
 
-int pm_init() {
-  int result;
-
-  monitoringcount = monitoringidcount + monitoringnamecount;
-
-  if (monitoringcount > 0) {
-    monitoring = (unsigned long long*)malloc(
-      monitoringcount * sizeof(unsigned long long));
-    if (monitoring == NULL) {
-      fprintf(stderr, ERROR_TEXT_MEMORY);
-      return EXIT_FAILURE;
-    }
-
-    if (outputfilename == NULL) {
-      length = sizeof(DEFAULT_OUTPUT_FILE_NAME);
-      outputfilename = malloc(length);
-      if (outputfilename != NULL) {
-        memcpy(
-          outputfilename,
-          DEFAULT_OUTPUT_FILE_NAME,
-          sizeof(DEFAULT_OUTPUT_FILE_NAME));
-      } else {
-        fprintf(stderr, ERROR_TEXT_MEMORY);
+/*
+ * The flush policy is a comma separated list of a row count, an interval
+ * like 500ms or shutdown to only flush when monitoring stops.
+ */
+int pm_context_set_flush(struct pm_context* context, char* policy) {
+  char* token;
+  char* save;
+  char* end;
+  unsigned long value;
+  context->writerrows = context->writerms = 0;
+  token = PM_STRTOK(policy, ",", &save);
+  while (token != NULL) {
+    if (strncmp(token, "shutdown", 0x10) != 0) {
+      value = strtoul(token, &end, 10);
+      if (end == token || value == 0) {
+        fprintf(stderr, "Invalid flush policy '%s'\n", token);
         return EXIT_FAILURE;
       }
-    }
-
-    if (outputfilename != NULL) {
-      outputfile = fopen(outputfilename, "w+");
-      if (outputfile) {
-        printf(
-          "Output file '%s' has been opened\n",
-          outputfilename);
+      if (strncmp(end, "ms", 0x10) == 0) {
+        context->writerms = value;
+        printf("Flushing the output every %lu ms\n", value);
+      } else if (*end == '\0') {
+        context->writerrows = value;
+        printf("Flushing the output every %lu rows\n", value);
       } else {
-        fprintf(
-          stderr,
-          "Failed to open output file '%s'\n",
-          outputfilename);
+        fprintf(stderr, "Invalid flush policy '%s'\n", token);
         return EXIT_FAILURE;
       }
     }
+    token = PM_STRTOK(NULL, ",", &save);
+  }
+  if (context->writerrows == 0 && context->writerms == 0) {
+    printf("Flushing the output on shutdown\n");
+  }
+  return EXIT_SUCCESS;
+}
 
-    if ((result = pm_write_header()) != EXIT_SUCCESS) {
-      return result;
-    }
+int pm_context_set_queue(struct pm_context* context, char* size) {
+  int value = atoi(size);
+  if (value > 0) {
+    context->writercapacity = (size_t)(value);
+    printf("Writer queue size is %d rows\n", value);
+    return EXIT_SUCCESS;
+  }
+  fprintf(stderr, "The queue size '%s' is not a positive number\n", size);
+  return EXIT_FAILURE;
+}
 
-    if (type == PM_TYPE_UNDEFINED || type == PM_TYPE_UNKNOWN) {
-      type = PM_DEFAULT_TYPE;
-      printf(
-        "Setting memory type to default %s\n",
-        pm_type_arr[PM_TYPE_DEFAULT_INDEX].lt);
-    }
+/* The processes the tables hold instead of twice those running at init */
+int pm_context_set_capacity(struct pm_context* context, char* processes) {
+  int value = atoi(processes);
+  if (value > 0) {
+    context->capacity = (size_t)(value);
+    printf("The process tables hold %d processes\n", value);
+    return EXIT_SUCCESS;
+  }
+  fprintf(
+    stderr,
+    "The capacity '%s' is not a positive number\n",
+    processes);
+  return EXIT_FAILURE;
+}
 
+int pm_context_set_threads(struct pm_context* context, char* threads) {
+  int value = atoi(threads);
+  if (value > 0 && value <= PM_SAMPLER_MAX_THREADS) {
+    context->samplerthreads = (unsigned int)(value);
+    printf("Sampling with %d threads\n", value);
     return EXIT_SUCCESS;
-  } else {
-#ifdef _WIN32
-    current = GetTickCount64();
-    elapsed = current - inittime;
-    if (EnumProcesses(pids, sizeof(pids), &penums)) {
-      pcount = penums / sizeof(DWORD);
-      for (i = 0; i < pcount; ++i) {
-        processname[0] = '\0';
-        hprocess = OpenProcess(
-          PROCESS_QUERY_INFORMATION | PROCESS_VM_READ,
-          FALSE,
-          pids[i]);
-        if (hprocess) {
-          if (EnumProcessModules(
-            hprocess,
-            &hmodule,
-            sizeof(hmodule),
-            &menums)) {
-            if (GetModuleBaseNameA(
-              hprocess,
-              hmodule,
-              processname,
-              sizeof(processname) / sizeof(CHAR)) == 0) {
-              processname[0] = '\0';
-            }
-          }
-          CloseHandle(hprocess);
-        }
-        if (processname[0] != '\0') {
-          printf("%d - %s\n", pids[i], processname);
-        } else {
-          printf("%d\n", pids[i]);
-        }
-      }
-    }
-#else
-#endif
-    printf("\nNothing to monitor. "
-      "Please select a process from the list above to monitor.\n");
-    return EXIT_FAILURE;
   }
+  fprintf(
+    stderr,
+    "The thread count '%s' is not a number from 1 to %d\n",
+    threads,
+    PM_SAMPLER_MAX_THREADS);
+  return EXIT_FAILURE;
 }
 
-void pm_start() {
-#ifdef _WIN32
-  inittime = GetTickCount64();
-#else
-#endif
+/*
+ * The expensive types of a process are read on one tick in every cadence,
+ * each process on its own tick of the cadence so their reads are spread
+ */
+int pm_context_set_cadence(struct pm_context* context, char* ticks) {
+  int value = atoi(ticks);
+  if (value > 0) {
+    context->cadence = (unsigned long)(value);
+    printf("Reading the expensive types every %d ticks\n", value);
+    return EXIT_SUCCESS;
+  }
+  fprintf(stderr, "The cadence '%s' is not a positive number of ticks\n", ticks);
+  return EXIT_FAILURE;
 }
 
-int pm_loop() {
-  int monitoring_index;
-  struct tm tsr;
-  memset(monitoring, 0x00, monitoringcount * sizeof(unsigned long long));
-  if (outputfile) {
+/*
+ * Each process is read again on the next tick while its values move and
+ * backs off to twice the ticks while they are flat, up to the given ticks.
+ * The values of a process that is not due are carried forward.
+ */
+int pm_context_set_adaptive(struct pm_context* context, char* ticks) {
 #ifdef _WIN32
-    current = GetTickCount64();
-    elapsed = current - inittime;
-    if (EnumProcesses(pids, sizeof(pids), &penums)) {
-      pcount = penums / sizeof(DWORD);
-      for (i = pcount - 1; i >= 0; --i) {
-        hprocess = OpenProcess(
-          PROCESS_QUERY_INFORMATION | PROCESS_VM_READ,
-          FALSE,
-          pids[i]);
-        if (hprocess) {
-          if ((monitoring_index = pm_is_monitored_id(pids[i])) >= 0) {
-            monitoring[monitoring_index] = pm_get_value(
-              &hprocess,
-              pids[i],
-              type);
-          } else {
-            if (EnumProcessModules(
-              hprocess,
-              &hmodule,
-              sizeof(hmodule),
-              &menums)) {
-              if (GetModuleBaseNameA(
-                hprocess,
-                hmodule,
-                processname,
-                sizeof(processname) / sizeof(CHAR)) > 0) {
-                if ((monitoring_index = pm_is_monitored_name(processname)) >= 0) {
-                  monitoring[monitoring_index] = pm_get_value(
-                    &hprocess,
-                    pids[i],
-                    type);
-                }
-              }
-            }
-          }
-          CloseHandle(hprocess);
-        } else {
-          if (pm_is_monitored_id(pids[i]) >= 0) {
-            fprintf(stderr, "Failed to open process %d\n", pids[i]);
-          }
-        }
-      }
-    } else {
-      pcount = -1;
-      fprintf(stderr, "Failed to enumerate processes\n");
-    }
+  (void)(context);
+  (void)(ticks);
+  fprintf(stderr, "Adaptive sampling is not supported on Windows\n");
+  return EXIT_FAILURE;
 #else
+  int value = atoi(ticks);
+  if (value > 1) {
+    context->adaptive = (unsigned long)(value);
+    printf("Reading flat processes at most every %d ticks\n", value);
+    return EXIT_SUCCESS;
+  }
+  fprintf(
+    stderr,
+    "The adaptive ceiling '%s' is not a number of ticks above 1\n",
+    ticks);
+  return EXIT_FAILURE;
 #endif
+}
 
-    currtime = time(NULL);
-    gmtime_s(&tsr, &currtime);
-    strftime(pm_text_buffer, PM_TEXT_BUFFER_SIZE, "%y-%m-%d,%H:%M:%S", &tsr);
-    fprintf(outputfile, "%s", pm_text_buffer);
-    fprintf(outputfile, ",%llu", elapsed);
-    for (j = 0; j < monitoringcount; ++j) {
-      fprintf(outputfile, ",%llu", monitoring[j]);
-    }
-    fprintf(outputfile, ",%d\n", pcount);
-
-    if (fflush(outputfile) != 0) {
-      fprintf(stderr, ERROR_TEXT_FAILED_FLUSH_OUTPUT_FILE);
+int pm_context_set_output(struct pm_context* context, char* filename) {
+  size_t length;
+  if (!context->outputfilename) {
+    length = strlen(filename) + 1;
+    context->outputfilename = malloc(length);
+    if (context->outputfilename) {
+      memcpy(context->outputfilename, filename, length);
+      printf("Output file name is %s\n", context->outputfilename);
+    } else {
+      fprintf(stderr, ERROR_TEXT_MEMORY);
+      return EXIT_FAILURE;
     }
     return EXIT_SUCCESS;
   } else {
-    fprintf(stderr, ERROR_TEXT_OUTPUT_FILE_NOT_OPEN);
+    fprintf(stderr, ERROR_TEXT_OUTPUT_ALREADY_SET);
     return EXIT_FAILURE;
   }
 }
 
-void pm_shutdown() {
-  if (outputfile) {
-    if (fclose(outputfile) == 0) {
-      printf("Closed the output file\n");
-    } else {
-      fprintf(stderr, "Failed to closed output file\n");
-    }
-    outputfile = NULL;
+/* The most recent rows are kept in memory for pm_query */
+int pm_context_set_retention(struct pm_context* context, char* rows) {
+  int value = atoi(rows);
+  if (value > 0) {
+    context->retention = (size_t)(value);
+    printf("Keeping the last %d rows in memory\n", value);
+    return EXIT_SUCCESS;
   }
+  fprintf(stderr, "The retention '%s' is not a positive number\n", rows);
+  return EXIT_FAILURE;
+}
 
-  if (monitoringname) {
-    for (j = 0; j < monitoringnamecount; ++j) {
-      free(monitoringname[j]);
+/*
+ * Write one summary row per rollup window of seconds, or minutes with an m
+ * suffix, instead of every row. Windows start at multiples of the window
+ * in UTC so the rows of different hosts line up.
+ */
+int pm_context_set_rollup(struct pm_context* context, char* window) {
+  unsigned long value;
+  char* end;
+  value = strtoul(window, &end, 10);
+  if (end != window && value > 0) {
+    if (*end == 'm' && end[1] == '\0') {
+      value *= 60;
+    } else if (!(*end == '\0' || (*end == 's' && end[1] == '\0'))) {
+      value = 0;
     }
-    free(monitoringname);
-    monitoringname = NULL;
-  }
-
-  if (monitoringid) {
-    free(monitoringid);
-    monitoringid = NULL;
   }
-
-  if (monitoring) {
-    free(monitoring);
-    monitoring = NULL;
+  if (end == window || value == 0) {
+    fprintf(stderr, "Invalid rollup window '%s'\n", window);
+    return EXIT_FAILURE;
   }
+  context->rollup = value;
+  printf("Rolling up every %lu seconds\n", value);
+  return EXIT_SUCCESS;
+}
 
-  if (outputfilename) {
-    free(outputfilename);
-    outputfilename = NULL;
+/*
+ * Rank every process on each tick and keep the top count of them, by the
+ * type set with pm_context_set_by, instead of monitoring targets.
+ */
+int pm_context_set_top(struct pm_context* context, char* count) {
+  int value = atoi(count);
+  if (value > 0) {
+    context->top = (size_t)(value);
+    printf("Monitoring the top %d processes\n", value);
+    return EXIT_SUCCESS;
   }
+  fprintf(stderr, "The top count '%s' is not a positive number\n", count);
+  return EXIT_FAILURE;
 }
 
-unsigned long long pm_get_value(void* p, int id, int type) {
-#ifdef _WIN32
-  HANDLE* hp;
-  hp = (HANDLE*)(p);
-  if (GetProcessMemoryInfo(*hp, &pmc, sizeof(pmc))) {
-    switch (type) {
-      case PM_TYPE_PAGE_FAULT_COUNT:
-        return pmc.PageFaultCount;
-      case PM_TYPE_PEAK_WORKING_SET_SIZE:
-        return pmc.PeakWorkingSetSize;
-      case PM_TYPE_WORKING_SET_SIZE:
-        return pmc.WorkingSetSize;
-      case PM_TYPE_QUOTA_PEAK_PAGED_POOL_USAGE:
-        return pmc.QuotaPeakPagedPoolUsage;
-      case PM_TYPE_QUOTA_PAGED_POOL_USAGE:
-        return pmc.QuotaPagedPoolUsage;
-      case PM_TYPE_QUOTA_PEAK_NON_PAGED_POOL_USAGE:
-        return pmc.QuotaPeakNonPagedPoolUsage;
-      case PM_TYPE_QUOTA_NON_PAGED_POOL_USAGE:
-        return pmc.QuotaNonPagedPoolUsage;
-      case PM_TYPE_PAGEFILE_USAGE:
-        return pmc.PagefileUsage;
-      case PM_TYPE_PEAK_PAGEFILE_USAGE:
-        return pmc.PeakPagefileUsage;
-      default:
-        fprintf(stderr, "Unknown memory type %d\n", type);
-        return 0;
+int pm_context_set_by(struct pm_context* context, char* type) {
+  size_t i;
+  for (i = 0; i < PM_TYPE_COUNT; ++i) {
+    if (strncmp(pm_type_arr[i].st, type, 0x10) == 0) {
+      context->topby = pm_type_arr[i].type;
+      printf("Ranking processes by %s\n", pm_type_arr[i].lt);
+      return EXIT_SUCCESS;
     }
-  } else {
-    fprintf(stderr, "Failed to get memory information for process ID %d\n", id);
-    return 0;
   }
-#else
-  return 0;
-#endif
+  fprintf(stderr, "Unknown memory type '%s'\n", type);
+  return EXIT_FAILURE;
 }
 
-int pm_is_monitored_id(const int id) {
-  for (j = 0; j < monitoringidcount; ++j) {
-    if (monitoringid[j] == id) {
-      return j;
-    }
+/* Print the time each phase of a tick took when monitoring stops */
+int pm_context_set_self_stats(struct pm_context* context, int enabled) {
+  context->selfstats = enabled != 0;
+  if (context->selfstats) {
+    printf("Timing the phases of every tick\n");
   }
-  return -1;
+  return EXIT_SUCCESS;
 }
 
-int pm_is_monitored_name(const char* name) {
-  for (j = 0; j < monitoringnamecount; ++j) {
-    if (strncmp(name, monitoringname[j], PM_PROCESS_NAME_SIZE) == 0) {
-      return ((int)(monitoringidcount)) + j ;
-    }
+/*
+ * Give the rows the elapsed time in us instead of ms, for intervals below
+ * a ms. The rules, the ages, the kept rows and the shared and served views
+ * stay in ms.
+ */
+int pm_context_set_microseconds(struct pm_context* context, int enabled) {
+  context->microseconds = enabled != 0;
+  return EXIT_SUCCESS;
+}
+
+/* Write every phase of every tick as a Chrome trace event */
+int pm_context_set_trace(struct pm_context* context, char* filename) {
+  size_t length;
+  if (context->tracefilename) {
+    fprintf(stderr, "The trace file name has already been set\n");
+    return EXIT_FAILURE;
   }
-  return -1;
+  length = strlen(filename) + 1;
+  context->tracefilename = malloc(length);
+  if (context->tracefilename == NULL) {
+    fprintf(stderr, ERROR_TEXT_MEMORY);
+    return EXIT_FAILURE;
+  }
+  memcpy(context->tracefilename, filename, length);
+  printf("Trace file name is %s\n", context->tracefilename);
+  return EXIT_SUCCESS;
 }
 
-int pm_write_header() {
-  if (outputfile) {
-    fprintf(outputfile, "date,time,elapsed");
-    for (j = 0; j < monitoringidcount; ++j) {
-      fprintf(outputfile, ",%d", monitoringid[j]);
+/*
+ * Rules separated by , are checked against every target on each tick it
+ * was read, see pm_rule_parse for their form
+ */
+int pm_context_add_rules(struct pm_context* context, char* rules) {
+  struct pm_rule* rule;
+  char* token;
+  char* save;
+  size_t i, length;
+  token = PM_STRTOK(rules, ",", &save);
+  while (token != NULL) {
+    if (context->rules.count == PM_RULES_MAX) {
+      fprintf(stderr, "At most %d rules can be added\n", PM_RULES_MAX);
+      return EXIT_FAILURE;
     }
-    for (j = 0; j < monitoringnamecount; ++j) {
-      fprintf(outputfile, ",%s", monitoringname[j]);
+    for (i = 0; i < PM_TYPE_COUNT; ++i) {
+      length = strlen(pm_type_arr[i].st);
+      if (strncmp(pm_type_arr[i].st, token, length) == 0 &&
+        (token[length] == '>' || token[length] == '<' ||
+          token[length] == '+')) {
+        break;
+      }
     }
-    fprintf(outputfile, ",count\n");
-    if (fflush(outputfile) != 0) {
-      fprintf(stderr, ERROR_TEXT_FAILED_FLUSH_OUTPUT_FILE);
+    rule = &context->rules.rule[context->rules.count];
+    if (i == PM_TYPE_COUNT ||
+      pm_rule_parse(rule, pm_type_arr[i].type, token) != EXIT_SUCCESS) {
+      fprintf(stderr, "Rule '%s' is not like wss>2G:5 or wss+100M/h\n", token);
+      return EXIT_FAILURE;
     }
-    return EXIT_SUCCESS;
-  } else {
-    fprintf(stderr, ERROR_TEXT_OUTPUT_FILE_NOT_OPEN);
+    ++context->rules.count;
+    printf("Adding rule %s\n", rule->text);
+    token = PM_STRTOK(NULL, ",", &save);
+  }
+  return EXIT_SUCCESS;
+}
+
+/* Where the rule events go, pm_events.csv when rules are added without */
+int pm_context_set_events(struct pm_context* context, char* filename) {
+  size_t length;
+  if (context->eventsfilename) {
+    fprintf(stderr, "The events file name has already been set\n");
     return EXIT_FAILURE;
   }
+  length = strlen(filename) + 1;
+  context->eventsfilename = malloc(length);
+  if (context->eventsfilename == NULL) {
+    fprintf(stderr, ERROR_TEXT_MEMORY);
+    return EXIT_FAILURE;
+  }
+  memcpy(context->eventsfilename, filename, length);
+  printf("Events file name is %s\n", context->eventsfilename);
+  return EXIT_SUCCESS;
 }
 
-size_t pm_count_delimiters(char* s, char ch) {
-  size_t count = 0;
-  length = strlen(s);
-  if (length > 0) {
-    for (count = 0; s[count]; s[count] == ch ? (count++) : (*(s++)));
-    ++count;
+/*
+ * Serve the latest sample in the OpenMetrics text format on unix:/path or
+ * on a loopback [host:]port
+ */
+int pm_context_set_listen(struct pm_context* context, char* address) {
+#ifdef _WIN32
+  (void)(context);
+  (void)(address);
+  fprintf(stderr, "Serving the metrics is not supported on Windows\n");
+  return EXIT_FAILURE;
+#else
+  size_t length;
+  if (context->listenaddress) {
+    fprintf(stderr, "The listen address has already been set\n");
+    return EXIT_FAILURE;
+  }
+  length = strlen(address) + 1;
+  context->listenaddress = malloc(length);
+  if (context->listenaddress == NULL) {
+    fprintf(stderr, ERROR_TEXT_MEMORY);
+    return EXIT_FAILURE;
+  }
+  memcpy(context->listenaddress, address, length);
+  printf("Listen address is %s\n", context->listenaddress);
+  return EXIT_SUCCESS;
+#endif
+}
+
+/*
+ * Publish every row with the target and type names into the named POSIX
+ * shared memory segment for pmcli --attach
+ */
+int pm_context_set_share(struct pm_context* context, char* name) {
+#ifdef _WIN32
+  (void)(context);
+  (void)(name);
+  fprintf(stderr, "Sharing the view is not supported on Windows\n");
+  return EXIT_FAILURE;
+#else
+  size_t length;
+  if (context->sharename) {
+    fprintf(stderr, "The shared view name has already been set\n");
+    return EXIT_FAILURE;
+  }
+  length = strlen(name) + 1;
+  context->sharename = malloc(length);
+  if (context->sharename == NULL) {
+    fprintf(stderr, ERROR_TEXT_MEMORY);
+    return EXIT_FAILURE;
+  }
+  memcpy(context->sharename, name, length);
+  printf("Shared view name is %s\n", context->sharename);
+  return EXIT_SUCCESS;
+#endif
+}
+
+/*
+ * Read the processes from a copy of the procfs tree, such as the fixture
+ * pm_bench generates, instead of /proc
+ */
+int pm_context_set_procfs(struct pm_context* context, char* root) {
+#ifdef _WIN32
+  fprintf(stderr, "A procfs root is not supported on Windows\n");
+  return EXIT_FAILURE;
+#else
+  size_t length;
+  if (context->procfsroot) {
+    fprintf(stderr, "The procfs root has already been set\n");
+    return EXIT_FAILURE;
+  }
+  length = strlen(root) + 1;
+  context->procfsroot = malloc(length);
+  if (context->procfsroot == NULL) {
+    fprintf(stderr, ERROR_TEXT_MEMORY);
+    return EXIT_FAILURE;
+  }
+  memcpy(context->procfsroot, root, length);
+  context->directory.root = context->procfsroot;
+  printf("Procfs root is %s\n", context->procfsroot);
+  return EXIT_SUCCESS;
+#endif
+}
+
+/* Rows go to the sink on the sampling thread and no file is written */
+int pm_context_set_sink(struct pm_context* context, pm_sink sink, void* user) {
+  if (context->initialized) {
+    fprintf(stderr, ERROR_TEXT_ALREADY_INITIALIZED);
+    return EXIT_FAILURE;
+  }
+  context->sink = sink;
+  context->sinkuser = user;
+  context->outputformat = PM_FORMAT_NONE;
+  return EXIT_SUCCESS;
+}
+
+int pm_context_init(struct pm_context* context) {
+  size_t j;
+  int result;
+
+  if (context->initialized) {
+    fprintf(stderr, ERROR_TEXT_ALREADY_INITIALIZED);
+    return EXIT_FAILURE;
+  }
+
+  context->monitoringcount = context->monitoringidcount +
+    context->monitoringnamecount + context->monitoringtreecount;
+  context->monitoringextracount = context->monitoringtreecount;
+
+  if (context->top > 0) {
+    if (context->monitoringcount > 0) {
+      fprintf(stderr, "The top processes can not be monitored with targets\n");
+      return EXIT_FAILURE;
+    }
+    if (context->rules.count > 0) {
+      fprintf(stderr, "Rules can not be checked on the top processes\n");
+      return EXIT_FAILURE;
+    }
+    context->monitoringcount = context->top;
+    context->monitoringextracount = context->top;
+  }
+
+  if (context->monitoringcount > 0) {
+    if (context->monitoringtypecount == 0 && context->topby == 0) {
+      context->monitoringtype[context->monitoringtypecount++] = PM_DEFAULT_TYPE;
+      printf(
+        "Setting memory type to default %s\n",
+        pm_type_arr[PM_TYPE_DEFAULT_INDEX].lt);
+    }
+
+    if (context->top > 0) {
+      pm_rank_type(context);
+    }
+
+    if (context->rollup > 0 && context->outputformat != PM_FORMAT_CSV &&
+      context->outputformat != PM_FORMAT_NONE) {
+      fprintf(stderr, "The rollup is only written in the csv format\n");
+      return EXIT_FAILURE;
+    }
+
+    if ((result = pm_compile_plan(context)) != EXIT_SUCCESS) {
+      return result;
+    }
+
+    if ((result = pm_bind_rules(context)) != EXIT_SUCCESS) {
+      return result;
+    }
+
+#ifndef _WIN32
+    if (context->procfs.slow != 0 || context->adaptive > 0) {
+      context->monitoringagecount = context->monitoringcount;
+    }
+#endif
+    context->monitoringvaluecount =
+      context->monitoringcount * context->monitoringtypecount;
+    context->monitoringagestart =
+      context->monitoringvaluecount + context->monitoringextracount;
+    context->monitoringextracount += context->monitoringagecount;
+    context->monitoringcolumncount =
+      context->monitoringvaluecount + context->monitoringextracount;
+
+    if ((result = pm_reserve(context)) != EXIT_SUCCESS) {
+      return result;
+    }
+
+    if ((result = pm_carve(context)) != EXIT_SUCCESS) {
+      return result;
+    }
+
+    if (context->retention > 0) {
+      printf(
+        "The store keeps %lu rows of %lu columns in %lu bytes\n",
+        (unsigned long)(context->retention),
+        (unsigned long)(context->monitoringcolumncount),
+        (unsigned long)(pm_store_bytes(
+          context->monitoringcolumncount,
+          context->retention)));
+    }
+
+    for (j = 0; j < PM_PHASE_COUNT; ++j) {
+      pm_stats_reset(&context->phase[j]);
+    }
+    context->tracestart = pm_stats_now();
+    if (context->tracefilename) {
+      context->tracefile = fopen(context->tracefilename, "w");
+      if (context->tracefile == NULL) {
+        fprintf(
+          stderr,
+          "Failed to open trace file '%s'\n",
+          context->tracefilename);
+        return EXIT_FAILURE;
+      }
+      fprintf(context->tracefile, "[\n");
+    }
+
+    if (context->rules.count > 0) {
+      if ((result = pm_open_events(context)) != EXIT_SUCCESS) {
+        return result;
+      }
+      if (pm_writer_start(
+        &context->eventwriter,
+        PM_EVENT_WORDS,
+        PM_EVENT_QUEUE_SIZE,
+        1,
+        0,
+        pm_write_event,
+        pm_flush_events,
+        context,
+        &context->arena) != EXIT_SUCCESS) {
+        fprintf(stderr, "Failed to start the events writer thread\n");
+        return EXIT_FAILURE;
+      }
+    }
+
+    if (pm_sampler_start(
+      &context->sampler,
+      context->samplerthreads,
+      pm_sample_item,
+      context,
+      &context->arena) != EXIT_SUCCESS) {
+      fprintf(stderr, "Failed to start the sampler threads\n");
+      return EXIT_FAILURE;
+    }
+
+    if (context->outputformat != PM_FORMAT_NONE) {
+      if ((result = pm_open_output(context)) != EXIT_SUCCESS) {
+        return result;
+      }
+
+      if ((result = pm_write_header(context)) != EXIT_SUCCESS) {
+        return result;
+      }
+
+      if (pm_writer_start(
+        &context->writer,
+        context->writercolumns,
+        context->writercapacity,
+        context->outputformat == PM_FORMAT_PACK &&
+          context->writerrows > 0 && context->writerrows < PM_PACK_BLOCK_ROWS ?
+          PM_PACK_BLOCK_ROWS : context->writerrows,
+        context->writerms,
+        pm_write_record,
+        pm_flush_output,
+        context,
+        &context->arena) != EXIT_SUCCESS) {
+        fprintf(stderr, "Failed to start the writer thread\n");
+        return EXIT_FAILURE;
+      }
+    }
+
+#ifndef _WIN32
+    if (context->listenaddress) {
+      if (pm_serve_start(
+        &context->serve,
+        context->listenaddress,
+        context->monitoringcolumncount,
+        PM_SERVE_BODY_SIZE(
+          context->monitoringcolumncount,
+          context->monitoringtypecount),
+        pm_render_metrics,
+        context,
+        &context->arena) != EXIT_SUCCESS) {
+        fprintf(
+          stderr,
+          "Failed to listen on '%s', use unix:/path or a loopback port\n",
+          context->listenaddress);
+        return EXIT_FAILURE;
+      }
+      printf("Serving the metrics on %s\n", context->listenaddress);
+    }
+#endif
+
+    if (context->sharename &&
+      (result = pm_create_share(context)) != EXIT_SUCCESS) {
+      return result;
+    }
+
+    context->initialized = true;
+    return EXIT_SUCCESS;
+  } else {
+    pm_list(context);
+    printf("\nNothing to monitor. "
+      "Please select a process from the list above to monitor.\n");
+    return EXIT_FAILURE;
+  }
+}
+
+void pm_context_start(struct pm_context* context) {
+  context->initstamp = pm_stats_now();
+#ifdef _WIN32
+  context->inittime = GetTickCount64();
+#else
+  clock_gettime(CLOCK_MONOTONIC, &context->inittime);
+#endif
+}
+
+/*
+ * Sample every target once. The row goes to the writer thread, to the
+ * sink or only to sample when it is given.
+ */
+int pm_sample(struct pm_context* context, struct pm_sample* sample) {
+  unsigned long long tickstart, start, resolvestart;
+  struct pm_cache_entry* entry;
+  struct pm_sample row;
+  int result;
+#ifdef _WIN32
+  char processname[PM_PROCESS_NAME_SIZE];
+  FILETIME creationtime, exittime, kerneltime, usertime;
+  unsigned long long processstart;
+  HMODULE hmodule;
+  HANDLE hprocess;
+  DWORD penums, menums;
+  int i, pcount;
+#else
+  struct timespec current;
+  int pid;
+#endif
+  if (!context->initialized) {
+    fprintf(stderr, ERROR_TEXT_NOT_INITIALIZED);
+    return EXIT_FAILURE;
+  }
+  memset(
+    context->monitoring,
+    0x00,
+    context->monitoringcolumncount * sizeof(unsigned long long));
+  if (context->seen != NULL) {
+    memset(context->seen, 0x00, context->monitoringcount * sizeof(bool));
+  }
+  ++context->tick;
+  tickstart = start = pm_stats_now();
+#ifdef _WIN32
+  context->elapsed = GetTickCount64() - context->inittime;
+  if (pm_enumerate(context, &penums) == EXIT_SUCCESS) {
+    pcount = (int)(penums);
+    context->pcount = pcount;
+    context->itemcount = 0;
+    for (i = pcount - 1; i >= 0; --i) {
+      if ((entry = pm_cache_find(&context->cache, context->pids[i])) == NULL) {
+        resolvestart = pm_stats_now();
+        hprocess = OpenProcess(
+          PROCESS_QUERY_INFORMATION | PROCESS_VM_READ,
+          FALSE,
+          context->pids[i]);
+        if (hprocess) {
+          processstart = 0;
+          if (GetProcessTimes(
+            hprocess,
+            &creationtime,
+            &exittime,
+            &kerneltime,
+            &usertime)) {
+            processstart =
+              ((unsigned long long)(creationtime.dwHighDateTime) << 32) |
+              creationtime.dwLowDateTime;
+          }
+          processname[0] = '\0';
+          if (EnumProcessModules(
+            hprocess,
+            &hmodule,
+            sizeof(hmodule),
+            &menums)) {
+            if (GetModuleBaseNameA(
+              hprocess,
+              hmodule,
+              processname,
+              sizeof(processname) / sizeof(CHAR)) == 0) {
+              processname[0] = '\0';
+            }
+          }
+          entry = pm_resolve(
+            context,
+            context->pids[i],
+            processstart,
+            processname,
+            pm_parent(context, context->pids[i]));
+          CloseHandle(hprocess);
+        } else if (pm_is_monitored_id(context, context->pids[i]) >= 0) {
+          fprintf(stderr, "Failed to open process %d\n", context->pids[i]);
+        } else {
+          entry = pm_resolve(context, context->pids[i], 0, "", 0);
+        }
+        pm_phase(context, PM_PHASE_RESOLVE, resolvestart);
+      }
+      if (entry != NULL) {
+        entry->tick = context->tick;
+        if (entry->target >= 0 || entry->tree >= 0 ||
+          (context->top > 0 && entry->start != 0)) {
+          pm_add_item(context, entry, context->pids[i]);
+        }
+      }
+    }
+    if (pm_resolve_pending(context) != EXIT_SUCCESS) {
+      return EXIT_FAILURE;
+    }
+    start = pm_phase(context, PM_PHASE_ENUMERATE, start);
+    pm_sampler_run(&context->sampler, context->itemcount);
+    start = pm_phase(context, PM_PHASE_READ, start);
+    pm_merge(context);
+    pm_rank(context);
+    pm_evict(context);
+    start = pm_phase(context, PM_PHASE_MERGE, start);
+    if (context->rules.count > 0) {
+      pm_check_rules(context);
+      start = pm_phase(context, PM_PHASE_RULES, start);
+    }
+  } else {
+    context->pcount = -1;
+    fprintf(stderr, "Failed to enumerate processes\n");
+  }
+#else
+  pm_procfs_count_reset(&context->count);
+  clock_gettime(CLOCK_MONOTONIC, &current);
+  context->elapsed =
+    1000ULL * (unsigned long long)(current.tv_sec - context->inittime.tv_sec) +
+    (unsigned long long)(current.tv_nsec / 1000000L) -
+    (unsigned long long)(context->inittime.tv_nsec / 1000000L);
+  if (pm_procfs_enumerate_begin(&context->directory, &context->count) ==
+    EXIT_SUCCESS) {
+    context->pcount = 0;
+    context->itemcount = 0;
+    while ((pid = pm_procfs_enumerate_next(
+      &context->directory,
+      &context->count)) > 0) {
+      ++context->pcount;
+      if ((entry = pm_cache_find(&context->cache, pid)) == NULL) {
+        resolvestart = pm_stats_now();
+        entry = pm_resolve_procfs(context, pid);
+        pm_phase(context, PM_PHASE_RESOLVE, resolvestart);
+        if (entry == NULL) {
+          continue;
+        }
+      }
+      entry->tick = context->tick;
+      if (entry->target >= 0 || entry->tree >= 0 || context->top > 0) {
+        pm_add_item(context, entry, pid);
+      }
+    }
+    if (pm_resolve_pending(context) != EXIT_SUCCESS) {
+      return EXIT_FAILURE;
+    }
+    start = pm_phase(context, PM_PHASE_ENUMERATE, start);
+    pm_sampler_run(&context->sampler, context->itemcount);
+    start = pm_phase(context, PM_PHASE_READ, start);
+    pm_merge(context);
+    pm_rank(context);
+    pm_evict(context);
+    start = pm_phase(context, PM_PHASE_MERGE, start);
+    if (context->rules.count > 0) {
+      pm_check_rules(context);
+      start = pm_phase(context, PM_PHASE_RULES, start);
+    }
+  } else {
+    context->pcount = -1;
+    fprintf(stderr, "Failed to enumerate processes\n");
+  }
+  context->syscallcount = context->count;
+#endif
+  if (context->overflow > 0 && !context->overflowed) {
+    context->overflowed = true;
+    fprintf(
+      stderr,
+      "The process tables for %lu processes are full, new processes are "
+      "left out until others exit or the capacity is raised\n",
+      (unsigned long)(context->cachecapacity));
+  }
+
+  row.time = (long long)(time(NULL));
+  row.elapsed = context->microseconds ?
+    (tickstart - context->initstamp) / 1000ULL : context->elapsed;
+  row.count = context->pcount;
+  row.columns = context->monitoringcolumncount;
+  row.values = context->monitoring;
+#ifndef _WIN32
+  if (context->serve.running) {
+    pm_serve_publish(
+      &context->serve,
+      row.time,
+      context->elapsed,
+      row.values,
+      row.count);
+  }
+#endif
+  if (context->share.header != NULL) {
+    pm_share_publish(
+      &context->share,
+      row.time,
+      context->elapsed,
+      context->tick,
+      row.values,
+      row.count);
+  }
+  if (sample != NULL) {
+    *sample = row;
+  }
+  /* In adaptive mode a tick that read nothing new adds no row */
+  result = EXIT_SUCCESS;
+  if (context->adaptive == 0 || context->readcount > 0 ||
+    context->itemcount != context->previtemcount) {
+    if (context->store.capacity > 0) {
+      pm_store_append(&context->store, context->elapsed, row.values);
+    }
+    result = pm_deliver(context, &row);
+  }
+  context->previtemcount = context->itemcount;
+  pm_phase(context, PM_PHASE_DELIVER, start);
+  pm_phase(context, PM_PHASE_TICK, tickstart);
+  return result;
+}
+
+/* Stop the sampler and writer threads, draining the rows still queued */
+void pm_context_stop(struct pm_context* context) {
+#ifndef _WIN32
+  pm_serve_stop(&context->serve);
+#endif
+  pm_share_destroy(&context->share);
+  pm_sampler_stop(&context->sampler);
+  if (context->rolled > 0 && pm_roll_emit(context) != EXIT_SUCCESS) {
+    fprintf(stderr, "Failed to write to the output file\n");
+  }
+  if (pm_writer_stop(&context->writer) != EXIT_SUCCESS) {
+    fprintf(stderr, "Failed to write to the output file\n");
+  }
+  if (pm_writer_stop(&context->eventwriter) != EXIT_SUCCESS) {
+    fprintf(stderr, "Failed to write to the events file\n");
+  }
+}
+
+int pm_query(
+  const struct pm_context* context,
+  size_t column,
+  unsigned long long window,
+  struct pm_window* result) {
+  return pm_store_window(&context->store, column, window, result);
+}
+
+void pm_context_report(const struct pm_context* context) {
+  struct pm_sampler_count samplercount;
+  struct pm_writer_count writercount;
+  const struct pm_stats_histogram* phase;
+  char text[PM_TEXT_BUFFER_SIZE];
+  struct pm_window window;
+  size_t k;
+  pm_context_get_sampler_count(context, &samplercount);
+  if (samplercount.ticks > 0) {
+    printf(
+      "The sampler used %u threads, first to last sample spread "
+      "last %.3f us, max %.3f us, mean %.3f us, %llu samples stolen\n",
+      samplercount.threads,
+      (double)(samplercount.spread) / 1000.0,
+      (double)(samplercount.spreadmax) / 1000.0,
+      (double)(samplercount.spreadsum) / samplercount.ticks / 1000.0,
+      samplercount.stolen);
+  }
+
+  for (k = 0; k < context->store.columns; ++k) {
+    if (pm_query(context, k, 0, &window) == EXIT_SUCCESS &&
+      pm_context_column_name(context, k, text, PM_TEXT_BUFFER_SIZE) ==
+      EXIT_SUCCESS) {
+      printf(
+        "%s over the last %lu rows min %llu, max %llu, mean %.1f, last %llu\n",
+        text,
+        (unsigned long)(window.count),
+        window.min,
+        window.max,
+        window.mean,
+        window.last);
+    }
+  }
+
+  if (context->tick > 0) {
+    printf(
+      "The arena holds %lu bytes with room for %lu processes, "
+      "%llu left out as the tables were full\n",
+      (unsigned long)(context->arena.size),
+      (unsigned long)(context->cachecapacity),
+      context->overflow);
+  }
+
+  if (context->top > 0 && context->tick > 0) {
+    printf(
+      "The last tick ranked %lu processes by %s\n",
+      (unsigned long)(context->ranked),
+      pm_type_arr[context->topby - 1].lt);
+  }
+
+  if (context->rules.count > 0 && context->tick > 0) {
+    pm_writer_get_count(&context->eventwriter, &writercount);
+    printf(
+      "%lu rules raised %llu events, written to %s, %llu dropped\n",
+      (unsigned long)(context->rules.count),
+      context->rules.events,
+      context->eventsfilename,
+      writercount.dropped);
+  }
+
+#ifndef _WIN32
+  if (context->listenaddress && context->tick > 0) {
+    printf(
+      "The endpoint served %llu scrapes, rendering took mean %.3f us, "
+      "%llu snapshot retries\n",
+      context->serve.scrapes,
+      context->serve.scrapes > 0 ?
+        (double)(context->serve.renderns) /
+          (double)(context->serve.scrapes) / 1000.0 : 0.0,
+      context->serve.retries);
+  }
+#endif
+
+  if (context->selfstats) {
+    printf(
+      "%-10s %10s %10s %10s %10s %10s\n",
+      "Phase", "count", "mean us", "p50 us", "p99 us", "max us");
+    for (k = 0; k < PM_PHASE_COUNT; ++k) {
+      phase = &context->phase[k];
+      if (phase->count == 0) {
+        continue;
+      }
+      printf(
+        "%-10s %10llu %10.1f %10.1f %10.1f %10.1f\n",
+        pm_stats_phase_name[k],
+        phase->count,
+        (double)(phase->sum) / (double)(phase->count) / 1000.0,
+        (double)(pm_stats_quantile(phase, 0.50)) / 1000.0,
+        (double)(pm_stats_quantile(phase, 0.99)) / 1000.0,
+        (double)(phase->max) / 1000.0);
+    }
+  }
+
+  pm_context_get_writer_count(context, &writercount);
+  if (writercount.capacity > 0) {
+    printf(
+      "The writer wrote %llu rows with %llu flushes, "
+      "%llu rows dropped, queue high water %lu of %lu\n",
+      writercount.written,
+      writercount.flushes,
+      writercount.dropped,
+      (unsigned long)(writercount.highwater),
+      (unsigned long)(writercount.capacity));
+  }
+
+#ifndef _WIN32
+  if (context->tick > 0) {
+    printf(
+      "The last tick made %lu system calls, "
+      "%lu reads of %lu open metric files\n",
+      context->syscallcount.total,
+      context->syscallcount.reads,
+      context->syscallcount.files);
+  }
+#endif
+}
+
+void pm_destroy(struct pm_context* context) {
+  size_t j;
+  if (context == NULL) {
+    return;
+  }
+
+  pm_context_stop(context);
+
+#ifndef _WIN32
+  for (j = 0; j < context->cache.count; ++j) {
+    pm_procfs_close(&context->cache.entry[j].process, &context->count);
+  }
+  pm_procfs_enumerate_close(&context->directory);
+#endif
+  pm_cache_destroy(&context->cache);
+  pm_store_destroy(&context->store);
+
+  if (context->outputfile) {
+    if (fclose(context->outputfile) == 0) {
+      printf("Closed the output file\n");
+    } else {
+      fprintf(stderr, "Failed to closed output file\n");
+    }
+    context->outputfile = NULL;
+  }
+
+  if (context->binary.base) {
+    if (pm_binary_close(&context->binary) == EXIT_SUCCESS) {
+      printf("Closed the output file\n");
+    } else {
+      fprintf(stderr, "Failed to closed output file\n");
+    }
+  }
+
+  if (context->packed.file) {
+    if (pm_packed_close(&context->packed) == EXIT_SUCCESS) {
+      printf("Closed the output file\n");
+    } else {
+      fprintf(stderr, "Failed to closed output file\n");
+    }
+  }
+
+  if (context->eventsfile) {
+    if (fclose(context->eventsfile) != 0) {
+      fprintf(stderr, "Failed to close the events file\n");
+    }
+    context->eventsfile = NULL;
+  }
+
+  if (context->tracefile) {
+    fprintf(
+      context->tracefile,
+      "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+      "\"args\":{\"name\":\"writer\"}}\n]\n",
+      PM_TRACE_TID_WRITER);
+    if (fclose(context->tracefile) != 0) {
+      fprintf(stderr, "Failed to close the trace file\n");
+    }
+    context->tracefile = NULL;
+  }
+
+  pm_lookup_destroy(&context->idlookup);
+  pm_lookup_destroy(&context->namelookup);
+  pm_lookup_destroy(&context->treelookup);
+
+  free(context->monitoringname);
+  free(context->monitoringnames);
+
+  free(context->monitoringid);
+  free(context->monitoringtree);
+#ifdef _WIN32
+  free(context->pids);
+#endif
+  pm_arena_destroy(&context->arena);
+  free(context->outputfilename);
+  free(context->tracefilename);
+  free(context->eventsfilename);
+  free(context->listenaddress);
+  free(context->sharename);
+  free(context->procfsroot);
+  free(context);
+}
+
+size_t pm_context_column_count(const struct pm_context* context) {
+  return context->monitoringcolumncount;
+}
+
+/* Multiple types give one column per target and type named target:type */
+int pm_context_column_name(
+  const struct pm_context* context,
+  size_t column,
+  char* name,
+  size_t size) {
+  size_t target, k;
+  int written;
+  if (column >= context->monitoringcolumncount || size == 0) {
+    return EXIT_FAILURE;
+  }
+  if (column >= context->monitoringagestart &&
+    context->monitoringagecount > 0) {
+    if (pm_target_name(
+      context,
+      column - context->monitoringagestart,
+      name,
+      size) != EXIT_SUCCESS) {
+      return EXIT_FAILURE;
+    }
+    written = (int)(strlen(name));
+    if ((size_t)(written) + sizeof(":age") > size) {
+      return EXIT_FAILURE;
+    }
+    memcpy(name + written, ":age", sizeof(":age"));
+    return EXIT_SUCCESS;
+  } else if (column >= context->monitoringvaluecount && context->top > 0) {
+    written = snprintf(
+      name,
+      size,
+      "#%lu:pid",
+      (unsigned long)(column - context->monitoringvaluecount + 1));
+    return written >= 0 && (size_t)(written) < size ?
+      EXIT_SUCCESS : EXIT_FAILURE;
+  } else if (column >= context->monitoringvaluecount) {
+    written = snprintf(
+      name,
+      size,
+      "%d+:members",
+      context->monitoringtree[column - context->monitoringvaluecount]);
+    return written >= 0 && (size_t)(written) < size ?
+      EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  target = column / context->monitoringtypecount;
+  k = column % context->monitoringtypecount;
+  if (pm_target_name(context, target, name, size) != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+  written = (int)(strlen(name));
+  if (context->monitoringtypecount > 1) {
+    written += snprintf(
+      name + written,
+      size - (size_t)(written),
+      ":%s",
+      pm_type_arr[context->monitoringtype[k] - 1].st);
+  }
+  return written >= 0 && (size_t)(written) < size ?
+    EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+void pm_context_get_syscall_count(
+  const struct pm_context* context,
+  struct pm_syscall_count* count) {
+  *count = context->syscallcount;
+}
+
+void pm_context_get_writer_count(
+  const struct pm_context* context,
+  struct pm_writer_count* count) {
+  pm_writer_get_count(&context->writer, count);
+}
+
+void pm_context_get_sampler_count(
+  const struct pm_context* context,
+  struct pm_sampler_count* count) {
+  pm_sampler_get_count(&context->sampler, count);
+}
+
+void pm_context_get_memory_count(
+  const struct pm_context* context,
+  struct pm_memory_count* count) {
+  count->arena = context->arena.size;
+  count->processes = context->cachecapacity;
+  count->overflow = context->overflow;
+}
+
+/* The pm.h functions work on a default context created on first use */
+int pm_add_ids(char* ids) {
+  struct pm_context* context = pm_default();
+  return context ? pm_context_add_ids(context, ids) : EXIT_FAILURE;
+}
+
+int pm_add_names(char* names) {
+  struct pm_context* context = pm_default();
+  return context ? pm_context_add_names(context, names) : EXIT_FAILURE;
+}
+
+int pm_add_trees(char* roots) {
+  struct pm_context* context = pm_default();
+  return context ? pm_context_add_trees(context, roots) : EXIT_FAILURE;
+}
+
+int pm_set_types(char* types) {
+  struct pm_context* context = pm_default();
+  return context ? pm_context_set_types(context, types) : EXIT_FAILURE;
+}
+
+int pm_set_format(char* format) {
+  struct pm_context* context = pm_default();
+  return context ? pm_context_set_format(context, format) : EXIT_FAILURE;
+}
+
+int pm_set_output(char* filename) {
+  struct pm_context* context = pm_default();
+  return context ? pm_context_set_output(context, filename) : EXIT_FAILURE;
+}
+
+int pm_set_flush(char* policy) {
+  struct pm_context* context = pm_default();
+  return context ? pm_context_set_flush(context, policy) : EXIT_FAILURE;
+}
+
+int pm_set_capacity(char* processes) {
+  struct pm_context* context = pm_default();
+  return context ? pm_context_set_capacity(context, processes) : EXIT_FAILURE;
+}
+
+int pm_set_queue(char* size) {
+  struct pm_context* context = pm_default();
+  return context ? pm_context_set_queue(context, size) : EXIT_FAILURE;
+}
+
+int pm_set_threads(char* threads) {
+  struct pm_context* context = pm_default();
+  return context ? pm_context_set_threads(context, threads) : EXIT_FAILURE;
+}
+
+int pm_set_retention(char* rows) {
+  struct pm_context* context = pm_default();
+  return context ? pm_context_set_retention(context, rows) : EXIT_FAILURE;
+}
+
+int pm_set_rollup(char* window) {
+  struct pm_context* context = pm_default();
+  return context ? pm_context_set_rollup(context, window) : EXIT_FAILURE;
+}
+
+int pm_set_top(char* count) {
+  struct pm_context* context = pm_default();
+  return context ? pm_context_set_top(context, count) : EXIT_FAILURE;
+}
+
+int pm_set_by(char* type) {
+  struct pm_context* context = pm_default();
+  return context ? pm_context_set_by(context, type) : EXIT_FAILURE;
+}
+
+int pm_set_self_stats(int enabled) {
+  struct pm_context* context = pm_default();
+  return context ? pm_context_set_self_stats(context, enabled) : EXIT_FAILURE;
+}
+
+int pm_set_microseconds(int enabled) {
+  struct pm_context* context = pm_default();
+  return context ?
+    pm_context_set_microseconds(context, enabled) : EXIT_FAILURE;
+}
+
+int pm_set_trace(char* filename) {
+  struct pm_context* context = pm_default();
+  return context ? pm_context_set_trace(context, filename) : EXIT_FAILURE;
+}
+
+int pm_set_cadence(char* ticks) {
+  struct pm_context* context = pm_default();
+  return context ? pm_context_set_cadence(context, ticks) : EXIT_FAILURE;
+}
+
+int pm_set_adaptive(char* ticks) {
+  struct pm_context* context = pm_default();
+  return context ? pm_context_set_adaptive(context, ticks) : EXIT_FAILURE;
+}
+
+int pm_add_rules(char* rules) {
+  struct pm_context* context = pm_default();
+  return context ? pm_context_add_rules(context, rules) : EXIT_FAILURE;
+}
+
+int pm_set_events(char* filename) {
+  struct pm_context* context = pm_default();
+  return context ? pm_context_set_events(context, filename) : EXIT_FAILURE;
+}
+
+int pm_set_listen(char* address) {
+  struct pm_context* context = pm_default();
+  return context ? pm_context_set_listen(context, address) : EXIT_FAILURE;
+}
+
+int pm_set_share(char* name) {
+  struct pm_context* context = pm_default();
+  return context ? pm_context_set_share(context, name) : EXIT_FAILURE;
+}
+
+int pm_set_procfs(char* root) {
+  struct pm_context* context = pm_default();
+  return context ? pm_context_set_procfs(context, root) : EXIT_FAILURE;
+}
+
+int pm_init() {
+  struct pm_context* context = pm_default();
+  return context ? pm_context_init(context) : EXIT_FAILURE;
+}
+
+void pm_start() {
+  if (pm_default_context) {
+    pm_context_start(pm_default_context);
+  }
+}
+
+int pm_loop() {
+  if (pm_default_context) {
+    return pm_sample(pm_default_context, NULL);
+  }
+  fprintf(stderr, ERROR_TEXT_NOT_INITIALIZED);
+  return EXIT_FAILURE;
+}
+
+void pm_shutdown() {
+  if (pm_default_context) {
+    pm_context_stop(pm_default_context);
+    pm_context_report(pm_default_context);
+    pm_destroy(pm_default_context);
+    pm_default_context = NULL;
+  }
+}
+
+void pm_get_syscall_count(struct pm_syscall_count* count) {
+  if (pm_default_context) {
+    pm_context_get_syscall_count(pm_default_context, count);
+  } else {
+    memset(count, 0x00, sizeof(struct pm_syscall_count));
+  }
+}
+
+void pm_get_writer_count(struct pm_writer_count* count) {
+  if (pm_default_context) {
+    pm_context_get_writer_count(pm_default_context, count);
+  } else {
+    memset(count, 0x00, sizeof(struct pm_writer_count));
+  }
+}
+
+void pm_get_sampler_count(struct pm_sampler_count* count) {
+  if (pm_default_context) {
+    pm_context_get_sampler_count(pm_default_context, count);
+  } else {
+    memset(count, 0x00, sizeof(struct pm_sampler_count));
+  }
+}
+
+void pm_get_memory_count(struct pm_memory_count* count) {
+  if (pm_default_context) {
+    pm_context_get_memory_count(pm_default_context, count);
+  } else {
+    memset(count, 0x00, sizeof(struct pm_memory_count));
+  }
+}
+
+struct pm_context* pm_default() {
+  if (pm_default_context == NULL) {
+    pm_default_context = pm_create();
+  }
+  return pm_default_context;
+}
+
+/*
+ * Runs on the sampler threads so it only writes to the process, values and
+ * count. The expensive types are only read when slow is set.
+ */
+int pm_get_values(
+  const struct pm_context* context,
+  void* p,
+  int id,
+  bool slow,
+  unsigned long long* values,
+  struct pm_syscall_count* count) {
+#ifdef _WIN32
+  const struct pm_plan* plan = context->plan;
+  PM_PLAN_FIELD field;
+  size_t k;
+  PROCESS_MEMORY_COUNTERS pmc;
+  HANDLE* hp;
+  (void)(slow);
+  (void)(count);
+  hp = (HANDLE*)(p);
+  if (GetProcessMemoryInfo(*hp, &pmc, sizeof(pmc))) {
+    for (k = 0; k < context->monitoringtypecount; ++k) {
+      memcpy(&field, (char*)(&pmc) + plan[k].offset, sizeof(field));
+      values[k] = (unsigned long long)(field) & plan[k].mask;
+    }
+    return EXIT_SUCCESS;
+  } else {
+    fprintf(stderr, "Failed to get memory information for process ID %d\n", id);
+    return EXIT_FAILURE;
+  }
+#else
+  struct pm_procfs_process* process;
+  process = (struct pm_procfs_process*)(p);
+  if ((context->top > 0 ?
+    pm_procfs_scan(
+      context->directory.fd,
+      process,
+      &context->procfs,
+      slow,
+      count) :
+    pm_procfs_sample(
+      context->directory.fd,
+      process,
+      &context->procfs,
+      slow,
+      count)) == EXIT_SUCCESS) {
+    if (slow) {
+      process->slowtick = context->tick + 1;
+      process->slowelapsed = context->elapsed;
+    }
+    process->readelapsed = context->elapsed;
+    pm_carry(context, process, values);
+    return EXIT_SUCCESS;
+  } else {
+    fprintf(stderr, "Failed to get memory information for process ID %d\n", id);
+    return EXIT_FAILURE;
+  }
+#endif
+}
+
+#ifndef _WIN32
+/* The values of the process as last read */
+void pm_carry(
+  const struct pm_context* context,
+  const struct pm_procfs_process* process,
+  unsigned long long* values) {
+  const struct pm_plan* plan = context->plan;
+  PM_PLAN_FIELD field;
+  size_t k;
+  for (k = 0; k < context->monitoringtypecount; ++k) {
+    memcpy(&field, (char*)(process->value) + plan[k].offset, sizeof(field));
+    values[k] = field & plan[k].mask;
+  }
+}
+
+/*
+ * A process is due again on the next tick when any value moved by more
+ * than 1/64 of what it was and otherwise waits twice as many ticks as it
+ * did, up to the adaptive ceiling.
+ */
+void pm_adapt(
+  const struct pm_context* context,
+  struct pm_procfs_process* process,
+  const unsigned long long* previous,
+  const unsigned long long* values) {
+  unsigned long long change;
+  bool moved = process->every == 0;
+  size_t k;
+  for (k = 0; k < context->monitoringtypecount && !moved; ++k) {
+    change = values[k] > previous[k] ?
+      values[k] - previous[k] :
+      previous[k] - values[k];
+    moved = change > previous[k] >> PM_ADAPTIVE_SHIFT;
+  }
+  if (moved) {
+    process->every = 1;
+  } else if (process->every < context->adaptive) {
+    process->every = 2 * process->every < context->adaptive ?
+      2 * process->every : context->adaptive;
+  }
+  process->due = context->tick + process->every;
+}
+#endif
+
+/*
+ * Queue a monitored process for the samplers. The entry is kept by its
+ * position. The items hold every cached process when any of them may be
+ * sampled, so a full table is only counted as a guard.
+ */
+void pm_add_item(
+  struct pm_context* context,
+  const struct pm_cache_entry* entry,
+  int id) {
+  struct pm_item* item;
+  if (context->itemcount == context->itemcapacity) {
+    ++context->overflow;
+    return;
+  }
+  item = &context->items[context->itemcount++];
+  item->entry = (size_t)(entry - context->cache.entry);
+  item->id = id;
+  item->failed = false;
+  item->carried = false;
+}
+
+/*
+ * Called on a sampler thread for one item. On Windows a process whose
+ * start time no longer matches has reused the ID; it fails here and is
+ * resolved again on the next tick.
+ */
+void pm_sample_item(void* user, size_t index, unsigned int worker) {
+  struct pm_context* context = (struct pm_context*)(user);
+  struct pm_item* item = &context->items[index];
+  struct pm_cache_entry* entry = &context->cache.entry[item->entry];
+  unsigned long long* values =
+    &context->samples[index * context->monitoringtypecount];
+#ifdef _WIN32
+  FILETIME creationtime, exittime, kerneltime, usertime;
+  unsigned long long start = 0;
+  HANDLE process;
+  (void)(worker);
+  item->failed = true;
+  process = OpenProcess(
+    PROCESS_QUERY_INFORMATION | PROCESS_VM_READ,
+    FALSE,
+    item->id);
+  if (process) {
+    if (GetProcessTimes(
+      process,
+      &creationtime,
+      &exittime,
+      &kerneltime,
+      &usertime)) {
+      start = ((unsigned long long)(creationtime.dwHighDateTime) << 32) |
+        creationtime.dwLowDateTime;
+    }
+    if (start == entry->start) {
+      item->failed = pm_get_values(
+        context,
+        &process,
+        item->id,
+        false,
+        values,
+        NULL) != EXIT_SUCCESS;
+    }
+    CloseHandle(process);
+  } else {
+    fprintf(stderr, "Failed to open process %d\n", item->id);
+  }
+#else
+  struct pm_procfs_process* process = &entry->process;
+  unsigned long long previous[PM_TYPE_COUNT];
+  if (context->adaptive > 0) {
+    if (context->tick < process->due) {
+      pm_carry(context, process, values);
+      item->carried = true;
+      return;
+    }
+    pm_carry(context, process, previous);
+  }
+  item->failed = pm_get_values(
+    context,
+    process,
+    item->id,
+    (context->tick + (unsigned long)(entry->pid)) % context->cadence == 0 ||
+      context->tick - (process->slowtick > 0 ?
+        process->slowtick - 1 : process->opentick) >= context->cadence,
+    values,
+    &context->workercount[worker]) != EXIT_SUCCESS;
+  if (!item->failed && context->adaptive > 0) {
+    pm_adapt(context, process, previous, values);
+  }
+#endif
+}
+
+/*
+ * Copy the samples to their target columns, the last process wins, and
+ * add them to the columns of the tree they belong to.
+ */
+void pm_merge(struct pm_context* context) {
+  size_t typecount = context->monitoringtypecount;
+  struct pm_cache_entry* entry;
+  unsigned long long* values;
+  size_t k, t, target;
+#ifndef _WIN32
+  struct pm_syscall_count* count;
+  unsigned int w;
+  for (w = 0; w < context->samplerthreads; ++w) {
+    count = &context->workercount[w];
+    context->count.total += count->total;
+    context->count.reads += count->reads;
+    context->count.files += count->files;
+    memset(count, 0x00, sizeof(struct pm_syscall_count));
+  }
+#endif
+  context->readcount = 0;
+  for (k = 0; k < context->itemcount; ++k) {
+    entry = &context->cache.entry[context->items[k].entry];
+    if (context->items[k].failed) {
+      entry->tick = 0;
+      continue;
+    }
+    if (!context->items[k].carried) {
+      ++context->readcount;
+      if (context->seen != NULL && entry->target >= 0) {
+        context->seen[entry->target] = true;
+      }
+      if (context->seen != NULL && entry->tree >= 0) {
+        context->seen[context->monitoringidcount +
+          context->monitoringnamecount + (size_t)(entry->tree)] = true;
+      }
+    }
+    if (entry->target >= 0) {
+      memcpy(
+        &context->monitoring[entry->target * typecount],
+        &context->samples[k * typecount],
+        typecount * sizeof(unsigned long long));
+      if (context->monitoringagecount > 0) {
+        context->monitoring[context->monitoringagestart + entry->target] =
+          pm_age(context, entry);
+      }
+    }
+    if (entry->tree >= 0) {
+      target = context->monitoringidcount + context->monitoringnamecount +
+        (size_t)(entry->tree);
+      values = &context->monitoring[target * typecount];
+      for (t = 0; t < typecount; ++t) {
+        values[t] += context->samples[k * typecount + t];
+      }
+      ++context->monitoring[context->monitoringvaluecount + entry->tree];
+      if (context->monitoringagecount > 0 &&
+        pm_age(context, entry) >
+          context->monitoring[context->monitoringagestart + target]) {
+        context->monitoring[context->monitoringagestart + target] =
+          pm_age(context, entry);
+      }
+    }
+  }
+}
+
+/*
+ * The ms since the oldest value of a process was read, which is when the
+ * expensive types were read when there are any, the oldest for a tree.
+ * PM_AGE_NEVER until they were read once, their values being zero.
+ */
+unsigned long long pm_age(
+  const struct pm_context* context,
+  const struct pm_cache_entry* entry) {
+#ifdef _WIN32
+  (void)(context);
+  (void)(entry);
+  return 0;
+#else
+  if (context->procfs.slow != 0) {
+    return entry->process.slowtick == 0 ? PM_AGE_NEVER :
+      context->elapsed - entry->process.slowelapsed;
+  }
+  return context->elapsed - entry->process.readelapsed;
+#endif
+}
+
+/*
+ * Fill the row with the top processes of the tick. A heap of the top
+ * count of items seen so far keeps the selection linear in the number of
+ * processes; only the selected items are sorted, largest first.
+ */
+void pm_rank(struct pm_context* context) {
+  size_t typecount = context->monitoringtypecount;
+  size_t* heap = context->heap;
+  size_t count = 0, k, r;
+  unsigned long long value;
+  if (context->top == 0) {
+    return;
+  }
+  for (k = 0; k < context->itemcount; ++k) {
+    if (context->items[k].failed) {
+      continue;
+    }
+    value = context->samples[k * typecount + context->topk];
+    if (count < context->top) {
+      heap[count] = k;
+      for (r = count++; r > 0 && value <
+        context->samples[heap[(r - 1) / 2] * typecount + context->topk];
+        r = (r - 1) / 2) {
+        heap[r] = heap[(r - 1) / 2];
+        heap[(r - 1) / 2] = k;
+      }
+    } else if (value >
+      context->samples[heap[0] * typecount + context->topk]) {
+      heap[0] = k;
+      pm_sift(context, heap, count, 0);
+    }
+  }
+  context->ranked = count;
+  for (r = count; r > 1; --r) {
+    k = heap[0];
+    heap[0] = heap[r - 1];
+    heap[r - 1] = k;
+    pm_sift(context, heap, r - 1, 0);
+  }
+  for (r = 0; r < count; ++r) {
+    memcpy(
+      &context->monitoring[r * typecount],
+      &context->samples[heap[r] * typecount],
+      typecount * sizeof(unsigned long long));
+    context->monitoring[context->monitoringvaluecount + r] =
+      (unsigned long long)(context->items[heap[r]].id);
+    if (context->monitoringagecount > 0) {
+      context->monitoring[context->monitoringagestart + r] = pm_age(
+        context,
+        &context->cache.entry[context->items[heap[r]].entry]);
+    }
+    if (context->seen != NULL) {
+      context->seen[r] = !context->items[heap[r]].carried;
+    }
+  }
+}
+
+/* Move the item at position down the heap until both children are larger */
+void pm_sift(
+  const struct pm_context* context,
+  size_t* heap,
+  size_t count,
+  size_t position) {
+  size_t typecount = context->monitoringtypecount;
+  size_t smallest, child, swap;
+  for (;;) {
+    smallest = position;
+    for (child = 2 * position + 1;
+      child <= 2 * position + 2 && child < count;
+      ++child) {
+      if (context->samples[heap[child] * typecount + context->topk] <
+        context->samples[heap[smallest] * typecount + context->topk]) {
+        smallest = child;
+      }
+    }
+    if (smallest == position) {
+      return;
+    }
+    swap = heap[position];
+    heap[position] = heap[smallest];
+    heap[smallest] = swap;
+    position = smallest;
+  }
+}
+
+/*
+ * Record a phase that started at start and return the time it ended. The
+ * format and flush phases run on the writer thread and the others on the
+ * thread calling pm_sample, so each histogram has a single writer. A
+ * trace event is a single fprintf, which stdio keeps whole.
+ */
+unsigned long long pm_phase(
+  struct pm_context* context,
+  int phase,
+  unsigned long long start) {
+  unsigned long long end = pm_stats_now();
+  pm_stats_add(&context->phase[phase], end - start);
+  if (context->tracefile) {
+    fprintf(
+      context->tracefile,
+      "{\"name\":\"%s\",\"cat\":\"pm\",\"ph\":\"X\","
+      "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d},\n",
+      pm_stats_phase_name[phase],
+      (double)(start - context->tracestart) / 1000.0,
+      (double)(end - start) / 1000.0,
+      phase >= PM_PHASE_FORMAT ? PM_TRACE_TID_WRITER : PM_TRACE_TID_SAMPLE);
+  }
+  return end;
+}
+
+/* Hand a row to the sink or queue it for the writer thread */
+int pm_deliver(struct pm_context* context, struct pm_sample* sample) {
+  struct pm_writer_record* record;
+  if (context->sink != NULL) {
+    return context->sink(sample, context->sinkuser) == 0 ?
+      EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  if (context->outputformat == PM_FORMAT_NONE) {
+    return EXIT_SUCCESS;
+  }
+  if (context->sketches != NULL) {
+    return pm_roll(context, sample);
+  }
+  if ((record = pm_writer_claim(&context->writer)) != NULL) {
+    record->time = sample->time;
+    record->elapsed = sample->elapsed;
+    record->count = sample->count;
+    memcpy(
+      record->values,
+      sample->values,
+      sample->columns * sizeof(unsigned long long));
+    pm_writer_publish(&context->writer);
+  }
+  return pm_writer_failed(&context->writer) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/*
+ * Add a row to the sketches of the current rollup window, first writing
+ * the summary of the previous window when the row starts a new one. The
+ * memory used does not depend on how many rows a window has.
+ */
+int pm_roll(struct pm_context* context, const struct pm_sample* sample) {
+  long long window = sample->time / (long long)(context->rollup);
+  size_t k;
+  if (context->rolled > 0 && window != context->window &&
+    pm_roll_emit(context) != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+  for (k = 0; k < sample->columns; ++k) {
+    if (sample->values[k] == PM_AGE_NEVER &&
+      k >= context->monitoringagestart &&
+      k < context->monitoringagestart + context->monitoringagecount) {
+      continue;
+    }
+    pm_sketch_add(&context->sketches[k], sample->values[k]);
+  }
+  context->window = window;
+  context->rollupelapsed = sample->elapsed;
+  context->rolluppcount = sample->count;
+  ++context->rolled;
+  return EXIT_SUCCESS;
+}
+
+/* Queue the sketches of the current window and start a new one */
+int pm_roll_emit(struct pm_context* context) {
+  struct pm_writer_record* record;
+  size_t k;
+  if ((record = pm_writer_claim(&context->writer)) != NULL) {
+    record->time = context->window * (long long)(context->rollup);
+    record->elapsed = context->rollupelapsed;
+    record->count = context->rolluppcount;
+    for (k = 0; k < context->monitoringcolumncount; ++k) {
+      memcpy(
+        &record->values[k * PM_ROLLUP_WORDS],
+        &context->sketches[k],
+        sizeof(struct pm_sketch));
+    }
+    pm_writer_publish(&context->writer);
+  }
+  for (k = 0; k < context->monitoringcolumncount; ++k) {
+    pm_sketch_reset(&context->sketches[k]);
+  }
+  context->rolled = 0;
+  return pm_writer_failed(&context->writer) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/*
+ * Cache a process seen for the first time. A process ID target is bound to
+ * the start time of the first process seen with that ID so a reused ID is
+ * not mistaken for the target. A process that finds the cache full is left
+ * out and counted; it is tried again on the next tick.
+ */
+struct pm_cache_entry* pm_resolve(
+  struct pm_context* context,
+  const int id,
+  const unsigned long long start,
+  const char* name,
+  const int parent) {
+  struct pm_cache_entry* entry;
+  int target;
+  if ((entry = pm_cache_insert(&context->cache, id)) == NULL) {
+    ++context->overflow;
+    return NULL;
+  }
+  entry->start = start;
+  entry->parent = parent;
+  entry->tree = -1;
+  if (context->monitoringtreecount > 0 &&
+    (entry->tree = pm_resolve_tree(context, entry)) == PM_TREE_PENDING) {
+    context->pending[context->pendingcount++] =
+      (size_t)(entry - context->cache.entry);
+  }
+  if ((target = pm_is_monitored_id(context, id)) >= 0) {
+    if (context->monitoringstart[target] == 0) {
+      context->monitoringstart[target] = start;
+    } else if (context->monitoringstart[target] != start) {
+      fprintf(stderr, "Process ID %d has been reused by another process\n", id);
+      target = -1;
+    }
+  } else if (name[0] != '\0') {
+    target = pm_is_monitored_name(context, name);
+  }
+  entry->target = target;
+#ifndef _WIN32
+  pm_procfs_open(&entry->process, id, start);
+  entry->process.opentick = context->tick;
+#endif
+  return entry;
+}
+
+/*
+ * The tree a new process belongs to. A root is bound to its start time like
+ * a process ID target and every other process inherits the tree of its
+ * parent, so membership is decided once when a process is first seen. A
+ * parent not cached yet may come later in the enumeration of this tick.
+ */
+int pm_resolve_tree(
+  struct pm_context* context,
+  const struct pm_cache_entry* entry) {
+  const struct pm_cache_entry* parent;
+  int tree;
+  if ((tree = pm_lookup_id(&context->treelookup, entry->pid)) >= 0) {
+    if (context->treestart[tree] == 0) {
+      context->treestart[tree] = entry->start;
+    } else if (context->treestart[tree] != entry->start) {
+      fprintf(
+        stderr,
+        "Process ID %d has been reused by another process\n",
+        entry->pid);
+      return -1;
+    }
+    return tree;
+  }
+  if (entry->parent <= 0 || entry->parent == entry->pid) {
+    return -1;
+  }
+  if ((parent = pm_cache_find(&context->cache, entry->parent)) == NULL) {
+    return PM_TREE_PENDING;
+  }
+  return parent->tree;
+}
+
+/*
+ * Settle the processes whose parent was not cached when they were first
+ * seen, once the whole tick has been enumerated. Those that joined a tree
+ * are queued for the samplers if they are not targets themselves.
+ */
+int pm_resolve_pending(struct pm_context* context) {
+  struct pm_cache_entry* entry;
+  struct pm_cache_entry* parent;
+  bool changed = true;
+  size_t j;
+  while (changed) {
+    changed = false;
+    for (j = 0; j < context->pendingcount; ++j) {
+      entry = &context->cache.entry[context->pending[j]];
+      if (entry->tree == PM_TREE_PENDING) {
+        parent = pm_cache_find(&context->cache, entry->parent);
+        if (parent == NULL) {
+          entry->tree = -1;
+          changed = true;
+        } else if (parent->tree != PM_TREE_PENDING) {
+          entry->tree = parent->tree;
+          changed = true;
+        }
+      }
+    }
+  }
+  for (j = 0; j < context->pendingcount; ++j) {
+    entry = &context->cache.entry[context->pending[j]];
+    if (entry->tree == PM_TREE_PENDING) {
+      entry->tree = -1;
+    } else if (entry->tree >= 0 && entry->target < 0) {
+      pm_add_item(context, entry, entry->pid);
+    }
+  }
+  context->pendingcount = 0;
+  return EXIT_SUCCESS;
+}
+
+#ifdef _WIN32
+/*
+ * The running process IDs. EnumProcesses does not tell how many there are,
+ * so until init is done the array is doubled until they fit with room to
+ * spare. After that it keeps the size reserved at init, and a tick that
+ * fills it leaves the processes past it out.
+ */
+int pm_enumerate(struct pm_context* context, DWORD* count) {
+  DWORD* grown;
+  DWORD capacity, bytes;
+  capacity = context->pids == NULL ? PM_PROCESS_ARRAY_SIZE : 0;
+  for (;;) {
+    if (capacity > 0) {
+      grown = (DWORD*)(realloc(context->pids, capacity * sizeof(DWORD)));
+      if (grown == NULL) {
+        fprintf(stderr, ERROR_TEXT_MEMORY);
+        return EXIT_FAILURE;
+      }
+      context->pids = grown;
+      context->pidcapacity = capacity;
+    }
+    if (!EnumProcesses(
+      context->pids,
+      context->pidcapacity * sizeof(DWORD),
+      &bytes)) {
+      return EXIT_FAILURE;
+    }
+    if (bytes < context->pidcapacity * sizeof(DWORD)) {
+      *count = bytes / sizeof(DWORD);
+      return EXIT_SUCCESS;
+    }
+    if (context->initialized) {
+      *count = context->pidcapacity;
+      ++context->overflow;
+      return EXIT_SUCCESS;
+    }
+    if (context->pidcapacity >= PM_PROCESS_ARRAY_MAX_SIZE) {
+      fprintf(stderr, "Too many processes to enumerate\n");
+      return EXIT_FAILURE;
+    }
+    capacity = 2 * context->pidcapacity;
+  }
+}
+
+/*
+ * The parent of a new process from a snapshot taken at most once a tick
+ * and only when there are trees to follow. The snapshot is kept in the
+ * room reserved at init; a process past it has no parent.
+ */
+int pm_parent(struct pm_context* context, DWORD pid) {
+  PROCESSENTRY32 process;
+  HANDLE snapshot;
+  size_t j;
+  if (context->monitoringtreecount == 0) {
+    return 0;
+  }
+  if (context->parenttick != context->tick) {
+    context->parenttick = context->tick;
+    context->parentcount = 0;
+    snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (snapshot == INVALID_HANDLE_VALUE) {
+      fprintf(stderr, "Failed to take a snapshot of the processes\n");
+      return 0;
+    }
+    process.dwSize = sizeof(process);
+    if (Process32First(snapshot, &process)) {
+      do {
+        if (context->parentcount == context->parentcapacity) {
+          ++context->overflow;
+          break;
+        }
+        context->parents[context->parentcount++] = process;
+      } while (Process32Next(snapshot, &process));
+    }
+    CloseHandle(snapshot);
+  }
+  for (j = 0; j < context->parentcount; ++j) {
+    if (context->parents[j].th32ProcessID == pid) {
+      return (int)(context->parents[j].th32ParentProcessID);
+    }
+  }
+  return 0;
+}
+#else
+struct pm_cache_entry* pm_resolve_procfs(
+  struct pm_context* context,
+  const int id) {
+  char processname[PM_PROCESS_NAME_SIZE];
+  unsigned long long start;
+  int parent;
+  if (pm_procfs_identity(
+    context->directory.fd,
+    id,
+    processname,
+    sizeof(processname),
+    &start,
+    &parent,
+    &context->count) != EXIT_SUCCESS) {
+    return NULL;
+  }
+  return pm_resolve(context, id, start, processname, parent);
+}
+#endif
+
+/* Forget the processes that were not enumerated during this tick */
+void pm_evict(struct pm_context* context) {
+  struct pm_cache* cache = &context->cache;
+  size_t position = 0;
+  while (position < cache->count) {
+    if (cache->entry[position].tick != context->tick) {
+#ifndef _WIN32
+      pm_procfs_close(&cache->entry[position].process, &context->count);
+#endif
+      pm_cache_remove(cache, position);
+    } else {
+      ++position;
+    }
+  }
+}
+
+/* Print the running processes when there is nothing to monitor */
+void pm_list(struct pm_context* context) {
+  char processname[PM_PROCESS_NAME_SIZE];
+#ifdef _WIN32
+  HMODULE hmodule;
+  HANDLE hprocess;
+  DWORD penums, menums;
+  int i, pcount;
+  if (pm_enumerate(context, &penums) == EXIT_SUCCESS) {
+    pcount = (int)(penums);
+    for (i = 0; i < pcount; ++i) {
+      processname[0] = '\0';
+      hprocess = OpenProcess(
+        PROCESS_QUERY_INFORMATION | PROCESS_VM_READ,
+        FALSE,
+        context->pids[i]);
+      if (hprocess) {
+        if (EnumProcessModules(
+          hprocess,
+          &hmodule,
+          sizeof(hmodule),
+          &menums)) {
+          if (GetModuleBaseNameA(
+            hprocess,
+            hmodule,
+            processname,
+            sizeof(processname) / sizeof(CHAR)) == 0) {
+            processname[0] = '\0';
+          }
+        }
+        CloseHandle(hprocess);
+      }
+      if (processname[0] != '\0') {
+        printf("%d - %s\n", context->pids[i], processname);
+      } else {
+        printf("%d\n", context->pids[i]);
+      }
+    }
+  }
+#else
+  int pid;
+  if (pm_procfs_enumerate_begin(&context->directory, &context->count) ==
+    EXIT_SUCCESS) {
+    while ((pid = pm_procfs_enumerate_next(
+      &context->directory,
+      &context->count)) > 0) {
+      if (pm_procfs_name(
+        context->directory.fd,
+        pid,
+        processname,
+        sizeof(processname),
+        &context->count) == EXIT_SUCCESS) {
+        printf("%d - %s\n", pid, processname);
+      } else {
+        printf("%d\n", pid);
+      }
+    }
+  }
+#endif
+}
+
+int pm_is_monitored_id(const struct pm_context* context, const int id) {
+  return pm_lookup_id(&context->idlookup, id);
+}
+
+int pm_is_monitored_name(const struct pm_context* context, const char* name) {
+  int index = pm_lookup_name(&context->namelookup, name);
+  return index >= 0 ? ((int)(context->monitoringidcount)) + index : -1;
+}
+
+int pm_build_lookup(struct pm_context* context) {
+  size_t j;
+  if (pm_lookup_create(
+    &context->idlookup,
+    context->monitoringidcount,
+    &context->arena) != EXIT_SUCCESS ||
+    pm_lookup_create(
+      &context->namelookup,
+      context->monitoringnamecount,
+      &context->arena) != EXIT_SUCCESS ||
+    pm_lookup_create(
+      &context->treelookup,
+      context->monitoringtreecount,
+      &context->arena) != EXIT_SUCCESS) {
+    fprintf(stderr, ERROR_TEXT_MEMORY);
+    return EXIT_FAILURE;
+  }
+  for (j = 0; j < context->monitoringidcount; ++j) {
+    pm_lookup_add_id(&context->idlookup, context->monitoringid[j], (int)(j));
+  }
+  for (j = 0; j < context->monitoringnamecount; ++j) {
+    pm_lookup_add_name(
+      &context->namelookup,
+      context->monitoringname[j],
+      (int)(j));
+  }
+  for (j = 0; j < context->monitoringtreecount; ++j) {
+    pm_lookup_add_id(&context->treelookup, context->monitoringtree[j], (int)(j));
+  }
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Find the column of the type the top processes are ranked by, selecting
+ * it when it has not been.
+ */
+void pm_rank_type(struct pm_context* context) {
+  size_t k;
+  if (context->topby == 0) {
+    context->topby = context->monitoringtype[0];
+  }
+  for (k = 0; k < context->monitoringtypecount; ++k) {
+    if (context->monitoringtype[k] == context->topby) {
+      break;
+    }
+  }
+  if (k == context->monitoringtypecount) {
+    context->monitoringtype[context->monitoringtypecount++] = context->topby;
+  }
+  context->topk = k;
+}
+
+/*
+ * Carve everything whose size the configuration and pm_reserve fix from one
+ * arena: the row, the lookups, the ranking heap, the store, the rollup
+ * sketches, the per thread counts, the process tables and what the threads
+ * and the encoders work in. Nothing in it is resized after init.
+ */
+int pm_carve(struct pm_context* context) {
+  size_t columns = context->monitoringcolumncount, size, j;
+  bool rollup = context->rollup > 0 &&
+    context->outputformat == PM_FORMAT_CSV;
+  bool encode = !rollup && context->outputformat == PM_FORMAT_CSV;
+  context->writercolumns = rollup ? columns * PM_ROLLUP_WORDS : columns;
+  if (rollup && context->writercapacity > PM_ROLLUP_QUEUE_SIZE) {
+    context->writercapacity = PM_ROLLUP_QUEUE_SIZE;
+  }
+  size = pm_arena_size(columns * sizeof(unsigned long long)) +
+    pm_arena_size(
+      (context->monitoringidcount + 1) * sizeof(unsigned long long)) +
+    pm_arena_size(
+      (context->monitoringtreecount + 1) * sizeof(unsigned long long)) +
+    pm_lookup_bytes(context->monitoringidcount) +
+    pm_lookup_bytes(context->monitoringnamecount) +
+    pm_lookup_bytes(context->monitoringtreecount) +
+    pm_arena_size(context->top * sizeof(size_t));
+  if (context->rules.count > 0) {
+    size += pm_arena_size(
+      pm_rules_bytes(context->rules.count, context->monitoringcount)) +
+      pm_arena_size(context->monitoringcount * sizeof(bool));
+  }
+  if (context->retention > 0) {
+    size += pm_arena_size(pm_store_bytes(columns, context->retention));
+  }
+  if (rollup) {
+    size += pm_arena_size(columns * sizeof(struct pm_sketch));
+  }
+  if (encode) {
+    size += pm_arena_size(pm_encode_bytes(columns));
+  }
+#ifndef _WIN32
+  size += pm_arena_size(
+    context->samplerthreads * sizeof(struct pm_syscall_count));
+  if (context->listenaddress) {
+    size += pm_arena_size(pm_serve_bytes(
+      columns,
+      PM_SERVE_BODY_SIZE(columns, context->monitoringtypecount)));
+  }
+#else
+  size += pm_arena_size(context->parentcapacity * sizeof(PROCESSENTRY32));
+#endif
+  size += pm_arena_size(pm_cache_bytes(context->cachecapacity)) +
+    pm_arena_size(context->itemcapacity * sizeof(struct pm_item)) +
+    pm_arena_size(context->itemcapacity * context->monitoringtypecount *
+      sizeof(unsigned long long)) +
+    pm_arena_size(context->pendingcapacity * sizeof(size_t)) +
+    pm_arena_size(pm_sampler_bytes(context->samplerthreads));
+  if (context->outputformat != PM_FORMAT_NONE) {
+    size += pm_arena_size(pm_writer_bytes(
+      context->writercolumns,
+      context->writercapacity));
+  }
+  if (context->outputformat == PM_FORMAT_PACK) {
+    size += pm_arena_size(pm_pack_encoder_bytes(columns));
+  }
+  if (context->rules.count > 0) {
+    size += pm_arena_size(
+      pm_writer_bytes(PM_EVENT_WORDS, PM_EVENT_QUEUE_SIZE));
+  }
+  if (pm_arena_create(&context->arena, size) != EXIT_SUCCESS) {
+    fprintf(stderr, ERROR_TEXT_MEMORY);
+    return EXIT_FAILURE;
+  }
+
+  context->monitoring = (unsigned long long*)(pm_arena_alloc(
+    &context->arena,
+    columns * sizeof(unsigned long long)));
+  context->monitoringstart = (unsigned long long*)(pm_arena_alloc(
+    &context->arena,
+    (context->monitoringidcount + 1) * sizeof(unsigned long long)));
+  context->treestart = (unsigned long long*)(pm_arena_alloc(
+    &context->arena,
+    (context->monitoringtreecount + 1) * sizeof(unsigned long long)));
+  if (context->monitoring == NULL ||
+    context->monitoringstart == NULL ||
+    context->treestart == NULL ||
+    pm_build_lookup(context) != EXIT_SUCCESS) {
+    fprintf(stderr, ERROR_TEXT_MEMORY);
+    return EXIT_FAILURE;
+  }
+  if (context->top > 0 && (context->heap = (size_t*)(pm_arena_alloc(
+    &context->arena,
+    context->top * sizeof(size_t)))) == NULL) {
+    fprintf(stderr, ERROR_TEXT_MEMORY);
+    return EXIT_FAILURE;
+  }
+  if (context->rules.count > 0 && (pm_rules_create(
+    &context->rules,
+    context->monitoringcount,
+    &context->arena) != EXIT_SUCCESS ||
+    (context->seen = (bool*)(pm_arena_alloc(
+      &context->arena,
+      context->monitoringcount * sizeof(bool)))) == NULL)) {
+    fprintf(stderr, ERROR_TEXT_MEMORY);
+    return EXIT_FAILURE;
+  }
+  if (context->retention > 0 && pm_store_create(
+    &context->store,
+    columns,
+    context->retention,
+    &context->arena) != EXIT_SUCCESS) {
+    fprintf(stderr, ERROR_TEXT_MEMORY);
+    return EXIT_FAILURE;
+  }
+  if (rollup) {
+    context->sketches = (struct pm_sketch*)(pm_arena_alloc(
+      &context->arena,
+      columns * sizeof(struct pm_sketch)));
+    if (context->sketches == NULL) {
+      fprintf(stderr, ERROR_TEXT_MEMORY);
+      return EXIT_FAILURE;
+    }
+    for (j = 0; j < columns; ++j) {
+      pm_sketch_reset(&context->sketches[j]);
+    }
+  }
+  if (encode) {
+    pm_encoder_init(
+      &context->encoder,
+      (char*)(pm_arena_alloc(&context->arena, pm_encode_bytes(columns))));
+    if (context->encoder.buffer == NULL) {
+      fprintf(stderr, ERROR_TEXT_MEMORY);
+      return EXIT_FAILURE;
+    }
+  }
+#ifndef _WIN32
+  context->workercount = (struct pm_syscall_count*)(pm_arena_alloc(
+    &context->arena,
+    context->samplerthreads * sizeof(struct pm_syscall_count)));
+  if (context->workercount == NULL) {
+    fprintf(stderr, ERROR_TEXT_MEMORY);
+    return EXIT_FAILURE;
+  }
+#else
+  if (context->parentcapacity > 0 &&
+    (context->parents = (PROCESSENTRY32*)(pm_arena_alloc(
+      &context->arena,
+      context->parentcapacity * sizeof(PROCESSENTRY32)))) == NULL) {
+    fprintf(stderr, ERROR_TEXT_MEMORY);
+    return EXIT_FAILURE;
+  }
+#endif
+  context->items = (struct pm_item*)(pm_arena_alloc(
+    &context->arena,
+    context->itemcapacity * sizeof(struct pm_item)));
+  context->samples = (unsigned long long*)(pm_arena_alloc(
+    &context->arena,
+    context->itemcapacity * context->monitoringtypecount *
+      sizeof(unsigned long long)));
+  if (pm_cache_create(
+    &context->cache,
+    context->cachecapacity,
+    &context->arena) != EXIT_SUCCESS ||
+    context->items == NULL ||
+    context->samples == NULL) {
+    fprintf(stderr, ERROR_TEXT_MEMORY);
+    return EXIT_FAILURE;
+  }
+  if (context->pendingcapacity > 0 &&
+    (context->pending = (size_t*)(pm_arena_alloc(
+      &context->arena,
+      context->pendingcapacity * sizeof(size_t)))) == NULL) {
+    fprintf(stderr, ERROR_TEXT_MEMORY);
+    return EXIT_FAILURE;
+  }
+  if (context->outputformat == PM_FORMAT_PACK &&
+    (context->packmemory = pm_arena_alloc(
+      &context->arena,
+      pm_pack_encoder_bytes(columns))) == NULL) {
+    fprintf(stderr, ERROR_TEXT_MEMORY);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Size the process tables for the capacity set or else for the processes
+ * running at init, with room to double, before they are carved. A process needs a cache entry to be
+ * queued, so the items only take as many when all of them can be sampled.
+ * The new processes of a tick waiting for a tree never outnumber the cache.
+ */
+int pm_reserve(struct pm_context* context) {
+  size_t processes = 0;
+#ifdef _WIN32
+  DWORD* grown;
+  DWORD count;
+  if (pm_enumerate(context, &count) == EXIT_SUCCESS) {
+    processes = (size_t)(count);
+  }
+#else
+  if (pm_procfs_enumerate_begin(&context->directory, &context->count) ==
+    EXIT_SUCCESS) {
+    while (pm_procfs_enumerate_next(&context->directory, &context->count) > 0) {
+      ++processes;
+    }
+  }
+#endif
+  if (context->capacity > 0) {
+    context->cachecapacity = context->capacity;
+  } else {
+    context->cachecapacity = 2 * processes > PM_CACHE_MIN_SIZE ?
+      2 * processes : PM_CACHE_MIN_SIZE;
+  }
+  context->itemcapacity = context->top > 0 ||
+    context->monitoringnamecount > 0 || context->monitoringtreecount > 0 ?
+    context->cachecapacity : context->monitoringidcount;
+  if (context->itemcapacity < PM_ITEM_MIN_SIZE) {
+    context->itemcapacity = PM_ITEM_MIN_SIZE;
+  }
+  context->pendingcapacity = context->monitoringtreecount > 0 ?
+    context->cachecapacity : 0;
+#ifdef _WIN32
+  if (context->pidcapacity < context->cachecapacity) {
+    grown = (DWORD*)(realloc(
+      context->pids,
+      context->cachecapacity * sizeof(DWORD)));
+    if (grown == NULL) {
+      fprintf(stderr, ERROR_TEXT_MEMORY);
+      return EXIT_FAILURE;
+    }
+    context->pids = grown;
+    context->pidcapacity = (DWORD)(context->cachecapacity);
+  }
+  context->parentcapacity = context->pendingcapacity;
+#endif
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Resolve each selected type to the offset of its field in the counters
+ * filled by one sample so that pm_get_values only copies fields.
+ */
+int pm_compile_plan(struct pm_context* context) {
+  struct pm_plan* plan = context->plan;
+  size_t k;
+  int selected;
+#ifndef _WIN32
+  pm_procfs_plan_reset(&context->procfs);
+#endif
+  for (k = 0; k < context->monitoringtypecount; ++k) {
+    selected = context->monitoringtype[k];
+    if (selected <= PM_TYPE_UNDEFINED || selected >= PM_TYPE_UNKNOWN) {
+      fprintf(stderr, "Unknown memory type %d\n", selected);
+      return EXIT_FAILURE;
+    }
+#ifdef _WIN32
+    if (selected > PM_TYPE_PEAK_PAGEFILE_USAGE) {
+      fprintf(
+        stderr,
+        "The %s type is only sampled on Linux\n",
+        pm_type_arr[selected - 1].lt);
+      return EXIT_FAILURE;
+    }
+    plan[k].offset = pm_type_offset[selected];
+    plan[k].mask = selected == PM_TYPE_PAGE_FAULT_COUNT ?
+      0xffffffffULL : ~0ULL;
+#else
+    plan[k].offset = (size_t)(selected) * sizeof(unsigned long long);
+    plan[k].mask = ~0ULL;
+    pm_procfs_plan_add(&context->procfs, selected);
+#endif
+  }
+  return EXIT_SUCCESS;
+}
+
+/* Each rule reads the column of its type, which has to be selected */
+int pm_bind_rules(struct pm_context* context) {
+  struct pm_rule* rule;
+  size_t k, t;
+  for (k = 0; k < context->rules.count; ++k) {
+    rule = &context->rules.rule[k];
+    for (t = 0; t < context->monitoringtypecount; ++t) {
+      if (context->monitoringtype[t] == rule->type) {
+        break;
+      }
+    }
+    if (t == context->monitoringtypecount) {
+      fprintf(
+        stderr,
+        "Rule '%s' is on a type that is not monitored\n",
+        rule->text);
+      return EXIT_FAILURE;
+    }
+    rule->column = t;
+  }
+  return EXIT_SUCCESS;
+}
+
+int pm_open_events(struct pm_context* context) {
+  size_t length;
+  if (context->eventsfilename == NULL) {
+    length = sizeof(DEFAULT_EVENTS_FILE_NAME);
+    if ((context->eventsfilename = malloc(length)) == NULL) {
+      fprintf(stderr, ERROR_TEXT_MEMORY);
+      return EXIT_FAILURE;
+    }
+    memcpy(context->eventsfilename, DEFAULT_EVENTS_FILE_NAME, length);
+  }
+  context->eventsfile = fopen(context->eventsfilename, "w");
+  if (context->eventsfile == NULL) {
+    fprintf(
+      stderr,
+      "Failed to open events file '%s'\n",
+      context->eventsfilename);
+    return EXIT_FAILURE;
+  }
+  fprintf(
+    context->eventsfile,
+    "date,time,elapsed,target,type,rule,value,slope\n");
+  fflush(context->eventsfile);
+  printf("Events file '%s' has been opened\n", context->eventsfilename);
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Check every rule against every target read on this tick. This is a few
+ * compares and, for a slope, a handful of multiplies per rule and target,
+ * on state carved at init, so it makes no allocations.
+ */
+void pm_check_rules(struct pm_context* context) {
+  const struct pm_rule* rule;
+  struct pm_rule_state* state = context->rules.state;
+  unsigned long long value;
+  double slope;
+  size_t k, target;
+  for (k = 0; k < context->rules.count; ++k) {
+    rule = &context->rules.rule[k];
+    for (target = 0; target < context->monitoringcount; ++target, ++state) {
+      if (!context->seen[target]) {
+        continue;
+      }
+      value = context->monitoring[
+        target * context->monitoringtypecount + rule->column];
+      if (pm_rule_check(rule, state, context->elapsed, value, &slope)) {
+        pm_queue_event(context, k, target, value, slope);
+      }
+    }
+  }
+}
+
+/*
+ * Events go to their own writer thread, so the sampling thread only fills
+ * a slot of the ring. The slope is per hour; a threshold rule has none.
+ */
+void pm_queue_event(
+  struct pm_context* context,
+  size_t rule,
+  size_t target,
+  unsigned long long value,
+  double slope) {
+  struct pm_writer_record* record;
+  ++context->rules.events;
+  if ((record = pm_writer_claim(&context->eventwriter)) != NULL) {
+    record->time = (long long)(time(NULL));
+    record->elapsed = context->elapsed;
+    record->count = 0;
+    record->values[PM_EVENT_RULE] = rule;
+    record->values[PM_EVENT_TARGET] = target;
+    record->values[PM_EVENT_VALUE] = value;
+    memcpy(&record->values[PM_EVENT_SLOPE], &slope, sizeof(double));
+    pm_writer_publish(&context->eventwriter);
+  }
+}
+
+/* Called on the events writer thread for every queued event */
+int pm_write_event(const struct pm_writer_record* record, void* user) {
+  struct pm_context* context = (struct pm_context*)(user);
+  const struct pm_rule* rule =
+    &context->rules.rule[record->values[PM_EVENT_RULE]];
+  char text[PM_TEXT_BUFFER_SIZE];
+  char name[PM_TEXT_BUFFER_SIZE];
+  struct tm tsr;
+  time_t t = (time_t)(record->time);
+  double slope;
+  memcpy(&slope, &record->values[PM_EVENT_SLOPE], sizeof(double));
+  if (pm_target_name(
+    context,
+    (size_t)(record->values[PM_EVENT_TARGET]),
+    name,
+    sizeof(name)) != EXIT_SUCCESS) {
+    name[0] = '\0';
+  }
+#ifdef _WIN32
+  gmtime_s(&tsr, &t);
+#else
+  gmtime_r(&t, &tsr);
+#endif
+  strftime(text, PM_TEXT_BUFFER_SIZE, "%y-%m-%d,%H:%M:%S", &tsr);
+  fprintf(context->eventsfile, "%s,%llu,%s", text, record->elapsed, name);
+  if (fprintf(
+    context->eventsfile,
+    ",%s,%s,%llu,%.0f\n",
+    pm_type_arr[rule->type - 1].st,
+    rule->text,
+    record->values[PM_EVENT_VALUE],
+    slope) < 0) {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/* Every event is flushed as it is written, events being rare */
+int pm_flush_events(void* user) {
+  struct pm_context* context = (struct pm_context*)(user);
+  return fflush(context->eventsfile) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#ifndef _WIN32
+/*
+ * Runs on the serving thread. It only reads the snapshot, the settings
+ * fixed at init and the serving counters, which that thread owns. Every
+ * type is a gauge named after its short name with the target as label.
+ */
+size_t pm_render_metrics(
+  const struct pm_serve_snapshot* snapshot,
+  char* buffer,
+  size_t size,
+  void* user) {
+  const struct pm_context* context = (const struct pm_context*)(user);
+  char label[PM_SERVE_LINE_SIZE];
+  size_t length = 0, target, tree, k;
+  int type;
+  for (k = 0; k < context->monitoringtypecount; ++k) {
+    type = context->monitoringtype[k];
+    pm_render_append(buffer, size, &length,
+      "# TYPE pm_%s gauge\n# HELP pm_%s %s\n",
+      pm_type_arr[type - 1].st,
+      pm_type_arr[type - 1].st,
+      pm_type_arr[type - 1].lt);
+    for (target = 0; target < context->monitoringcount; ++target) {
+      pm_render_label(context, target, snapshot, label, sizeof(label));
+      pm_render_append(buffer, size, &length, "pm_%s{%s} %llu\n",
+        pm_type_arr[type - 1].st,
+        label,
+        snapshot->values[target * context->monitoringtypecount + k]);
+    }
+  }
+  if (context->top == 0 && context->monitoringtreecount > 0) {
+    pm_render_append(buffer, size, &length,
+      "# TYPE pm_members gauge\n"
+      "# HELP pm_members Processes in the tree\n");
+    for (tree = 0; tree < context->monitoringtreecount; ++tree) {
+      target = context->monitoringidcount + context->monitoringnamecount + tree;
+      pm_render_label(context, target, snapshot, label, sizeof(label));
+      pm_render_append(buffer, size, &length, "pm_members{%s} %llu\n",
+        label,
+        snapshot->values[context->monitoringvaluecount + tree]);
+    }
+  }
+  if (context->monitoringagecount > 0) {
+    pm_render_append(buffer, size, &length,
+      "# TYPE pm_age_milliseconds gauge\n"
+      "# HELP pm_age_milliseconds Time since the oldest value was read\n");
+    for (target = 0; target < context->monitoringagecount; ++target) {
+      pm_render_label(context, target, snapshot, label, sizeof(label));
+      if (snapshot->values[context->monitoringagestart + target] ==
+        PM_AGE_NEVER) {
+        pm_render_append(buffer, size, &length,
+          "pm_age_milliseconds{%s} NaN\n", label);
+        continue;
+      }
+      pm_render_append(buffer, size, &length, "pm_age_milliseconds{%s} %llu\n",
+        label,
+        snapshot->values[context->monitoringagestart + target]);
+    }
+  }
+  pm_render_append(buffer, size, &length,
+    "# TYPE pm_processes gauge\n"
+    "# HELP pm_processes Processes enumerated by the last tick\n"
+    "pm_processes %lld\n"
+    "# TYPE pm_elapsed_milliseconds gauge\n"
+    "# HELP pm_elapsed_milliseconds Time since monitoring started\n"
+    "pm_elapsed_milliseconds %llu\n"
+    "# TYPE pm_scrapes counter\n"
+    "# HELP pm_scrapes Scrapes served\n"
+    "pm_scrapes_total %llu\n"
+    "# TYPE pm_render_seconds counter\n"
+    "# HELP pm_render_seconds Time spent rendering the scrapes\n"
+    "pm_render_seconds_total %.9f\n"
+    "# EOF\n",
+    snapshot->count,
+    snapshot->elapsed,
+    context->serve.scrapes,
+    (double)(context->serve.renderns) / 1e9);
+  return length;
+}
+
+/* Once the buffer is full the rest is left out */
+void pm_render_append(
+  char* buffer,
+  size_t size,
+  size_t* length,
+  const char* format,
+  ...) {
+  va_list arguments;
+  int written;
+  if (*length >= size) {
+    return;
+  }
+  va_start(arguments, format);
+  written = vsnprintf(buffer + *length, size - *length, format, arguments);
+  va_end(arguments);
+  if (written < 0 || (size_t)(written) >= size - *length) {
+    *length = size;
+    return;
+  }
+  *length += (size_t)(written);
+}
+
+/* The target label, with the pid of the rank in top mode, escaped */
+void pm_render_label(
+  const struct pm_context* context,
+  size_t target,
+  const struct pm_serve_snapshot* snapshot,
+  char* label,
+  size_t size) {
+  char name[PM_TEXT_BUFFER_SIZE];
+  const char* c;
+  size_t length = 0;
+  if (pm_target_name(context, target, name, sizeof(name)) != EXIT_SUCCESS) {
+    name[0] = '\0';
+  }
+  memcpy(label, "target=\"", 8);
+  length = 8;
+  for (c = name; *c != '\0' && length + 4 < size; ++c) {
+    if (*c == '"' || *c == '\\') {
+      label[length++] = '\\';
+      label[length++] = *c;
+    } else if (*c == '\n') {
+      label[length++] = '\\';
+      label[length++] = 'n';
+    } else {
+      label[length++] = *c;
+    }
+  }
+  label[length++] = '"';
+  label[length] = '\0';
+  if (context->top > 0) {
+    snprintf(label + length, size - length, ",pid=\"%llu\"",
+      snapshot->values[context->monitoringvaluecount + target]);
+  }
+}
+#endif
+
+/* The names are written once, the rows by pm_share_publish on every tick */
+int pm_create_share(struct pm_context* context) {
+  struct pm_share_layout layout;
+  size_t target, k;
+  int type;
+  memset(&layout, 0x00, sizeof(layout));
+  layout.targets = context->monitoringcount;
+  layout.types = context->monitoringtypecount;
+  layout.columns = context->monitoringcolumncount;
+  layout.extrastart = context->monitoringvaluecount;
+  layout.agestart = context->monitoringagestart;
+  layout.agecount = context->monitoringagecount;
+  if (context->top > 0) {
+    layout.extrakind = PM_SHARE_EXTRA_PID;
+    layout.extracount = context->top;
+  } else if (context->monitoringtreecount > 0) {
+    layout.extrakind = PM_SHARE_EXTRA_MEMBERS;
+    layout.extrafirst =
+      context->monitoringidcount + context->monitoringnamecount;
+    layout.extracount = context->monitoringtreecount;
+  }
+  if (pm_share_create(&context->share, context->sharename, &layout) !=
+    EXIT_SUCCESS) {
+    fprintf(
+      stderr,
+      "Failed to create the shared view '%s'\n",
+      context->sharename);
+    return EXIT_FAILURE;
+  }
+  for (target = 0; target < layout.targets; ++target) {
+    if (pm_target_name(
+      context,
+      target,
+      pm_share_target(&context->share, target),
+      PM_SHARE_NAME_SIZE) != EXIT_SUCCESS) {
+      pm_share_target(&context->share, target)[0] = '\0';
+    }
+  }
+  for (k = 0; k < layout.types; ++k) {
+    type = context->monitoringtype[k];
+    snprintf(
+      pm_share_type(&context->share, k),
+      PM_SHARE_TYPE_SIZE,
+      "%s",
+      pm_type_arr[type - 1].st);
+  }
+  printf(
+    "Sharing the view as %s in %lu bytes\n",
+    context->share.name,
+    (unsigned long)(context->share.size));
+  return EXIT_SUCCESS;
+}
+
+int pm_open_output(struct pm_context* context) {
+  const char* filename;
+  size_t length;
+  if (context->outputfilename == NULL) {
+    filename = context->outputformat == PM_FORMAT_BIN ?
+      DEFAULT_BINARY_OUTPUT_FILE_NAME :
+      context->outputformat == PM_FORMAT_PACK ?
+        DEFAULT_PACKED_OUTPUT_FILE_NAME :
+        DEFAULT_OUTPUT_FILE_NAME;
+    length = strlen(filename) + 1;
+    context->outputfilename = malloc(length);
+    if (context->outputfilename != NULL) {
+      memcpy(context->outputfilename, filename, length);
+    } else {
+      fprintf(stderr, ERROR_TEXT_MEMORY);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (context->outputformat == PM_FORMAT_BIN) {
+    if (pm_binary_open(&context->binary, context->outputfilename) ==
+      EXIT_SUCCESS) {
+      printf(
+        "Binary output file '%s' has been opened\n",
+        context->outputfilename);
+    } else {
+      fprintf(
+        stderr,
+        "Failed to open output file '%s'\n",
+        context->outputfilename);
+      return EXIT_FAILURE;
+    }
+  } else if (context->outputformat == PM_FORMAT_PACK) {
+    if (pm_packed_open(&context->packed, context->outputfilename) ==
+      EXIT_SUCCESS) {
+      printf(
+        "Packed output file '%s' has been opened\n",
+        context->outputfilename);
+    } else {
+      fprintf(
+        stderr,
+        "Failed to open output file '%s'\n",
+        context->outputfilename);
+      return EXIT_FAILURE;
+    }
+  } else {
+    context->outputfile = fopen(context->outputfilename, "w+");
+    if (context->outputfile) {
+      printf(
+        "Output file '%s' has been opened\n",
+        context->outputfilename);
+    } else {
+      fprintf(
+        stderr,
+        "Failed to open output file '%s'\n",
+        context->outputfilename);
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+int pm_write_header(struct pm_context* context) {
+  char text[PM_TEXT_BUFFER_SIZE];
+  size_t j, k;
+  if (context->binary.base) {
+    if (pm_binary_header(
+      &context->binary,
+      context->monitoringtype,
+      context->monitoringtypecount,
+      context->monitoringcount) != EXIT_SUCCESS) {
+      fprintf(stderr, "Failed to write to the output file\n");
+      return EXIT_FAILURE;
+    }
+    for (j = 0; j < context->monitoringcount; ++j) {
+      pm_target_name(context, j, text, PM_TEXT_BUFFER_SIZE);
+      if (pm_binary_target(&context->binary, text) != EXIT_SUCCESS) {
+        fprintf(stderr, "Failed to write to the output file\n");
+        return EXIT_FAILURE;
+      }
+    }
+    if (pm_binary_extra(
+      &context->binary,
+      context->monitoringcolumncount - context->monitoringvaluecount) !=
+      EXIT_SUCCESS) {
+      fprintf(stderr, "Failed to write to the output file\n");
+      return EXIT_FAILURE;
+    }
+    for (k = context->monitoringvaluecount;
+      k < context->monitoringcolumncount;
+      ++k) {
+      pm_context_column_name(context, k, text, PM_TEXT_BUFFER_SIZE);
+      if (pm_binary_target(&context->binary, text) != EXIT_SUCCESS) {
+        fprintf(stderr, "Failed to write to the output file\n");
+        return EXIT_FAILURE;
+      }
+    }
+    if (pm_binary_unit(
+      &context->binary,
+      context->microseconds ? PM_FORMAT_UNIT_US : PM_FORMAT_UNIT_MS) !=
+      EXIT_SUCCESS ||
+      pm_binary_start(&context->binary) != EXIT_SUCCESS) {
+      fprintf(stderr, "Failed to write to the output file\n");
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  } else if (context->packed.file) {
+    if (pm_packed_header(
+      &context->packed,
+      context->monitoringtype,
+      context->monitoringtypecount,
+      context->monitoringcount) != EXIT_SUCCESS) {
+      fprintf(stderr, "Failed to write to the output file\n");
+      return EXIT_FAILURE;
+    }
+    for (j = 0; j < context->monitoringcount; ++j) {
+      pm_target_name(context, j, text, PM_TEXT_BUFFER_SIZE);
+      if (pm_packed_target(&context->packed, text) != EXIT_SUCCESS) {
+        fprintf(stderr, "Failed to write to the output file\n");
+        return EXIT_FAILURE;
+      }
+    }
+    if (pm_packed_extra(
+      &context->packed,
+      context->monitoringcolumncount - context->monitoringvaluecount) !=
+      EXIT_SUCCESS) {
+      fprintf(stderr, "Failed to write to the output file\n");
+      return EXIT_FAILURE;
+    }
+    for (k = context->monitoringvaluecount;
+      k < context->monitoringcolumncount;
+      ++k) {
+      pm_context_column_name(context, k, text, PM_TEXT_BUFFER_SIZE);
+      if (pm_packed_target(&context->packed, text) != EXIT_SUCCESS) {
+        fprintf(stderr, "Failed to write to the output file\n");
+        return EXIT_FAILURE;
+      }
+    }
+    if (pm_packed_unit(
+      &context->packed,
+      context->microseconds ? PM_FORMAT_UNIT_US : PM_FORMAT_UNIT_MS) !=
+      EXIT_SUCCESS ||
+      pm_packed_start(&context->packed, context->packmemory) !=
+      EXIT_SUCCESS) {
+      fprintf(stderr, "Failed to write to the output file\n");
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  } else if (context->outputfile) {
+    fprintf(
+      context->outputfile,
+      "date,time,%s",
+      context->microseconds ? "elapsed_us" : "elapsed");
+    for (k = 0; k < context->monitoringcolumncount; ++k) {
+      pm_context_column_name(context, k, text, PM_TEXT_BUFFER_SIZE);
+      if (context->sketches) {
+        fprintf(
+          context->outputfile,
+          ",%s:min,%s:max,%s:mean,%s:p50,%s:p95,%s:p99,%s:sketch",
+          text, text, text, text, text, text, text);
+      } else {
+        fprintf(context->outputfile, ",%s", text);
+      }
+    }
+    fprintf(context->outputfile, ",count\n");
+    if (fflush(context->outputfile) != 0) {
+      fprintf(stderr, ERROR_TEXT_FAILED_FLUSH_OUTPUT_FILE);
+    }
+    return EXIT_SUCCESS;
+  } else {
+    fprintf(stderr, ERROR_TEXT_OUTPUT_FILE_NOT_OPEN);
+    return EXIT_FAILURE;
+  }
+}
+
+/* Called on the writer thread for every sampled row */
+int pm_write_record(const struct pm_writer_record* record, void* user) {
+  struct pm_context* context = (struct pm_context*)(user);
+  unsigned long long start = pm_stats_now();
+  int result = pm_format_record(context, record);
+  pm_phase(context, PM_PHASE_FORMAT, start);
+  return result;
+}
+
+int pm_format_record(
+  struct pm_context* context,
+  const struct pm_writer_record* record) {
+  char text[PM_TEXT_BUFFER_SIZE];
+  struct tm tsr;
+  time_t t;
+  size_t k, length;
+  if (context->outputformat == PM_FORMAT_BIN) {
+    if (pm_binary_write(
+      &context->binary,
+      record->time,
+      record->elapsed,
+      record->values,
+      record->count) != EXIT_SUCCESS) {
+      fprintf(stderr, "Failed to write to the output file\n");
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  } else if (context->outputformat == PM_FORMAT_PACK) {
+    if (pm_packed_write(
+      &context->packed,
+      record->time,
+      record->elapsed,
+      record->values,
+      record->count) != EXIT_SUCCESS) {
+      fprintf(stderr, "Failed to write to the output file\n");
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  } else if (context->sketches == NULL) {
+    length = pm_encode_row(
+      &context->encoder,
+      record->time,
+      record->elapsed,
+      record->values,
+      context->monitoringcolumncount,
+      record->count);
+    if (fwrite(context->encoder.buffer, 1, length, context->outputfile) !=
+      length) {
+      fprintf(stderr, "Failed to write to the output file\n");
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+  t = (time_t)(record->time);
+#ifdef _WIN32
+  gmtime_s(&tsr, &t);
+#else
+  gmtime_r(&t, &tsr);
+#endif
+  strftime(text, PM_TEXT_BUFFER_SIZE, "%y-%m-%d,%H:%M:%S", &tsr);
+  fprintf(context->outputfile, "%s", text);
+  fprintf(context->outputfile, ",%llu", record->elapsed);
+  for (k = 0; k < context->monitoringcolumncount; ++k) {
+    if (pm_write_rollup(
+      context,
+      (const struct pm_sketch*)(&record->values[k * PM_ROLLUP_WORDS])) !=
+      EXIT_SUCCESS) {
+      return EXIT_FAILURE;
+    }
+  }
+  fprintf(context->outputfile, ",%lld\n", record->count);
+  return EXIT_SUCCESS;
+}
+
+/* The summary columns of one target and type in a rollup row */
+int pm_write_rollup(struct pm_context* context, const struct pm_sketch* sketch) {
+  char text[PM_SKETCH_TEXT_SIZE];
+  if (pm_sketch_format(sketch, text, sizeof(text)) != EXIT_SUCCESS) {
+    fprintf(stderr, "Failed to format a rollup sketch\n");
+    return EXIT_FAILURE;
+  }
+  fprintf(
+    context->outputfile,
+    ",%llu,%llu,%.1f,%llu,%llu,%llu,%s",
+    sketch->count > 0 ? sketch->min : 0ULL,
+    sketch->max,
+    sketch->count > 0 ? (double)(sketch->sum) / (double)(sketch->count) : 0.0,
+    pm_sketch_quantile(sketch, 0.50),
+    pm_sketch_quantile(sketch, 0.95),
+    pm_sketch_quantile(sketch, 0.99),
+    text);
+  return EXIT_SUCCESS;
+}
+
+/* Called on the writer thread as the flush policy says */
+int pm_flush_output(void* user) {
+  struct pm_context* context = (struct pm_context*)(user);
+  unsigned long long start = pm_stats_now();
+  int result = EXIT_SUCCESS;
+  if (context->outputfile && fflush(context->outputfile) != 0) {
+    fprintf(stderr, ERROR_TEXT_FAILED_FLUSH_OUTPUT_FILE);
+  }
+  if (context->packed.file && pm_packed_flush(&context->packed) !=
+    EXIT_SUCCESS) {
+    fprintf(stderr, ERROR_TEXT_FAILED_FLUSH_OUTPUT_FILE);
+    result = EXIT_FAILURE;
+  }
+  pm_phase(context, PM_PHASE_FLUSH, start);
+  return result;
+}
+
+int pm_parse_ids(char* ids, int** list, size_t* count, const char* what) {
+  size_t j = 0;
+  char* token;
+  char* save;
+  int id;
+  *count = pm_count_delimiters(ids, ',');
+  if (*count > 0) {
+    *list = (int*)(malloc(*count * sizeof(int)));
+    if (*list) {
+      token = PM_STRTOK(ids, ",", &save);
+      while (token != NULL) {
+        if (strlen(token) > 0) {
+          id = atoi(token);
+          if (id > 0) {
+            if (j >= *count) {
+              fprintf(stderr, "To many ids!\n");
+              return EXIT_FAILURE;
+            }
+            (*list)[j++] = id;
+            printf("Adding %s %d for monitoring\n", what, id);
+          } else {
+            fprintf(stderr, "The id '%s' is not a number\n", token);
+            return EXIT_FAILURE;
+          }
+        } else {
+          fprintf(stderr, "Error: Empty process ID number\n");
+          return EXIT_FAILURE;
+        }
+        token = PM_STRTOK(NULL, ",", &save);
+      }
+      *count = j;
+    } else {
+      fprintf(stderr, ERROR_TEXT_MEMORY);
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Targets are the process IDs, the names and then the trees marked with +,
+ * or the ranks of the top processes marked with #.
+ */
+int pm_target_name(
+  const struct pm_context* context,
+  size_t target,
+  char* name,
+  size_t size) {
+  int written;
+  if (context->top > 0) {
+    written = snprintf(name, size, "#%lu", (unsigned long)(target + 1));
+  } else if (target < context->monitoringidcount) {
+    written = snprintf(name, size, "%d", context->monitoringid[target]);
+  } else if ((target -= context->monitoringidcount) <
+    context->monitoringnamecount) {
+    written = snprintf(name, size, "%s", context->monitoringname[target]);
+  } else {
+    written = snprintf(
+      name,
+      size,
+      "%d+",
+      context->monitoringtree[target - context->monitoringnamecount]);
+  }
+  return written >= 0 && (size_t)(written) < size ?
+    EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+size_t pm_count_delimiters(const char* s, char ch) {
+  size_t count = 0;
+  if (*s != '\0') {
+    for (count = 1; *s != '\0'; ++s) {
+      if (*s == ch) {
+        ++count;
+      }
+    }
   }
   return count;
 }
@@ -0,0 +1,667 @@
+#ifndef _WIN32
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "parse.h"
+#include "procfs.h"
+
+#define PM_PROCFS_PATH_SIZE 64
+
+#define PM_PROCFS_CPU_SCALE 10000.0
+
+/* The kernel record returned by getdents64 */
+struct pm_procfs_dirent {
+  unsigned long long d_ino;
+  long long d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+/*
+ * A file or directory under /proc/<pid> and how to parse it. A process
+ * may not let us open or read an optional source, which then leaves its
+ * types at zero instead of failing the sample.
+ */
+struct pm_procfs_source {
+  const char* name;
+  bool optional;
+  int (*parse)(
+    struct pm_procfs_process* process,
+    const struct pm_procfs_plan* plan,
+    const char* buffer,
+    size_t length);
+};
+
+/* The sources a type is read from and the fields it needs from them */
+struct pm_procfs_provider {
+  unsigned int files;
+  unsigned int stat;
+  unsigned int status;
+};
+
+static ssize_t pm_procfs_read(
+  int fd,
+  char* buffer,
+  size_t size,
+  struct pm_syscall_count* count);
+static int pm_procfs_load(
+  struct pm_procfs_process* process,
+  const struct pm_procfs_plan* plan,
+  int file,
+  int fd,
+  struct pm_syscall_count* count);
+static int pm_procfs_count_fd(
+  struct pm_procfs_process* process,
+  int fd,
+  struct pm_syscall_count* count);
+static unsigned long long pm_procfs_field(const char* s, const char* key);
+static int pm_procfs_parse_statm(
+  struct pm_procfs_process* process,
+  const struct pm_procfs_plan* plan,
+  const char* buffer,
+  size_t length);
+static int pm_procfs_parse_status(
+  struct pm_procfs_process* process,
+  const struct pm_procfs_plan* plan,
+  const char* buffer,
+  size_t length);
+static int pm_procfs_parse_stat(
+  struct pm_procfs_process* process,
+  const struct pm_procfs_plan* plan,
+  const char* buffer,
+  size_t length);
+static int pm_procfs_parse_io(
+  struct pm_procfs_process* process,
+  const struct pm_procfs_plan* plan,
+  const char* buffer,
+  size_t length);
+static int pm_procfs_parse_smaps_rollup(
+  struct pm_procfs_process* process,
+  const struct pm_procfs_plan* plan,
+  const char* buffer,
+  size_t length);
+
+static const struct pm_procfs_source pm_procfs_source[PM_PROCFS_FILE_COUNT] = {
+  { "statm", false, pm_procfs_parse_statm },
+  { "status", false, pm_procfs_parse_status },
+  { "stat", false, pm_procfs_parse_stat },
+  { "io", true, pm_procfs_parse_io },
+  { "fd", true, NULL },
+  { "smaps_rollup", true, pm_procfs_parse_smaps_rollup }
+};
+
+static const struct pm_procfs_provider pm_procfs_provider[PM_TYPE_UNKNOWN] = {
+  { 0, 0, 0 },
+  {
+    PM_PROCFS_STAT_MASK,
+    PM_PARSE_STAT_FIELD(PM_PARSE_STAT_MINFLT) |
+      PM_PARSE_STAT_FIELD(PM_PARSE_STAT_MAJFLT),
+    0 },
+  { PM_PROCFS_STATUS_MASK, 0, PM_PARSE_STATUS_KEY(PM_PARSE_STATUS_VMHWM) },
+  { PM_PROCFS_STATM_MASK, 0, 0 },
+  { PM_PROCFS_STATUS_MASK, 0, PM_PARSE_STATUS_KEY(PM_PARSE_STATUS_VMPTE) },
+  { PM_PROCFS_STATUS_MASK, 0, PM_PARSE_STATUS_KEY(PM_PARSE_STATUS_VMPTE) },
+  { PM_PROCFS_STATUS_MASK, 0, PM_PARSE_STATUS_KEY(PM_PARSE_STATUS_VMLCK) },
+  { PM_PROCFS_STATUS_MASK, 0, PM_PARSE_STATUS_KEY(PM_PARSE_STATUS_VMLCK) },
+  { PM_PROCFS_STATM_MASK, 0, 0 },
+  { PM_PROCFS_STATUS_MASK, 0, PM_PARSE_STATUS_KEY(PM_PARSE_STATUS_VMPEAK) },
+  {
+    PM_PROCFS_STAT_MASK,
+    PM_PARSE_STAT_FIELD(PM_PARSE_STAT_UTIME) |
+      PM_PARSE_STAT_FIELD(PM_PARSE_STAT_STIME),
+    0 },
+  { PM_PROCFS_IO_MASK, 0, 0 },
+  { PM_PROCFS_IO_MASK, 0, 0 },
+  { PM_PROCFS_FD_MASK, 0, 0 },
+  { PM_PROCFS_STAT_MASK, PM_PARSE_STAT_FIELD(PM_PARSE_STAT_THREADS), 0 },
+  { PM_PROCFS_SMAPS_ROLLUP_MASK, 0, 0 },
+  { PM_PROCFS_SMAPS_ROLLUP_MASK, 0, 0 }
+};
+
+void pm_procfs_plan_reset(struct pm_procfs_plan* plan) {
+  plan->files = 0;
+  plan->slow = 0;
+  plan->stat = 0;
+  plan->status = 0;
+  plan->pagesize = (unsigned long long)(sysconf(_SC_PAGESIZE));
+  plan->clockticks = (unsigned long long)(sysconf(_SC_CLK_TCK));
+}
+
+/* A source a cheap type is read from is read on every tick */
+void pm_procfs_plan_add(struct pm_procfs_plan* plan, int type) {
+  unsigned int files;
+  if (type > PM_TYPE_UNDEFINED && type < PM_TYPE_UNKNOWN) {
+    files = pm_procfs_provider[type].files;
+    if (pm_type_arr[type - 1].cost == PM_COST_EXPENSIVE) {
+      plan->slow |= files & ~(plan->files & ~plan->slow);
+    } else {
+      plan->slow &= ~files;
+    }
+    plan->files |= files;
+    plan->stat |= pm_procfs_provider[type].stat;
+    plan->status |= pm_procfs_provider[type].status;
+  }
+}
+
+void pm_procfs_count_reset(struct pm_syscall_count* count) {
+  count->total = 0;
+  count->reads = 0;
+}
+
+void pm_procfs_reset(struct pm_procfs_process* process) {
+  int i;
+  process->pid = 0;
+  process->start = 0;
+  for (i = 0; i < PM_PROCFS_FILE_COUNT; ++i) {
+    process->fd[i] = -1;
+  }
+  process->cputime = 0;
+  process->cpustamp = 0;
+  process->opentick = 0;
+  process->slowtick = 0;
+  process->slowelapsed = 0;
+  process->readelapsed = 0;
+  process->every = 0;
+  process->due = 0;
+  memset(process->value, 0x00, sizeof(process->value));
+}
+
+int pm_procfs_open(
+  struct pm_procfs_process* process,
+  int pid,
+  unsigned long long start) {
+  pm_procfs_reset(process);
+  process->pid = pid;
+  process->start = start;
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Only touches the process and the buffers on the stack so that sampler
+ * threads can sample different processes at the same time, each counting
+ * its system calls in its own count. The slow sources are only read when
+ * slow is set and keep their last values otherwise.
+ */
+int pm_procfs_sample(
+  int root,
+  struct pm_procfs_process* process,
+  const struct pm_procfs_plan* plan,
+  bool slow,
+  struct pm_syscall_count* count) {
+  char path[PM_PROCFS_PATH_SIZE];
+  unsigned int files = slow ? plan->files : plan->files & ~plan->slow;
+  int i, result;
+  for (i = 0; i < PM_PROCFS_FILE_COUNT; ++i) {
+    if ((files & (1u << i)) == 0 ||
+      process->fd[i] == PM_PROCFS_UNAVAILABLE) {
+      continue;
+    }
+    if (process->fd[i] < 0) {
+      snprintf(
+        path,
+        PM_PROCFS_PATH_SIZE,
+        "%d/%s",
+        process->pid,
+        pm_procfs_source[i].name);
+      count->total++;
+      process->fd[i] = openat(
+        root,
+        path,
+        O_RDONLY | O_CLOEXEC | (i == PM_PROCFS_FD ? O_DIRECTORY : 0));
+      if (process->fd[i] < 0) {
+        if (pm_procfs_source[i].optional) {
+          process->fd[i] = PM_PROCFS_UNAVAILABLE;
+          continue;
+        }
+        return EXIT_FAILURE;
+      }
+      count->files++;
+    }
+    if ((result = pm_procfs_load(process, plan, i, process->fd[i], count)) !=
+      EXIT_SUCCESS) {
+      if (pm_procfs_source[i].optional) {
+        count->total++;
+        count->files--;
+        close(process->fd[i]);
+        process->fd[i] = PM_PROCFS_UNAVAILABLE;
+        continue;
+      }
+      return result;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Sample a process without keeping its files open, opening each of them
+ * relative to the open process directory root. Used when every process is
+ * sampled, as keeping their files open would run out of descriptors.
+ */
+int pm_procfs_scan(
+  int root,
+  struct pm_procfs_process* process,
+  const struct pm_procfs_plan* plan,
+  bool slow,
+  struct pm_syscall_count* count) {
+  char path[PM_PROCFS_PATH_SIZE];
+  unsigned int files = slow ? plan->files : plan->files & ~plan->slow;
+  int i, fd, result;
+  for (i = 0; i < PM_PROCFS_FILE_COUNT; ++i) {
+    if ((files & (1u << i)) == 0) {
+      continue;
+    }
+    snprintf(
+      path,
+      PM_PROCFS_PATH_SIZE,
+      "%d/%s",
+      process->pid,
+      pm_procfs_source[i].name);
+    count->total++;
+    fd = openat(
+      root,
+      path,
+      O_RDONLY | O_CLOEXEC | (i == PM_PROCFS_FD ? O_DIRECTORY : 0));
+    if (fd < 0) {
+      if (pm_procfs_source[i].optional) {
+        continue;
+      }
+      return EXIT_FAILURE;
+    }
+    result = pm_procfs_load(process, plan, i, fd, count);
+    count->total++;
+    close(fd);
+    if (result != EXIT_SUCCESS && !pm_procfs_source[i].optional) {
+      return result;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+void pm_procfs_close(
+  struct pm_procfs_process* process,
+  struct pm_syscall_count* count) {
+  int i;
+  for (i = 0; i < PM_PROCFS_FILE_COUNT; ++i) {
+    if (process->fd[i] >= 0) {
+      count->total++;
+      count->files--;
+      close(process->fd[i]);
+      process->fd[i] = -1;
+    }
+  }
+  process->pid = 0;
+}
+
+int pm_procfs_name(
+  int root,
+  int pid,
+  char* name,
+  size_t size,
+  struct pm_syscall_count* count) {
+  char path[PM_PROCFS_PATH_SIZE];
+  int fd;
+  ssize_t length;
+  snprintf(path, PM_PROCFS_PATH_SIZE, "%d/comm", pid);
+  count->total++;
+  fd = openat(root, path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return EXIT_FAILURE;
+  }
+  length = pm_procfs_read(fd, name, size, count);
+  count->total++;
+  close(fd);
+  if (length <= 0) {
+    name[0] = '\0';
+    return EXIT_FAILURE;
+  }
+  if (name[length - 1] == '\n') {
+    name[length - 1] = '\0';
+  }
+  return EXIT_SUCCESS;
+}
+
+/*
+ * The name and start time of a process from a single read of its stat
+ * file. The start time tells a reused process ID from the original.
+ */
+int pm_procfs_identity(
+  int root,
+  int pid,
+  char* name,
+  size_t size,
+  unsigned long long* start,
+  int* parent,
+  struct pm_syscall_count* count) {
+  char buffer[PM_PROCFS_BUFFER_SIZE];
+  char path[PM_PROCFS_PATH_SIZE];
+  unsigned long long value[PM_PARSE_STAT_FIELD_COUNT];
+  const char* first;
+  ssize_t length;
+  size_t namelength;
+  int fd;
+  snprintf(path, PM_PROCFS_PATH_SIZE, "%d/stat", pid);
+  count->total++;
+  fd = openat(root, path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return EXIT_FAILURE;
+  }
+  length = pm_procfs_read(fd, buffer, PM_PROCFS_BUFFER_SIZE, count);
+  count->total++;
+  close(fd);
+  value[PM_PARSE_STAT_PPID] = 0;
+  value[PM_PARSE_STAT_STARTTIME] = 0;
+  if (length <= 0 ||
+    pm_parse_comm(buffer, (size_t)(length), &first, &namelength) == NULL ||
+    pm_parse_stat(
+      buffer,
+      (size_t)(length),
+      PM_PARSE_STAT_FIELD(PM_PARSE_STAT_PPID) |
+        PM_PARSE_STAT_FIELD(PM_PARSE_STAT_STARTTIME),
+      value) != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+  if (namelength >= size) {
+    namelength = size - 1;
+  }
+  memcpy(name, first, namelength);
+  name[namelength] = '\0';
+  *parent = (int)(value[PM_PARSE_STAT_PPID]);
+  *start = value[PM_PARSE_STAT_STARTTIME];
+  return EXIT_SUCCESS;
+}
+
+void pm_procfs_directory_reset(struct pm_procfs_directory* directory) {
+  directory->root = PM_PROCFS_ROOT;
+  directory->fd = -1;
+  directory->length = 0;
+  directory->position = 0;
+}
+
+int pm_procfs_enumerate_begin(
+  struct pm_procfs_directory* directory,
+  struct pm_syscall_count* count) {
+  if (directory->fd < 0) {
+    count->total++;
+    directory->fd = open(
+      directory->root,
+      O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directory->fd < 0) {
+      return EXIT_FAILURE;
+    }
+  } else {
+    count->total++;
+    if (lseek(directory->fd, 0, SEEK_SET) != 0) {
+      return EXIT_FAILURE;
+    }
+  }
+  directory->length = 0;
+  directory->position = 0;
+  return EXIT_SUCCESS;
+}
+
+int pm_procfs_enumerate_next(
+  struct pm_procfs_directory* directory,
+  struct pm_syscall_count* count) {
+  struct pm_procfs_dirent* entry;
+  const char* name;
+  int pid;
+  for (;;) {
+    if (directory->position >= directory->length) {
+      count->total++;
+      directory->length = syscall(
+        SYS_getdents64,
+        directory->fd,
+        directory->buffer,
+        PM_PROCFS_DIRENT_BUFFER_SIZE);
+      directory->position = 0;
+      if (directory->length <= 0) {
+        return -1;
+      }
+    }
+    entry = (struct pm_procfs_dirent*)(
+      directory->buffer + directory->position);
+    directory->position += entry->d_reclen;
+    name = entry->d_name;
+    if (*name >= '1' && *name <= '9') {
+      pid = 0;
+      while (*name >= '0' && *name <= '9') {
+        pid = 10 * pid + (*name++ - '0');
+      }
+      if (*name == '\0') {
+        return pid;
+      }
+    }
+  }
+}
+
+void pm_procfs_enumerate_close(struct pm_procfs_directory* directory) {
+  if (directory->fd >= 0) {
+    close(directory->fd);
+    directory->fd = -1;
+  }
+}
+
+ssize_t pm_procfs_read(
+  int fd,
+  char* buffer,
+  size_t size,
+  struct pm_syscall_count* count) {
+  ssize_t length;
+  count->total++;
+  length = pread(fd, buffer, size - 1, 0);
+  if (length >= 0) {
+    buffer[length] = '\0';
+  }
+  return length;
+}
+
+/* Read one source of the process from its open file or directory */
+int pm_procfs_load(
+  struct pm_procfs_process* process,
+  const struct pm_procfs_plan* plan,
+  int file,
+  int fd,
+  struct pm_syscall_count* count) {
+  char buffer[PM_PROCFS_BUFFER_SIZE];
+  ssize_t length;
+  if (file == PM_PROCFS_FD) {
+    return pm_procfs_count_fd(process, fd, count);
+  }
+  if ((length = pm_procfs_read(fd, buffer, PM_PROCFS_BUFFER_SIZE, count)) <=
+    0) {
+    return EXIT_FAILURE;
+  }
+  count->reads++;
+  return pm_procfs_source[file].parse(
+    process,
+    plan,
+    buffer,
+    (size_t)(length));
+}
+
+/* fd: one entry per open descriptor besides . and .. */
+int pm_procfs_count_fd(
+  struct pm_procfs_process* process,
+  int fd,
+  struct pm_syscall_count* count) {
+  unsigned long long buffer[PM_PROCFS_BUFFER_SIZE / sizeof(unsigned long long)];
+  const struct pm_procfs_dirent* entry;
+  unsigned long long descriptors = 0;
+  long length, position;
+  count->total++;
+  if (lseek(fd, 0, SEEK_SET) != 0) {
+    return EXIT_FAILURE;
+  }
+  for (;;) {
+    count->total++;
+    length = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+    if (length < 0) {
+      return EXIT_FAILURE;
+    } else if (length == 0) {
+      break;
+    }
+    for (position = 0; position < length; position += entry->d_reclen) {
+      entry = (const struct pm_procfs_dirent*)((char*)(buffer) + position);
+      if (entry->d_name[0] != '.') {
+        ++descriptors;
+      }
+    }
+  }
+  count->reads++;
+  process->value[PM_TYPE_DESCRIPTOR_COUNT] = descriptors;
+  return EXIT_SUCCESS;
+}
+
+unsigned long long pm_procfs_field(const char* s, const char* key) {
+  const char* p = strstr(s, key);
+  if (p != NULL) {
+    p += strlen(key);
+    return pm_parse_number(&p);
+  }
+  return 0;
+}
+
+/* statm: size resident shared text lib data dt, all in pages */
+int pm_procfs_parse_statm(
+  struct pm_procfs_process* process,
+  const struct pm_procfs_plan* plan,
+  const char* buffer,
+  size_t length) {
+  const char* p = buffer;
+  unsigned long long size, resident;
+  (void)(length);
+  size = pm_parse_number(&p);
+  resident = pm_parse_number(&p);
+  process->value[PM_TYPE_PAGEFILE_USAGE] = size * plan->pagesize;
+  process->value[PM_TYPE_WORKING_SET_SIZE] = resident * plan->pagesize;
+  return EXIT_SUCCESS;
+}
+
+/*
+ * The quota pool types have no direct Linux counterpart. The page tables
+ * (VmPTE) stand in for the paged pool and locked memory (VmLck) for the
+ * non paged pool. Their peaks are tracked here across ticks.
+ */
+int pm_procfs_parse_status(
+  struct pm_procfs_process* process,
+  const struct pm_procfs_plan* plan,
+  const char* buffer,
+  size_t length) {
+  unsigned long long kb[PM_PARSE_STATUS_KEY_COUNT];
+  unsigned long long* v = process->value;
+  memset(kb, 0x00, sizeof(kb));
+  pm_parse_status(buffer, length, plan->status, kb);
+  v[PM_TYPE_PEAK_PAGEFILE_USAGE] = 1024ULL * kb[PM_PARSE_STATUS_VMPEAK];
+  v[PM_TYPE_PEAK_WORKING_SET_SIZE] = 1024ULL * kb[PM_PARSE_STATUS_VMHWM];
+  v[PM_TYPE_QUOTA_NON_PAGED_POOL_USAGE] = 1024ULL * kb[PM_PARSE_STATUS_VMLCK];
+  v[PM_TYPE_QUOTA_PAGED_POOL_USAGE] = 1024ULL * kb[PM_PARSE_STATUS_VMPTE];
+  if (v[PM_TYPE_QUOTA_NON_PAGED_POOL_USAGE] >
+    v[PM_TYPE_QUOTA_PEAK_NON_PAGED_POOL_USAGE]) {
+    v[PM_TYPE_QUOTA_PEAK_NON_PAGED_POOL_USAGE] =
+      v[PM_TYPE_QUOTA_NON_PAGED_POOL_USAGE];
+  }
+  if (v[PM_TYPE_QUOTA_PAGED_POOL_USAGE] >
+    v[PM_TYPE_QUOTA_PEAK_PAGED_POOL_USAGE]) {
+    v[PM_TYPE_QUOTA_PEAK_PAGED_POOL_USAGE] =
+      v[PM_TYPE_QUOTA_PAGED_POOL_USAGE];
+  }
+  return EXIT_SUCCESS;
+}
+
+/*
+ * stat: only the fields the plan asks for are parsed, and the start time
+ * to tell a reused process ID. The CPU usage is the user and system time
+ * spent since the last read over the time passed, zero on the first read.
+ */
+int pm_procfs_parse_stat(
+  struct pm_procfs_process* process,
+  const struct pm_procfs_plan* plan,
+  const char* buffer,
+  size_t length) {
+  unsigned long long value[PM_PARSE_STAT_FIELD_COUNT];
+  unsigned long long cputime, stamp;
+  struct timespec now;
+  memset(value, 0x00, sizeof(value));
+  if (pm_parse_stat(
+    buffer,
+    length,
+    plan->stat | PM_PARSE_STAT_FIELD(PM_PARSE_STAT_STARTTIME),
+    value) != EXIT_SUCCESS ||
+    (process->start != 0 &&
+      value[PM_PARSE_STAT_STARTTIME] != process->start)) {
+    return EXIT_FAILURE;
+  }
+  process->value[PM_TYPE_PAGE_FAULT_COUNT] =
+    value[PM_PARSE_STAT_MINFLT] + value[PM_PARSE_STAT_MAJFLT];
+  process->value[PM_TYPE_THREAD_COUNT] = value[PM_PARSE_STAT_THREADS];
+  if ((plan->stat & PM_PARSE_STAT_FIELD(PM_PARSE_STAT_UTIME)) == 0) {
+    return EXIT_SUCCESS;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  stamp = 1000000000ULL * (unsigned long long)(now.tv_sec) +
+    (unsigned long long)(now.tv_nsec);
+  cputime = value[PM_PARSE_STAT_UTIME] + value[PM_PARSE_STAT_STIME];
+  process->value[PM_TYPE_CPU_USAGE] =
+    process->cpustamp > 0 && stamp > process->cpustamp &&
+    cputime >= process->cputime ?
+      (unsigned long long)(PM_PROCFS_CPU_SCALE * 1e9 *
+        (double)(cputime - process->cputime) /
+        (double)(plan->clockticks) /
+        (double)(stamp - process->cpustamp)) :
+      0;
+  process->cputime = cputime;
+  process->cpustamp = stamp;
+  return EXIT_SUCCESS;
+}
+
+/* io: the bytes that were fetched from and sent to the storage layer */
+int pm_procfs_parse_io(
+  struct pm_procfs_process* process,
+  const struct pm_procfs_plan* plan,
+  const char* buffer,
+  size_t length) {
+  (void)(plan);
+  (void)(length);
+  process->value[PM_TYPE_READ_BYTES] =
+    pm_procfs_field(buffer, "\nread_bytes:");
+  process->value[PM_TYPE_WRITE_BYTES] =
+    pm_procfs_field(buffer, "\nwrite_bytes:");
+  return EXIT_SUCCESS;
+}
+
+/*
+ * smaps_rollup: the kernel walks every mapping of the process to sum it,
+ * which is why it is only read on the slow cadence. The shared pages are
+ * split between their sharers in Pss and left out of the private ones.
+ */
+int pm_procfs_parse_smaps_rollup(
+  struct pm_procfs_process* process,
+  const struct pm_procfs_plan* plan,
+  const char* buffer,
+  size_t length) {
+  (void)(plan);
+  (void)(length);
+  process->value[PM_TYPE_PROPORTIONAL_SET_SIZE] =
+    1024ULL * pm_procfs_field(buffer, "\nPss:");
+  process->value[PM_TYPE_UNIQUE_SET_SIZE] =
+    1024ULL * (pm_procfs_field(buffer, "\nPrivate_Clean:") +
+      pm_procfs_field(buffer, "\nPrivate_Dirty:"));
+  return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef PM_PROCFS_H_
+#define PM_PROCFS_H_
+
+#ifndef _WIN32
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <pm/pm.h>
+
+#define PM_PROCFS_ROOT "/proc"
+
+#define PM_PROCFS_STATM 0
+#define PM_PROCFS_STATUS 1
+#define PM_PROCFS_STAT 2
+#define PM_PROCFS_IO 3
+#define PM_PROCFS_FD 4
+#define PM_PROCFS_SMAPS_ROLLUP 5
+#define PM_PROCFS_FILE_COUNT 6
+
+#define PM_PROCFS_STATM_MASK (1u << PM_PROCFS_STATM)
+#define PM_PROCFS_STATUS_MASK (1u << PM_PROCFS_STATUS)
+#define PM_PROCFS_STAT_MASK (1u << PM_PROCFS_STAT)
+#define PM_PROCFS_IO_MASK (1u << PM_PROCFS_IO)
+#define PM_PROCFS_FD_MASK (1u << PM_PROCFS_FD)
+#define PM_PROCFS_SMAPS_ROLLUP_MASK (1u << PM_PROCFS_SMAPS_ROLLUP)
+
+/* A source the process does not let us read, such as io of another user */
+#define PM_PROCFS_UNAVAILABLE -2
+
+#define PM_PROCFS_BUFFER_SIZE 4096
+#define PM_PROCFS_DIRENT_BUFFER_SIZE 32768
+
+/*
+ * An open monitored process. The metric files are opened once and re-read
+ * with pread at offset 0 on every tick until the process goes away.
+ */
+struct pm_procfs_process {
+  int pid;
+  /* Checked on every read of stat, so a reused ID fails like an exit */
+  unsigned long long start;
+  int fd[PM_PROCFS_FILE_COUNT];
+  /* The CPU time and when it was read, for the usage over the next tick */
+  unsigned long long cputime;
+  unsigned long long cpustamp;
+  /* Tells when the process went a full cadence without a slow read */
+  unsigned long opentick;
+  /* The tick after the slow sources were last read, zero until they are */
+  unsigned long slowtick;
+  /* The elapsed ms of the last slow read and the last read, for the ages */
+  unsigned long long slowelapsed;
+  unsigned long long readelapsed;
+  /* In adaptive mode the ticks between reads and the tick of the next */
+  unsigned long every;
+  unsigned long due;
+  unsigned long long value[PM_TYPE_UNKNOWN];
+};
+
+/*
+ * What a tick reads: the sources, the stat fields and the status keys the
+ * selected types need, built with pm_procfs_plan_add for each type. The
+ * slow sources are those only expensive types are read from. The page
+ * size and the clock ticks per second are read once by the reset.
+ */
+struct pm_procfs_plan {
+  unsigned int files;
+  unsigned int slow;
+  unsigned int stat;
+  unsigned int status;
+  unsigned long long pagesize;
+  unsigned long long clockticks;
+};
+
+/*
+ * The open process directory and the entries of the last getdents64. The
+ * root is PM_PROCFS_ROOT unless a copy of the tree is monitored instead,
+ * and every process file is opened relative to fd.
+ */
+struct pm_procfs_directory {
+  const char* root;
+  int fd;
+  long length;
+  long position;
+  char buffer[PM_PROCFS_DIRENT_BUFFER_SIZE];
+};
+
+/*
+ * The procfs backend keeps no state of its own. System calls are counted
+ * in the given count; the total and read counts are reset on every tick
+ * while the file count follows the open metric files.
+ */
+void pm_procfs_plan_reset(struct pm_procfs_plan* plan);
+void pm_procfs_plan_add(struct pm_procfs_plan* plan, int type);
+
+void pm_procfs_count_reset(struct pm_syscall_count* count);
+
+void pm_procfs_reset(struct pm_procfs_process* process);
+ int pm_procfs_open(
+  struct pm_procfs_process* process,
+  int pid,
+  unsigned long long start);
+ int pm_procfs_sample(
+  int root,
+  struct pm_procfs_process* process,
+  const struct pm_procfs_plan* plan,
+  bool slow,
+  struct pm_syscall_count* count);
+ int pm_procfs_scan(
+  int root,
+  struct pm_procfs_process* process,
+  const struct pm_procfs_plan* plan,
+  bool slow,
+  struct pm_syscall_count* count);
+void pm_procfs_close(
+  struct pm_procfs_process* process,
+  struct pm_syscall_count* count);
+
+ int pm_procfs_name(
+  int root,
+  int pid,
+  char* name,
+  size_t size,
+  struct pm_syscall_count* count);
+ int pm_procfs_identity(
+  int root,
+  int pid,
+  char* name,
+  size_t size,
+  unsigned long long* start,
+  int* parent,
+  struct pm_syscall_count* count);
+
+void pm_procfs_directory_reset(struct pm_procfs_directory* directory);
+ int pm_procfs_enumerate_begin(
+  struct pm_procfs_directory* directory,
+  struct pm_syscall_count* count);
+ int pm_procfs_enumerate_next(
+  struct pm_procfs_directory* directory,
+  struct pm_syscall_count* count);
+void pm_procfs_enumerate_close(struct pm_procfs_directory* directory);
+
+#endif
+
+#endif
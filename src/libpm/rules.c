@@ -0,0 +1,162 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "rules.h"
+
+#define PM_RULES_MS_PER_HOUR 3600000.0
+
+static const char* pm_rule_size(const char* text, double* value);
+
+void pm_rules_reset(struct pm_rules* rules) {
+  memset(rules, 0x00, sizeof(struct pm_rules));
+}
+
+int pm_rules_create(
+  struct pm_rules* rules,
+  size_t targets,
+  struct pm_arena* arena) {
+  size_t bytes = pm_rules_bytes(rules->count, targets);
+  rules->targets = targets;
+  rules->events = 0;
+  if (bytes == 0) {
+    return EXIT_SUCCESS;
+  }
+  rules->state = (struct pm_rule_state*)(pm_arena_alloc(arena, bytes));
+  if (rules->state == NULL) {
+    return EXIT_FAILURE;
+  }
+  memset(rules->state, 0x00, bytes);
+  return EXIT_SUCCESS;
+}
+
+size_t pm_rules_bytes(size_t rules, size_t targets) {
+  return rules * targets * sizeof(struct pm_rule_state);
+}
+
+/*
+ * The text is the short type name followed by >limit, <limit or +limit/h
+ * and an optional :samples, like wss>2G:5 or wss+100M/h:60. Limits take a
+ * K, M, G or T suffix in powers of 1024.
+ */
+int pm_rule_parse(struct pm_rule* rule, int type, const char* text) {
+  const char* p = text;
+  char* end;
+  memset(rule, 0x00, sizeof(struct pm_rule));
+  if (strlen(text) >= PM_RULE_TEXT_SIZE) {
+    return EXIT_FAILURE;
+  }
+  memcpy(rule->text, text, strlen(text) + 1);
+  rule->type = type;
+  while ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z')) {
+    ++p;
+  }
+  switch (*p++) {
+  case '>':
+    rule->kind = PM_RULE_ABOVE;
+    rule->samples = 1;
+    break;
+  case '<':
+    rule->kind = PM_RULE_BELOW;
+    rule->samples = 1;
+    break;
+  case '+':
+    rule->kind = PM_RULE_SLOPE;
+    rule->samples = PM_RULE_DEFAULT_WINDOW;
+    break;
+  default:
+    return EXIT_FAILURE;
+  }
+  if ((p = pm_rule_size(p, &rule->limit)) == NULL) {
+    return EXIT_FAILURE;
+  }
+  if (rule->kind == PM_RULE_SLOPE) {
+    if (strncmp(p, "/h", 2) != 0) {
+      return EXIT_FAILURE;
+    }
+    p += 2;
+  }
+  if (*p == ':') {
+    rule->samples = strtoul(p + 1, &end, 10);
+    if (end == p + 1 || rule->samples == 0) {
+      return EXIT_FAILURE;
+    }
+    p = end;
+  }
+  return *p == '\0' ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * A threshold only counts the run of samples on the wrong side of it. A
+ * slope first needs samples samples, then fires while it is too steep.
+ * The weights decay by 1 - 1 / samples per sample.
+ */
+bool pm_rule_check(
+  const struct pm_rule* rule,
+  struct pm_rule_state* state,
+  unsigned long long elapsed,
+  unsigned long long value,
+  double* slope) {
+  double x, y, dx, decay;
+  bool holds;
+  *slope = 0.0;
+  if (rule->kind == PM_RULE_SLOPE) {
+    x = (double)(elapsed) / PM_RULES_MS_PER_HOUR;
+    y = (double)(value);
+    decay = 1.0 - 1.0 / (double)(rule->samples);
+    state->weight = decay * state->weight + 1.0;
+    dx = x - state->meanx;
+    state->meanx += dx / state->weight;
+    state->meany += (y - state->meany) / state->weight;
+    state->cxx = decay * state->cxx + dx * (x - state->meanx);
+    state->cxy = decay * state->cxy + dx * (y - state->meany);
+    if (state->run < rule->samples) {
+      ++state->run;
+    }
+    if (state->cxx > 0.0) {
+      *slope = state->cxy / state->cxx;
+    }
+    holds = state->run >= rule->samples && *slope > rule->limit;
+  } else {
+    if (rule->kind == PM_RULE_ABOVE ?
+      (double)(value) > rule->limit :
+      (double)(value) < rule->limit) {
+      ++state->run;
+    } else {
+      state->run = 0;
+    }
+    holds = state->run >= rule->samples;
+  }
+  if (!holds) {
+    state->fired = false;
+    return false;
+  }
+  if (state->fired) {
+    return false;
+  }
+  state->fired = true;
+  return true;
+}
+
+const char* pm_rule_size(const char* text, double* value) {
+  char* end;
+  *value = strtod(text, &end);
+  if (end == text || *value < 0.0) {
+    return NULL;
+  }
+  switch (*end) {
+  case 'T':
+    *value *= 1024.0;
+    /* fall through */
+  case 'G':
+    *value *= 1024.0;
+    /* fall through */
+  case 'M':
+    *value *= 1024.0;
+    /* fall through */
+  case 'K':
+    *value *= 1024.0;
+    ++end;
+    break;
+  }
+  return end;
+}
@@ -0,0 +1,78 @@
+#ifndef PM_RULES_H_
+#define PM_RULES_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "arena.h"
+
+#define PM_RULE_ABOVE 0
+#define PM_RULE_BELOW 1
+#define PM_RULE_SLOPE 2
+
+#define PM_RULES_MAX 16
+#define PM_RULE_TEXT_SIZE 48
+#define PM_RULE_DEFAULT_WINDOW 30
+
+/*
+ * A rule on one type of every target. A threshold rule holds when the
+ * value is above or below the limit for samples consecutive samples. A
+ * slope rule holds when the least squares slope of the value over about
+ * the last samples samples grows faster than the limit per hour.
+ */
+struct pm_rule {
+  int kind;
+  int type;
+  size_t column;
+  double limit;
+  unsigned long samples;
+  char text[PM_RULE_TEXT_SIZE];
+};
+
+/*
+ * A rule for one target. The slope is fitted online with exponentially
+ * decaying weights, updating the weighted means and co-moments as each
+ * sample arrives, so it takes the same memory however long it runs and
+ * stays accurate when the elapsed time grows large.
+ */
+struct pm_rule_state {
+  unsigned long run;
+  bool fired;
+  double weight;
+  double meanx;
+  double meany;
+  double cxx;
+  double cxy;
+};
+
+/* The state of every rule for every target is carved from the arena */
+struct pm_rules {
+  struct pm_rule rule[PM_RULES_MAX];
+  size_t count;
+  size_t targets;
+  struct pm_rule_state* state;
+  unsigned long long events;
+};
+
+void pm_rules_reset(struct pm_rules* rules);
+ int pm_rules_create(
+  struct pm_rules* rules,
+  size_t targets,
+  struct pm_arena* arena);
+
+size_t pm_rules_bytes(size_t rules, size_t targets);
+
+ int pm_rule_parse(struct pm_rule* rule, int type, const char* text);
+
+/*
+ * Add a sample taken at elapsed ms. Returns true only on the sample the
+ * rule starts to hold; it has to stop holding before it fires again.
+ */
+bool pm_rule_check(
+  const struct pm_rule* rule,
+  struct pm_rule_state* state,
+  unsigned long long elapsed,
+  unsigned long long value,
+  double* slope);
+
+#endif
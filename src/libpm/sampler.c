@@ -0,0 +1,293 @@
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#endif
+
+#include "atomic.h"
+#include "sampler.h"
+
+#define PM_SAMPLER_CACHE_LINE 64
+
+/*
+ * The items left in a shard run from next to end. The owner and thieves
+ * both claim items with an atomic add on next. Each shard sits on its own
+ * cache lines as it is written on every sample.
+ */
+struct pm_sampler_shard {
+  size_t next;
+  size_t end;
+  unsigned long long first;
+  unsigned long long last;
+  unsigned long long stolen;
+  bool sampled;
+  struct pm_sampler* sampler;
+  unsigned int worker;
+#ifdef _WIN32
+  HANDLE wake;
+  HANDLE thread;
+#else
+  sem_t wake;
+  pthread_t thread;
+#endif
+  unsigned char padding[PM_SAMPLER_CACHE_LINE];
+};
+
+static void pm_sampler_work(struct pm_sampler_shard* shard);
+static void pm_sampler_take(struct pm_sampler_shard* shard, size_t item);
+static unsigned long long pm_sampler_now();
+#ifdef _WIN32
+static DWORD WINAPI pm_sampler_thread(LPVOID parameter);
+#else
+static void* pm_sampler_thread(void* parameter);
+#endif
+
+void pm_sampler_reset(struct pm_sampler* sampler) {
+  memset(sampler, 0x00, sizeof(struct pm_sampler));
+}
+
+int pm_sampler_start(
+  struct pm_sampler* sampler,
+  unsigned int threads,
+  pm_sampler_sample sample,
+  void* user,
+  struct pm_arena* arena) {
+  struct pm_sampler_shard* shard;
+  unsigned int w;
+  pm_sampler_reset(sampler);
+  if (threads == 0 || threads > PM_SAMPLER_MAX_THREADS) {
+    return EXIT_FAILURE;
+  }
+  sampler->shards = (struct pm_sampler_shard*)(
+    pm_arena_alloc(arena, pm_sampler_bytes(threads)));
+  if (sampler->shards == NULL) {
+    return EXIT_FAILURE;
+  }
+  memset(sampler->shards, 0x00, pm_sampler_bytes(threads));
+  for (w = 0; w < threads; ++w) {
+    sampler->shards[w].sampler = sampler;
+    sampler->shards[w].worker = w;
+  }
+  sampler->threadcount = threads;
+  sampler->sample = sample;
+  sampler->user = user;
+  sampler->count.threads = threads;
+  pm_sampler_now();
+  if (threads == 1) {
+    return EXIT_SUCCESS;
+  }
+#ifdef _WIN32
+  sampler->done = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+  if (sampler->done == NULL) {
+    sampler->shards = NULL;
+    return EXIT_FAILURE;
+  }
+#else
+  if (sem_init(&sampler->done, 0, 0) != 0) {
+    sampler->shards = NULL;
+    return EXIT_FAILURE;
+  }
+#endif
+  for (sampler->started = 1; sampler->started < threads; ++sampler->started) {
+    shard = &sampler->shards[sampler->started];
+#ifdef _WIN32
+    shard->wake = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+    if (shard->wake == NULL) {
+      break;
+    }
+    shard->thread = CreateThread(NULL, 0, pm_sampler_thread, shard, 0, NULL);
+    if (shard->thread == NULL) {
+      CloseHandle(shard->wake);
+      break;
+    }
+#else
+    if (sem_init(&shard->wake, 0, 0) != 0) {
+      break;
+    }
+    if (pthread_create(&shard->thread, NULL, pm_sampler_thread, shard) != 0) {
+      sem_destroy(&shard->wake);
+      break;
+    }
+#endif
+  }
+  if (sampler->started < threads) {
+    pm_sampler_stop(sampler);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/* Sample count items across the pool and wait for all of them */
+void pm_sampler_run(struct pm_sampler* sampler, size_t count) {
+  struct pm_sampler_shard* shards = sampler->shards;
+  unsigned int threads = sampler->threadcount, w;
+  unsigned long long first = 0, last = 0, spread;
+  bool sampled = false;
+  for (w = 0; w < threads; ++w) {
+    shards[w].next = count * w / threads;
+    shards[w].end = count * (w + 1) / threads;
+  }
+  for (w = 1; w < threads; ++w) {
+#ifdef _WIN32
+    ReleaseSemaphore(shards[w].wake, 1, NULL);
+#else
+    sem_post(&shards[w].wake);
+#endif
+  }
+  pm_sampler_work(&shards[0]);
+  for (w = 1; w < threads; ++w) {
+#ifdef _WIN32
+    WaitForSingleObject(sampler->done, INFINITE);
+#else
+    while (sem_wait(&sampler->done) != 0 && errno == EINTR) {
+    }
+#endif
+  }
+  for (w = 0; w < threads; ++w) {
+    sampler->count.stolen += shards[w].stolen;
+    shards[w].stolen = 0;
+    if (shards[w].sampled) {
+      if (!sampled || shards[w].first < first) {
+        first = shards[w].first;
+      }
+      if (!sampled || shards[w].last > last) {
+        last = shards[w].last;
+      }
+      sampled = true;
+    }
+  }
+  if (sampled) {
+    spread = last - first;
+    sampler->count.spread = spread;
+    sampler->count.spreadsum += spread;
+    if (spread > sampler->count.spreadmax) {
+      sampler->count.spreadmax = spread;
+    }
+    sampler->count.ticks++;
+  }
+}
+
+void pm_sampler_stop(struct pm_sampler* sampler) {
+  struct pm_sampler_shard* shard;
+  unsigned int w;
+  if (sampler->shards == NULL) {
+    return;
+  }
+  sampler->stopping = true;
+  for (w = 1; w < sampler->started; ++w) {
+    shard = &sampler->shards[w];
+#ifdef _WIN32
+    ReleaseSemaphore(shard->wake, 1, NULL);
+    WaitForSingleObject(shard->thread, INFINITE);
+    CloseHandle(shard->thread);
+    CloseHandle(shard->wake);
+#else
+    sem_post(&shard->wake);
+    pthread_join(shard->thread, NULL);
+    sem_destroy(&shard->wake);
+#endif
+  }
+  if (sampler->threadcount > 1) {
+#ifdef _WIN32
+    CloseHandle(sampler->done);
+#else
+    sem_destroy(&sampler->done);
+#endif
+  }
+  sampler->started = 0;
+  sampler->shards = NULL;
+}
+
+size_t pm_sampler_bytes(unsigned int threads) {
+  return threads * sizeof(struct pm_sampler_shard);
+}
+
+void pm_sampler_get_count(
+  const struct pm_sampler* sampler,
+  struct pm_sampler_count* count) {
+  *count = sampler->count;
+}
+
+/* Work the own shard first and then steal from the others in turn */
+void pm_sampler_work(struct pm_sampler_shard* shard) {
+  struct pm_sampler* sampler = shard->sampler;
+  struct pm_sampler_shard* victim;
+  unsigned int k;
+  size_t item;
+  shard->sampled = false;
+  while ((item = PM_FETCH_ADD(&shard->next, 1)) < shard->end) {
+    pm_sampler_take(shard, item);
+  }
+  for (k = 1; k < sampler->threadcount; ++k) {
+    victim = &sampler->shards[(shard->worker + k) % sampler->threadcount];
+    while ((item = PM_FETCH_ADD(&victim->next, 1)) < victim->end) {
+      shard->stolen++;
+      pm_sampler_take(shard, item);
+    }
+  }
+}
+
+void pm_sampler_take(struct pm_sampler_shard* shard, size_t item) {
+  if (!shard->sampled) {
+    shard->first = pm_sampler_now();
+    shard->sampled = true;
+  }
+  shard->sampler->sample(shard->sampler->user, item, shard->worker);
+  shard->last = pm_sampler_now();
+}
+
+#ifdef _WIN32
+DWORD WINAPI pm_sampler_thread(LPVOID parameter) {
+#else
+void* pm_sampler_thread(void* parameter) {
+#endif
+  struct pm_sampler_shard* shard = (struct pm_sampler_shard*)(parameter);
+  struct pm_sampler* sampler = shard->sampler;
+  for (;;) {
+#ifdef _WIN32
+    WaitForSingleObject(shard->wake, INFINITE);
+#else
+    while (sem_wait(&shard->wake) != 0 && errno == EINTR) {
+    }
+#endif
+    if (sampler->stopping) {
+      break;
+    }
+    pm_sampler_work(shard);
+#ifdef _WIN32
+    ReleaseSemaphore(sampler->done, 1, NULL);
+#else
+    sem_post(&sampler->done);
+#endif
+  }
+#ifdef _WIN32
+  return 0;
+#else
+  return NULL;
+#endif
+}
+
+/* The first call is made by pm_sampler_start before any thread runs */
+unsigned long long pm_sampler_now() {
+#ifdef _WIN32
+  static LARGE_INTEGER frequency;
+  LARGE_INTEGER counter;
+  if (frequency.QuadPart == 0) {
+    QueryPerformanceFrequency(&frequency);
+  }
+  QueryPerformanceCounter(&counter);
+  return (unsigned long long)(counter.QuadPart / frequency.QuadPart) *
+    1000000000ULL +
+    (unsigned long long)(counter.QuadPart % frequency.QuadPart) *
+    1000000000ULL / (unsigned long long)(frequency.QuadPart);
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return 1000000000ULL * (unsigned long long)(now.tv_sec) +
+    (unsigned long long)(now.tv_nsec);
+#endif
+}
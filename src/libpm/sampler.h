@@ -0,0 +1,64 @@
+#ifndef PM_SAMPLER_H_
+#define PM_SAMPLER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <semaphore.h>
+#endif
+
+#include <pm/pm.h>
+
+#include "arena.h"
+
+#define PM_SAMPLER_MAX_THREADS 256
+
+typedef void (*pm_sampler_sample)(void* user, size_t item, unsigned int worker);
+
+struct pm_sampler_shard;
+
+struct pm_sampler {
+  struct pm_sampler_shard* shards;
+  unsigned int threadcount;
+  unsigned int started;
+  pm_sampler_sample sample;
+  void* user;
+  volatile bool stopping;
+  struct pm_sampler_count count;
+#ifdef _WIN32
+  HANDLE done;
+#else
+  sem_t done;
+#endif
+};
+
+/*
+ * A fixed pool of sampler threads. Every run splits the items of a tick
+ * into one contiguous shard per worker. A worker takes items from the
+ * front of its own shard and steals from the other shards once its own
+ * is done, so a few slow samples do not hold up the whole tick. The
+ * calling thread works the first shard so one thread starts no threads.
+ * The sample callback is given the item and the worker taking it. The
+ * shards are carved from the arena as one part of pm_sampler_bytes.
+ */
+void pm_sampler_reset(struct pm_sampler* sampler);
+ int pm_sampler_start(
+  struct pm_sampler* sampler,
+  unsigned int threads,
+  pm_sampler_sample sample,
+  void* user,
+  struct pm_arena* arena);
+void pm_sampler_run(struct pm_sampler* sampler, size_t count);
+void pm_sampler_stop(struct pm_sampler* sampler);
+
+size_t pm_sampler_bytes(unsigned int threads);
+
+void pm_sampler_get_count(
+  const struct pm_sampler* sampler,
+  struct pm_sampler_count* count);
+
+#endif
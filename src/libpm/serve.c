@@ -0,0 +1,335 @@
+#ifndef _WIN32
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "atomic.h"
+#include "serve.h"
+
+#define PM_SERVE_BACKLOG 16
+#define PM_SERVE_TIMEOUT_MS 1000
+#define PM_SERVE_HEADER_SIZE 256
+#define PM_SERVE_CONTENT_TYPE \
+  "application/openmetrics-text; version=1.0.0; charset=utf-8"
+
+static int pm_serve_listen(struct pm_serve* serve, const char* address);
+static int pm_serve_claim(const struct sockaddr_un* local);
+static void pm_serve_copy(
+  struct pm_serve* serve,
+  struct pm_serve_snapshot* snapshot);
+static void pm_serve_answer(struct pm_serve* serve, int client);
+static int pm_serve_send(int client, const char* data, size_t length);
+static unsigned long long pm_serve_now();
+static void* pm_serve_run(void* parameter);
+
+void pm_serve_reset(struct pm_serve* serve) {
+  memset(serve, 0x00, sizeof(struct pm_serve));
+  serve->fd = -1;
+  serve->wake[0] = -1;
+  serve->wake[1] = -1;
+}
+
+int pm_serve_start(
+  struct pm_serve* serve,
+  const char* address,
+  size_t columns,
+  size_t size,
+  pm_serve_render render,
+  void* user,
+  struct pm_arena* arena) {
+  serve->columns = columns;
+  serve->size = size;
+  serve->render = render;
+  serve->user = user;
+  serve->values = (unsigned long long*)(
+    pm_arena_alloc(arena, pm_serve_bytes(columns, size)));
+  if (serve->values == NULL) {
+    pm_serve_stop(serve);
+    return EXIT_FAILURE;
+  }
+  memset(serve->values, 0x00, pm_serve_bytes(columns, size));
+  serve->copy = serve->values + columns;
+  serve->buffer = (char*)(serve->values + 2 * columns + 1);
+  if (pm_serve_listen(serve, address) != EXIT_SUCCESS ||
+    pipe(serve->wake) != 0 ||
+    pthread_create(&serve->thread, NULL, pm_serve_run, serve) != 0) {
+    pm_serve_stop(serve);
+    return EXIT_FAILURE;
+  }
+  serve->running = true;
+  return EXIT_SUCCESS;
+}
+
+/* Called on the sampling thread for every tick */
+void pm_serve_publish(
+  struct pm_serve* serve,
+  long long time,
+  unsigned long long elapsed,
+  const unsigned long long* values,
+  long long count) {
+  size_t sequence = serve->sequence;
+  PM_STORE_RELEASE(&serve->sequence, sequence + 1);
+  PM_FENCE_RELEASE();
+  serve->time = time;
+  serve->elapsed = elapsed;
+  serve->count = count;
+  memcpy(serve->values, values, serve->columns * sizeof(unsigned long long));
+  PM_STORE_RELEASE(&serve->sequence, sequence + 2);
+}
+
+void pm_serve_stop(struct pm_serve* serve) {
+  if (serve->running) {
+    if (write(serve->wake[1], "", 1) != 1) {
+      fprintf(stderr, "Failed to wake the serving thread\n");
+    }
+    pthread_join(serve->thread, NULL);
+    serve->running = false;
+  }
+  if (serve->fd >= 0) {
+    close(serve->fd);
+    serve->fd = -1;
+  }
+  if (serve->path[0] != '\0') {
+    unlink(serve->path);
+    serve->path[0] = '\0';
+  }
+  if (serve->wake[0] >= 0) {
+    close(serve->wake[0]);
+    close(serve->wake[1]);
+    serve->wake[0] = -1;
+    serve->wake[1] = -1;
+  }
+  serve->values = NULL;
+  serve->copy = NULL;
+  serve->buffer = NULL;
+}
+
+size_t pm_serve_bytes(size_t columns, size_t size) {
+  return (2 * columns + 1) * sizeof(unsigned long long) + size;
+}
+
+/* Only the loopback is served over TCP; other hosts are refused */
+int pm_serve_listen(struct pm_serve* serve, const char* address) {
+  struct sockaddr_un local;
+  struct sockaddr_in inet;
+  const char* port = strrchr(address, ':');
+  char host[INET_ADDRSTRLEN];
+  char* end;
+  unsigned long number;
+  int one = 1;
+  if (strncmp(address, "unix:", 5) == 0) {
+    memset(&local, 0x00, sizeof(local));
+    local.sun_family = AF_UNIX;
+    if (strlen(address + 5) == 0 ||
+      strlen(address + 5) >= sizeof(local.sun_path) ||
+      (serve->fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+      return EXIT_FAILURE;
+    }
+    memcpy(local.sun_path, address + 5, strlen(address + 5) + 1);
+    if (pm_serve_claim(&local) != EXIT_SUCCESS ||
+      bind(serve->fd, (struct sockaddr*)(&local), sizeof(local)) != 0) {
+      return EXIT_FAILURE;
+    }
+    memcpy(serve->path, local.sun_path, strlen(local.sun_path) + 1);
+  } else {
+    memset(&inet, 0x00, sizeof(inet));
+    inet.sin_family = AF_INET;
+    inet.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (port != NULL) {
+      if ((size_t)(port - address) >= sizeof(host)) {
+        return EXIT_FAILURE;
+      }
+      memcpy(host, address, (size_t)(port - address));
+      host[port - address] = '\0';
+      if (strcmp(host, "localhost") != 0 &&
+        (inet_pton(AF_INET, host, &inet.sin_addr) != 1 ||
+          (ntohl(inet.sin_addr.s_addr) >> 24) != 127)) {
+        return EXIT_FAILURE;
+      }
+      ++port;
+    } else {
+      port = address;
+    }
+    number = strtoul(port, &end, 10);
+    if (end == port || *end != '\0' || number == 0 || number > 65535) {
+      return EXIT_FAILURE;
+    }
+    inet.sin_port = htons((unsigned short)(number));
+    if ((serve->fd = socket(AF_INET, SOCK_STREAM, 0)) < 0 ||
+      setsockopt(serve->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+      bind(serve->fd, (struct sockaddr*)(&inet), sizeof(inet)) != 0) {
+      return EXIT_FAILURE;
+    }
+  }
+  return listen(serve->fd, PM_SERVE_BACKLOG) == 0 ?
+    EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * The path is free, or held by the socket of a monitor that exited without
+ * removing it, which nothing answers on. Anything else is left alone.
+ */
+int pm_serve_claim(const struct sockaddr_un* local) {
+  struct stat status;
+  int fd, refused;
+  if (lstat(local->sun_path, &status) != 0) {
+    return errno == ENOENT ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  if (!S_ISSOCK(status.st_mode)) {
+    fprintf(
+      stderr,
+      "The listen path '%s' exists and is not a socket\n",
+      local->sun_path);
+    return EXIT_FAILURE;
+  }
+  if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+    return EXIT_FAILURE;
+  }
+  refused =
+    connect(fd, (const struct sockaddr*)(local), sizeof(*local)) != 0 &&
+    errno == ECONNREFUSED;
+  close(fd);
+  if (!refused) {
+    fprintf(
+      stderr,
+      "The listen path '%s' is in use by a running server\n",
+      local->sun_path);
+    return EXIT_FAILURE;
+  }
+  return unlink(local->sun_path) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* A copy is only kept when the sequence was even and did not move */
+void pm_serve_copy(
+  struct pm_serve* serve,
+  struct pm_serve_snapshot* snapshot) {
+  size_t before, after;
+  for (;;) {
+    before = PM_LOAD_ACQUIRE(&serve->sequence);
+    if ((before & 1) == 0) {
+      snapshot->time = serve->time;
+      snapshot->elapsed = serve->elapsed;
+      snapshot->count = serve->count;
+      memcpy(
+        serve->copy,
+        serve->values,
+        serve->columns * sizeof(unsigned long long));
+      PM_FENCE_ACQUIRE();
+      after = PM_LOAD_ACQUIRE(&serve->sequence);
+      if (before == after) {
+        break;
+      }
+    }
+    ++serve->retries;
+  }
+  snapshot->values = serve->copy;
+  snapshot->columns = serve->columns;
+}
+
+/*
+ * Any request gets the metrics; the request itself is only read so the
+ * client sees a complete exchange. Reads and writes time out so a client
+ * that stalls is dropped.
+ */
+void pm_serve_answer(struct pm_serve* serve, int client) {
+  char request[PM_SERVE_REQUEST_SIZE];
+  char header[PM_SERVE_HEADER_SIZE];
+  struct pm_serve_snapshot snapshot;
+  struct timeval timeout;
+  unsigned long long start;
+  size_t length = 0, body;
+  ssize_t got;
+  int headerlength;
+  timeout.tv_sec = PM_SERVE_TIMEOUT_MS / 1000;
+  timeout.tv_usec = (PM_SERVE_TIMEOUT_MS % 1000) * 1000;
+  setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  while (length < sizeof(request) - 1 &&
+    (got = recv(client, request + length, sizeof(request) - 1 - length, 0)) >
+    0) {
+    length += (size_t)(got);
+    request[length] = '\0';
+    if (strstr(request, "\r\n\r\n") != NULL || strstr(request, "\n\n") != NULL) {
+      break;
+    }
+  }
+
+  start = pm_serve_now();
+  ++serve->scrapes;
+  pm_serve_copy(serve, &snapshot);
+  body = serve->render(&snapshot, serve->buffer, serve->size, serve->user);
+  serve->renderns += pm_serve_now() - start;
+
+  headerlength = snprintf(
+    header,
+    sizeof(header),
+    "HTTP/1.0 200 OK\r\nContent-Type: " PM_SERVE_CONTENT_TYPE "\r\n"
+    "Content-Length: %lu\r\nConnection: close\r\n\r\n",
+    (unsigned long)(body));
+  if (headerlength > 0 &&
+    pm_serve_send(client, header, (size_t)(headerlength)) == EXIT_SUCCESS) {
+    pm_serve_send(client, serve->buffer, body);
+  }
+}
+
+int pm_serve_send(int client, const char* data, size_t length) {
+  ssize_t sent;
+  while (length > 0) {
+    sent = send(client, data, length, MSG_NOSIGNAL);
+    if (sent <= 0) {
+      return EXIT_FAILURE;
+    }
+    data += sent;
+    length -= (size_t)(sent);
+  }
+  return EXIT_SUCCESS;
+}
+
+unsigned long long pm_serve_now() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return 1000000000ULL * (unsigned long long)(now.tv_sec) +
+    (unsigned long long)(now.tv_nsec);
+}
+
+/* One client at a time until woken through the pipe to stop */
+void* pm_serve_run(void* parameter) {
+  struct pm_serve* serve = (struct pm_serve*)(parameter);
+  struct pollfd polled[2];
+  int client;
+  polled[0].fd = serve->fd;
+  polled[0].events = POLLIN;
+  polled[1].fd = serve->wake[0];
+  polled[1].events = POLLIN;
+  for (;;) {
+    if (poll(polled, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    if (polled[1].revents != 0) {
+      break;
+    }
+    if ((polled[0].revents & POLLIN) != 0 &&
+      (client = accept(serve->fd, NULL, NULL)) >= 0) {
+      pm_serve_answer(serve, client);
+      close(client);
+    }
+  }
+  return NULL;
+}
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef PM_SERVE_H_
+#define PM_SERVE_H_
+
+#ifndef _WIN32
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <pthread.h>
+
+#include "arena.h"
+
+#define PM_SERVE_REQUEST_SIZE 4096
+#define PM_SERVE_PATH_SIZE 108
+
+/* The last published row as the serving thread copied it */
+struct pm_serve_snapshot {
+  long long time;
+  unsigned long long elapsed;
+  long long count;
+  const unsigned long long* values;
+  size_t columns;
+};
+
+/* Write the response body for a snapshot and return its length */
+typedef size_t (*pm_serve_render)(
+  const struct pm_serve_snapshot* snapshot,
+  char* buffer,
+  size_t size,
+  void* user);
+
+/*
+ * The latest row is published under a seqlock. The sampler bumps the
+ * sequence to odd, copies the row and bumps it to even, and never waits.
+ * The serving thread copies the row and retries when the sequence was odd
+ * or moved meanwhile, then renders from its own copy, so a slow scraper
+ * only ever holds up the serving thread.
+ */
+struct pm_serve {
+  size_t sequence;
+  long long time;
+  unsigned long long elapsed;
+  long long count;
+  unsigned long long* values;
+  unsigned long long* copy;
+  size_t columns;
+  char* buffer;
+  size_t size;
+  pm_serve_render render;
+  void* user;
+  int fd;
+  int wake[2];
+  char path[PM_SERVE_PATH_SIZE];
+  bool running;
+  pthread_t thread;
+  unsigned long long scrapes;
+  unsigned long long retries;
+  unsigned long long renderns;
+};
+
+void pm_serve_reset(struct pm_serve* serve);
+
+/*
+ * Listen on unix:/path or on [127.0.0.1:]port of the loopback and start
+ * the serving thread. The buffer takes size bytes of response body. The
+ * row copies and the buffer are carved as one part of pm_serve_bytes.
+ */
+int pm_serve_start(
+  struct pm_serve* serve,
+  const char* address,
+  size_t columns,
+  size_t size,
+  pm_serve_render render,
+  void* user,
+  struct pm_arena* arena);
+void pm_serve_publish(
+  struct pm_serve* serve,
+  long long time,
+  unsigned long long elapsed,
+  const unsigned long long* values,
+  long long count);
+void pm_serve_stop(struct pm_serve* serve);
+
+size_t pm_serve_bytes(size_t columns, size_t size);
+
+#endif
+
+#endif
@@ -0,0 +1,280 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <pm/share.h>
+
+#include "atomic.h"
+
+#define PM_SHARE_RETRIES 1024
+#define PM_SHARE_ALIGN(x) (((x) + 63) & ~(size_t)(63))
+
+#ifndef _WIN32
+static int pm_share_name(struct pm_share* share, const char* name);
+static int pm_share_map(struct pm_share* share);
+static bool pm_share_stale(struct pm_share* share);
+#endif
+
+void pm_share_reset(struct pm_share* share) {
+  memset(share, 0x00, sizeof(struct pm_share));
+}
+
+int pm_share_create(
+  struct pm_share* share,
+  const char* name,
+  const struct pm_share_layout* layout) {
+#ifdef _WIN32
+  (void)(share);
+  (void)(name);
+  (void)(layout);
+  fprintf(stderr, "Sharing the view is not supported on Windows\n");
+  return EXIT_FAILURE;
+#else
+  struct pm_share_header header;
+  int fd, attempt;
+  if (pm_share_name(share, name) != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+  memset(&header, 0x00, sizeof(header));
+  header.magic = PM_SHARE_MAGIC;
+  header.version = PM_SHARE_VERSION;
+  header.pid = (long long)(getpid());
+  header.layout = *layout;
+  header.nameoffset = PM_SHARE_ALIGN(sizeof(struct pm_share_header));
+  header.typeoffset = PM_SHARE_ALIGN(
+    header.nameoffset + layout->targets * PM_SHARE_NAME_SIZE);
+  header.valueoffset = PM_SHARE_ALIGN(
+    header.typeoffset + layout->types * PM_SHARE_TYPE_SIZE);
+  header.size =
+    header.valueoffset + layout->columns * sizeof(unsigned long long);
+
+  for (attempt = 0;; ++attempt) {
+    if ((fd = shm_open(share->name, O_CREAT | O_EXCL | O_RDWR, 0644)) >= 0) {
+      break;
+    }
+    if (errno != EEXIST || attempt > 0) {
+      return EXIT_FAILURE;
+    }
+    if (!pm_share_stale(share)) {
+      fprintf(
+        stderr,
+        "The shared view name '%s' is in use by a running monitor\n",
+        share->name);
+      return EXIT_FAILURE;
+    }
+    shm_unlink(share->name);
+  }
+  share->size = header.size;
+  share->header = ftruncate(fd, (off_t)(header.size)) != 0 ?
+    (struct pm_share_header*)(MAP_FAILED) :
+    (struct pm_share_header*)(mmap(
+      NULL, share->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+  close(fd);
+  if (share->header == (struct pm_share_header*)(MAP_FAILED)) {
+    share->header = NULL;
+    shm_unlink(share->name);
+    return EXIT_FAILURE;
+  }
+  share->owner = true;
+  memcpy(share->header, &header, sizeof(header));
+  share->names = (char*)(share->header) + header.nameoffset;
+  share->types = (char*)(share->header) + header.typeoffset;
+  share->values =
+    (unsigned long long*)((char*)(share->header) + header.valueoffset);
+  return EXIT_SUCCESS;
+#endif
+}
+
+char* pm_share_target(struct pm_share* share, size_t target) {
+  return share->names + target * PM_SHARE_NAME_SIZE;
+}
+
+char* pm_share_type(struct pm_share* share, size_t type) {
+  return share->types + type * PM_SHARE_TYPE_SIZE;
+}
+
+/* Called on the sampling thread for every tick */
+void pm_share_publish(
+  struct pm_share* share,
+  long long time,
+  unsigned long long elapsed,
+  unsigned long long tick,
+  const unsigned long long* values,
+  long long count) {
+  struct pm_share_header* header = share->header;
+  size_t sequence = header->sequence;
+  PM_STORE_RELEASE(&header->sequence, sequence + 1);
+  PM_FENCE_RELEASE();
+  header->time = time;
+  header->elapsed = elapsed;
+  header->tick = tick;
+  header->count = count;
+  memcpy(
+    share->values,
+    values,
+    header->layout.columns * sizeof(unsigned long long));
+  PM_STORE_RELEASE(&header->sequence, sequence + 2);
+}
+
+void pm_share_destroy(struct pm_share* share) {
+#ifndef _WIN32
+  if (share->header != NULL && share->owner) {
+    PM_STORE_RELEASE(&share->header->stopped, (size_t)(1));
+    munmap(share->header, share->size);
+    shm_unlink(share->name);
+    share->header = NULL;
+    share->owner = false;
+  }
+#endif
+}
+
+int pm_share_attach(struct pm_share* share, const char* name) {
+#ifdef _WIN32
+  (void)(share);
+  (void)(name);
+  fprintf(stderr, "Attaching to a view is not supported on Windows\n");
+  return EXIT_FAILURE;
+#else
+  if (pm_share_name(share, name) != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+  return pm_share_map(share);
+#endif
+}
+
+const struct pm_share_layout* pm_share_get_layout(
+  const struct pm_share* share) {
+  return &share->header->layout;
+}
+
+const char* pm_share_get_target(const struct pm_share* share, size_t target) {
+  return share->names + target * PM_SHARE_NAME_SIZE;
+}
+
+const char* pm_share_get_type(const struct pm_share* share, size_t type) {
+  return share->types + type * PM_SHARE_TYPE_SIZE;
+}
+
+/* A copy is only kept when the sequence was even and did not move */
+int pm_share_read(
+  struct pm_share* share,
+  struct pm_share_row* row,
+  unsigned long long* values) {
+  const struct pm_share_header* header = share->header;
+  size_t before, after;
+  int retry;
+  for (retry = 0; retry < PM_SHARE_RETRIES; ++retry) {
+    before = PM_LOAD_ACQUIRE(&header->sequence);
+    if ((before & 1) == 0) {
+      row->time = header->time;
+      row->elapsed = header->elapsed;
+      row->tick = header->tick;
+      row->count = header->count;
+      memcpy(
+        values,
+        share->values,
+        header->layout.columns * sizeof(unsigned long long));
+      PM_FENCE_ACQUIRE();
+      after = PM_LOAD_ACQUIRE(&header->sequence);
+      if (before == after) {
+        row->sequence = before;
+        row->stopped = PM_LOAD_ACQUIRE(&header->stopped) != 0;
+        return EXIT_SUCCESS;
+      }
+    }
+    ++share->retries;
+  }
+  return EXIT_FAILURE;
+}
+
+void pm_share_detach(struct pm_share* share) {
+#ifndef _WIN32
+  if (share->header != NULL && !share->owner) {
+    munmap(share->header, share->size);
+    share->header = NULL;
+  }
+#endif
+}
+
+#ifndef _WIN32
+/* The name is taken with or without the leading slash shm_open wants */
+int pm_share_name(struct pm_share* share, const char* name) {
+  const char* start = name[0] == '/' ? name + 1 : name;
+  size_t length = strlen(start);
+  if (length == 0 || length + 2 > PM_SHARE_NAME_SIZE ||
+    strchr(start, '/') != NULL) {
+    fprintf(stderr, "The shared view name '%s' is not valid\n", name);
+    return EXIT_FAILURE;
+  }
+  share->name[0] = '/';
+  memcpy(share->name + 1, start, length + 1);
+  return EXIT_SUCCESS;
+}
+
+/* The size is checked against the layout before anything past it is read */
+int pm_share_map(struct pm_share* share) {
+  struct pm_share_header* header;
+  struct stat status;
+  size_t columns;
+  int fd;
+  if ((fd = shm_open(share->name, O_RDONLY, 0)) < 0) {
+    return EXIT_FAILURE;
+  }
+  if (fstat(fd, &status) != 0 ||
+    (size_t)(status.st_size) < sizeof(struct pm_share_header)) {
+    close(fd);
+    return EXIT_FAILURE;
+  }
+  share->size = (size_t)(status.st_size);
+  header = (struct pm_share_header*)(mmap(
+    NULL, share->size, PROT_READ, MAP_SHARED, fd, 0));
+  close(fd);
+  if (header == (struct pm_share_header*)(MAP_FAILED)) {
+    return EXIT_FAILURE;
+  }
+  columns = header->layout.columns;
+  if (header->magic != PM_SHARE_MAGIC ||
+    header->version != PM_SHARE_VERSION ||
+    header->size != share->size ||
+    header->valueoffset + columns * sizeof(unsigned long long) > share->size ||
+    header->nameoffset +
+      header->layout.targets * PM_SHARE_NAME_SIZE > header->typeoffset ||
+    header->typeoffset +
+      header->layout.types * PM_SHARE_TYPE_SIZE > header->valueoffset) {
+    munmap(header, share->size);
+    return EXIT_FAILURE;
+  }
+  share->header = header;
+  share->owner = false;
+  share->names = (char*)(header) + header->nameoffset;
+  share->types = (char*)(header) + header->typeoffset;
+  share->values =
+    (unsigned long long*)((char*)(header) + header->valueoffset);
+  return EXIT_SUCCESS;
+}
+
+/*
+ * A segment of ours whose monitor stopped or no longer exists. Anything
+ * else under the name, also a segment still being created, is in use.
+ */
+bool pm_share_stale(struct pm_share* share) {
+  bool stale;
+  if (pm_share_map(share) != EXIT_SUCCESS) {
+    return false;
+  }
+  stale = PM_LOAD_ACQUIRE(&share->header->stopped) != 0 ||
+    (share->header->pid > 0 &&
+      kill((pid_t)(share->header->pid), 0) != 0 && errno == ESRCH);
+  pm_share_detach(share);
+  return stale;
+}
+#endif
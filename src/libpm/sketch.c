@@ -0,0 +1,215 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <pm/sketch.h>
+
+static int pm_sketch_key(unsigned long long value);
+static void pm_sketch_add_key(
+  struct pm_sketch* sketch,
+  int key,
+  unsigned int count);
+static void pm_sketch_shift(struct pm_sketch* sketch, int offset);
+static int pm_sketch_top(const struct pm_sketch* sketch);
+
+void pm_sketch_reset(struct pm_sketch* sketch) {
+  memset(sketch, 0x00, sizeof(struct pm_sketch));
+  sketch->min = ~0ULL;
+  sketch->offset = -1;
+}
+
+void pm_sketch_add(struct pm_sketch* sketch, unsigned long long value) {
+  ++sketch->count;
+  sketch->sum += value;
+  if (value < sketch->min) {
+    sketch->min = value;
+  }
+  if (value > sketch->max) {
+    sketch->max = value;
+  }
+  if (value == 0) {
+    ++sketch->zeros;
+  } else {
+    pm_sketch_add_key(sketch, pm_sketch_key(value), 1);
+  }
+}
+
+void pm_sketch_merge(struct pm_sketch* sketch, const struct pm_sketch* other) {
+  int k;
+  if (other->count == 0) {
+    return;
+  }
+  sketch->count += other->count;
+  sketch->zeros += other->zeros;
+  sketch->sum += other->sum;
+  if (other->min < sketch->min) {
+    sketch->min = other->min;
+  }
+  if (other->max > sketch->max) {
+    sketch->max = other->max;
+  }
+  for (k = PM_SKETCH_BINS - 1; k >= 0; --k) {
+    if (other->bins[k] > 0) {
+      pm_sketch_add_key(sketch, other->offset + k, other->bins[k]);
+    }
+  }
+}
+
+/* The estimate is the middle of the bin, clamped to the values seen */
+unsigned long long pm_sketch_quantile(
+  const struct pm_sketch* sketch,
+  double quantile) {
+  const double gamma = (1.0 + PM_SKETCH_ALPHA) / (1.0 - PM_SKETCH_ALPHA);
+  unsigned long long rank, seen;
+  double estimate;
+  int k;
+  if (sketch->count == 0) {
+    return 0;
+  }
+  rank = (unsigned long long)(quantile * (double)(sketch->count - 1));
+  if (rank < sketch->zeros) {
+    return 0;
+  }
+  seen = sketch->zeros;
+  for (k = 0; k < PM_SKETCH_BINS - 1; ++k) {
+    seen += sketch->bins[k];
+    if (seen > rank) {
+      break;
+    }
+  }
+  estimate = 2.0 * pow(gamma, sketch->offset + k) / (gamma + 1.0);
+  if (estimate <= (double)(sketch->min)) {
+    return sketch->min;
+  }
+  if (estimate >= (double)(sketch->max)) {
+    return sketch->max;
+  }
+  return (unsigned long long)(estimate + 0.5);
+}
+
+int pm_sketch_format(const struct pm_sketch* sketch, char* text, size_t size) {
+  int written, top, k;
+  size_t used;
+  written = snprintf(
+    text,
+    size,
+    "%llu %llu %llu %llu %llu %d",
+    sketch->count,
+    sketch->count > 0 ? sketch->min : 0ULL,
+    sketch->max,
+    sketch->sum,
+    sketch->zeros,
+    sketch->offset);
+  if (written < 0 || (size_t)(written) >= size) {
+    return EXIT_FAILURE;
+  }
+  used = (size_t)(written);
+  top = pm_sketch_top(sketch);
+  for (k = 0; k <= top; ++k) {
+    written = snprintf(text + used, size - used, " %u", sketch->bins[k]);
+    if (written < 0 || (size_t)(written) >= size - used) {
+      return EXIT_FAILURE;
+    }
+    used += (size_t)(written);
+  }
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Parsing stops at the first character that is not part of the sketch. A
+ * sketch whose bins do not hold the values that are not zero, or that has
+ * bins without an offset, is refused.
+ */
+int pm_sketch_parse(struct pm_sketch* sketch, const char* text) {
+  unsigned long long field[5], binned = 0;
+  char* end;
+  long offset;
+  int k;
+  pm_sketch_reset(sketch);
+  for (k = 0; k < 5; ++k) {
+    field[k] = strtoull(text, &end, 10);
+    if (end == text) {
+      return EXIT_FAILURE;
+    }
+    text = end;
+  }
+  offset = strtol(text, &end, 10);
+  if (end == text || offset < -1 || field[4] > field[0]) {
+    return EXIT_FAILURE;
+  }
+  text = end;
+  sketch->count = field[0];
+  sketch->min = field[0] > 0 ? field[1] : ~0ULL;
+  sketch->max = field[2];
+  sketch->sum = field[3];
+  sketch->zeros = field[4];
+  sketch->offset = (int)(offset);
+  for (k = 0; k < PM_SKETCH_BINS && *text == ' '; ++k) {
+    sketch->bins[k] = (unsigned int)(strtoul(text, &end, 10));
+    if (end == text) {
+      return EXIT_FAILURE;
+    }
+    binned += sketch->bins[k];
+    text = end;
+  }
+  if ((offset < 0 && k > 0) || binned != field[0] - field[4]) {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int pm_sketch_key(unsigned long long value) {
+  const double gamma = (1.0 + PM_SKETCH_ALPHA) / (1.0 - PM_SKETCH_ALPHA);
+  return (int)(ceil(log((double)(value)) / log(gamma)));
+}
+
+/*
+ * Slide the kept keys up to make room for a higher key, collapsing the
+ * lowest bins, or down for a lower key while the highest used key still
+ * fits. A key below what fits is counted in the first bin.
+ */
+void pm_sketch_add_key(struct pm_sketch* sketch, int key, unsigned int count) {
+  int top;
+  if (sketch->offset < 0) {
+    sketch->offset = key;
+  }
+  if (key >= sketch->offset + PM_SKETCH_BINS) {
+    pm_sketch_shift(sketch, key - PM_SKETCH_BINS + 1);
+  } else if (key < sketch->offset) {
+    top = pm_sketch_top(sketch);
+    if (top < 0 || sketch->offset + top - key < PM_SKETCH_BINS) {
+      pm_sketch_shift(sketch, key);
+    } else {
+      pm_sketch_shift(sketch, sketch->offset + top - PM_SKETCH_BINS + 1);
+    }
+  }
+  sketch->bins[key > sketch->offset ? key - sketch->offset : 0] += count;
+}
+
+void pm_sketch_shift(struct pm_sketch* sketch, int offset) {
+  unsigned int bins[PM_SKETCH_BINS];
+  int k, position;
+  if (offset < 0) {
+    offset = 0;
+  }
+  memset(bins, 0x00, sizeof(bins));
+  for (k = 0; k < PM_SKETCH_BINS; ++k) {
+    if (sketch->bins[k] > 0) {
+      position = sketch->offset + k - offset;
+      bins[position > 0 ? position : 0] += sketch->bins[k];
+    }
+  }
+  memcpy(sketch->bins, bins, sizeof(bins));
+  sketch->offset = offset;
+}
+
+int pm_sketch_top(const struct pm_sketch* sketch) {
+  int k;
+  for (k = PM_SKETCH_BINS - 1; k >= 0; --k) {
+    if (sketch->bins[k] > 0) {
+      break;
+    }
+  }
+  return k;
+}
@@ -0,0 +1,114 @@
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "stats.h"
+
+const char* pm_stats_phase_name[PM_PHASE_COUNT] = {
+  "enumerate",
+  "resolve",
+  "read",
+  "merge",
+  "rules",
+  "deliver",
+  "tick",
+  "format",
+  "flush"
+};
+
+static size_t pm_stats_bucket(unsigned long long ns);
+static unsigned long long pm_stats_upper(size_t bucket);
+
+void pm_stats_reset(struct pm_stats_histogram* histogram) {
+  memset(histogram, 0x00, sizeof(struct pm_stats_histogram));
+}
+
+void pm_stats_add(struct pm_stats_histogram* histogram, unsigned long long ns) {
+  if (histogram->count == 0 || ns < histogram->min) {
+    histogram->min = ns;
+  }
+  if (ns > histogram->max) {
+    histogram->max = ns;
+  }
+  ++histogram->count;
+  histogram->sum += ns;
+  ++histogram->bucket[pm_stats_bucket(ns)];
+}
+
+/* The upper bound of the bucket holding the quantile, at most the maximum */
+unsigned long long pm_stats_quantile(
+  const struct pm_stats_histogram* histogram,
+  double q) {
+  unsigned long long rank, seen = 0, upper;
+  size_t b;
+  if (histogram->count == 0) {
+    return 0;
+  }
+  rank = (unsigned long long)(q * (double)(histogram->count - 1)) + 1;
+  for (b = 0; b < PM_STATS_BUCKETS; ++b) {
+    seen += histogram->bucket[b];
+    if (seen >= rank) {
+      upper = pm_stats_upper(b);
+      return upper < histogram->max ? upper : histogram->max;
+    }
+  }
+  return histogram->max;
+}
+
+/* The first call is made during init before any other thread runs */
+unsigned long long pm_stats_now() {
+#ifdef _WIN32
+  static LARGE_INTEGER frequency;
+  LARGE_INTEGER counter;
+  if (frequency.QuadPart == 0) {
+    QueryPerformanceFrequency(&frequency);
+  }
+  QueryPerformanceCounter(&counter);
+  return (unsigned long long)(counter.QuadPart / frequency.QuadPart) *
+    1000000000ULL +
+    (unsigned long long)(counter.QuadPart % frequency.QuadPart) *
+    1000000000ULL / (unsigned long long)(frequency.QuadPart);
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return 1000000000ULL * (unsigned long long)(now.tv_sec) +
+    (unsigned long long)(now.tv_nsec);
+#endif
+}
+
+/*
+ * Values below four have a bucket each. Above that the bucket is picked
+ * by the bit length and the two bits following the leading one.
+ */
+size_t pm_stats_bucket(unsigned long long ns) {
+  size_t bits = 0;
+  unsigned long long v = ns;
+  if (ns < PM_STATS_SUBBUCKETS) {
+    return (size_t)(ns);
+  }
+  while (v != 0) {
+    ++bits;
+    v >>= 1;
+  }
+  return PM_STATS_SUBBUCKETS * (bits - PM_STATS_SUBBUCKET_BITS) +
+    (size_t)((ns >> (bits - PM_STATS_SUBBUCKET_BITS - 1)) &
+      (PM_STATS_SUBBUCKETS - 1));
+}
+
+unsigned long long pm_stats_upper(size_t bucket) {
+  size_t bits;
+  unsigned long long leading;
+  if (bucket < PM_STATS_SUBBUCKETS) {
+    return (unsigned long long)(bucket);
+  }
+  bits = bucket / PM_STATS_SUBBUCKETS + PM_STATS_SUBBUCKET_BITS;
+  leading = PM_STATS_SUBBUCKETS + bucket % PM_STATS_SUBBUCKETS;
+  if (bits == 64 && leading == 2 * PM_STATS_SUBBUCKETS - 1) {
+    return ~0ULL;
+  }
+  return ((leading + 1) << (bits - PM_STATS_SUBBUCKET_BITS - 1)) - 1;
+}
@@ -0,0 +1,45 @@
+#ifndef PM_STATS_H_
+#define PM_STATS_H_
+
+#include <stddef.h>
+
+#define PM_PHASE_ENUMERATE 0
+#define PM_PHASE_RESOLVE 1
+#define PM_PHASE_READ 2
+#define PM_PHASE_MERGE 3
+#define PM_PHASE_RULES 4
+#define PM_PHASE_DELIVER 5
+#define PM_PHASE_TICK 6
+#define PM_PHASE_FORMAT 7
+#define PM_PHASE_FLUSH 8
+#define PM_PHASE_COUNT 9
+
+#define PM_STATS_SUBBUCKET_BITS 2
+#define PM_STATS_SUBBUCKETS (1 << PM_STATS_SUBBUCKET_BITS)
+#define PM_STATS_BUCKETS (64 * PM_STATS_SUBBUCKETS)
+
+/*
+ * A latency histogram in ns. Each power of two is split in four buckets,
+ * so a quantile is within 25% of the recorded values and the histogram
+ * takes the same memory however many values it holds. One thread adds to
+ * a histogram; it is read once that thread is done.
+ */
+struct pm_stats_histogram {
+  unsigned long long count;
+  unsigned long long sum;
+  unsigned long long min;
+  unsigned long long max;
+  unsigned long long bucket[PM_STATS_BUCKETS];
+};
+
+extern const char* pm_stats_phase_name[PM_PHASE_COUNT];
+
+void pm_stats_reset(struct pm_stats_histogram* histogram);
+void pm_stats_add(struct pm_stats_histogram* histogram, unsigned long long ns);
+unsigned long long pm_stats_quantile(
+  const struct pm_stats_histogram* histogram,
+  double q);
+
+unsigned long long pm_stats_now();
+
+#endif
@@ -0,0 +1,138 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "store.h"
+
+static size_t pm_store_slot(const struct pm_store* store, size_t position);
+static size_t pm_store_first(
+  const struct pm_store* store,
+  unsigned long long from);
+static void pm_store_scan(
+  const unsigned long long* values,
+  size_t count,
+  struct pm_window* result,
+  unsigned long long* sum);
+
+void pm_store_reset(struct pm_store* store) {
+  memset(store, 0x00, sizeof(struct pm_store));
+}
+
+/* The rows are carved from the arena as one part of pm_store_bytes */
+int pm_store_create(
+  struct pm_store* store,
+  size_t columns,
+  size_t capacity,
+  struct pm_arena* arena) {
+  pm_store_reset(store);
+  store->elapsed = (unsigned long long*)(
+    pm_arena_alloc(arena, pm_store_bytes(columns, capacity)));
+  if (store->elapsed == NULL) {
+    return EXIT_FAILURE;
+  }
+  store->values = store->elapsed + capacity;
+  store->columns = columns;
+  store->capacity = capacity;
+  return EXIT_SUCCESS;
+}
+
+void pm_store_destroy(struct pm_store* store) {
+  pm_store_reset(store);
+}
+
+size_t pm_store_bytes(size_t columns, size_t capacity) {
+  return (columns + 1) * capacity * sizeof(unsigned long long);
+}
+
+/* The oldest row is overwritten once the ring is full */
+void pm_store_append(
+  struct pm_store* store,
+  unsigned long long elapsed,
+  const unsigned long long* values) {
+  unsigned long long* column = store->values + store->head;
+  size_t c;
+  store->elapsed[store->head] = elapsed;
+  for (c = 0; c < store->columns; ++c) {
+    *column = values[c];
+    column += store->capacity;
+  }
+  if (++store->head == store->capacity) {
+    store->head = 0;
+  }
+  if (store->count < store->capacity) {
+    ++store->count;
+  }
+}
+
+/*
+ * Summarize one column over the rows sampled within window ms of the
+ * newest row, or over every row kept when window is zero.
+ */
+int pm_store_window(
+  const struct pm_store* store,
+  size_t column,
+  unsigned long long window,
+  struct pm_window* result) {
+  const unsigned long long* values;
+  unsigned long long newest, sum = 0;
+  size_t first, begin, end;
+  memset(result, 0x00, sizeof(struct pm_window));
+  if (column >= store->columns || store->count == 0) {
+    return EXIT_FAILURE;
+  }
+  newest = store->elapsed[pm_store_slot(store, store->count - 1)];
+  first = window > 0 && window <= newest ?
+    pm_store_first(store, newest - window) : 0;
+  begin = pm_store_slot(store, first);
+  end = pm_store_slot(store, store->count - 1) + 1;
+  values = store->values + column * store->capacity;
+  result->from = store->elapsed[begin];
+  result->to = newest;
+  result->min = ~0ULL;
+  if (begin < end) {
+    pm_store_scan(values + begin, end - begin, result, &sum);
+  } else {
+    pm_store_scan(values + begin, store->capacity - begin, result, &sum);
+    pm_store_scan(values, end, result, &sum);
+  }
+  result->last = values[end - 1];
+  result->mean = (double)(sum) / (double)(result->count);
+  return EXIT_SUCCESS;
+}
+
+/* The slot of a position counted from the oldest row */
+size_t pm_store_slot(const struct pm_store* store, size_t position) {
+  size_t slot = store->head + store->capacity - store->count + position;
+  return slot >= store->capacity ? slot - store->capacity : slot;
+}
+
+/* The position of the oldest row sampled at or after from */
+size_t pm_store_first(const struct pm_store* store, unsigned long long from) {
+  size_t low = 0, high = store->count - 1, middle;
+  while (low < high) {
+    middle = low + (high - low) / 2;
+    if (store->elapsed[pm_store_slot(store, middle)] < from) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+void pm_store_scan(
+  const unsigned long long* values,
+  size_t count,
+  struct pm_window* result,
+  unsigned long long* sum) {
+  size_t k;
+  for (k = 0; k < count; ++k) {
+    if (values[k] < result->min) {
+      result->min = values[k];
+    }
+    if (values[k] > result->max) {
+      result->max = values[k];
+    }
+    *sum += values[k];
+  }
+  result->count += count;
+}
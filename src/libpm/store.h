@@ -0,0 +1,45 @@
+#ifndef PM_STORE_H_
+#define PM_STORE_H_
+
+#include <stddef.h>
+
+#include <pm/context.h>
+
+#include "arena.h"
+
+/*
+ * A fixed ring of the most recent rows. The values are kept column major,
+ * one run of capacity slots per column, so a window of one column is read
+ * sequentially in at most two runs. The elapsed time of the rows never
+ * decreases, which lets the start of a window be found by bisection.
+ */
+struct pm_store {
+  unsigned long long* elapsed;
+  unsigned long long* values;
+  size_t columns;
+  size_t capacity;
+  size_t head;
+  size_t count;
+};
+
+void pm_store_reset(struct pm_store* store);
+ int pm_store_create(
+  struct pm_store* store,
+  size_t columns,
+  size_t capacity,
+  struct pm_arena* arena);
+void pm_store_destroy(struct pm_store* store);
+
+size_t pm_store_bytes(size_t columns, size_t capacity);
+
+void pm_store_append(
+  struct pm_store* store,
+  unsigned long long elapsed,
+  const unsigned long long* values);
+ int pm_store_window(
+  const struct pm_store* store,
+  size_t column,
+  unsigned long long window,
+  struct pm_window* result);
+
+#endif
@@ -0,0 +1,265 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#endif
+
+#include "atomic.h"
+#include "writer.h"
+
+#define PM_WRITER_IDLE_WAIT 1000
+
+#if defined(__GLIBC__) && \
+  (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 30))
+#define PM_WRITER_CLOCK CLOCK_MONOTONIC
+#define PM_WRITER_TIMEDWAIT(s, t) sem_clockwait((s), CLOCK_MONOTONIC, (t))
+#else
+#define PM_WRITER_CLOCK CLOCK_REALTIME
+#define PM_WRITER_TIMEDWAIT(s, t) sem_timedwait((s), (t))
+#endif
+
+static size_t pm_writer_slots(size_t slots);
+static size_t pm_writer_stride(size_t columns);
+static unsigned long long pm_writer_now();
+static void pm_writer_wait(struct pm_writer* writer, unsigned long ms);
+static void pm_writer_flush_now(struct pm_writer* writer);
+#ifdef _WIN32
+static DWORD WINAPI pm_writer_run(LPVOID parameter);
+#else
+static void* pm_writer_run(void* parameter);
+#endif
+
+void pm_writer_reset(struct pm_writer* writer) {
+  memset(writer, 0x00, sizeof(struct pm_writer));
+}
+
+int pm_writer_start(
+  struct pm_writer* writer,
+  size_t columns,
+  size_t slots,
+  unsigned long rows,
+  unsigned long ms,
+  pm_writer_sink sink,
+  pm_writer_flush flush,
+  void* user,
+  struct pm_arena* arena) {
+  size_t size = pm_writer_slots(slots);
+  pm_writer_reset(writer);
+  writer->stride = pm_writer_stride(columns);
+  writer->ring = (unsigned char*)(
+    pm_arena_alloc(arena, pm_writer_bytes(columns, slots)));
+  if (writer->ring == NULL) {
+    return EXIT_FAILURE;
+  }
+  writer->mask = size - 1;
+  writer->capacity = size;
+  writer->flushrows = rows;
+  writer->flushms = ms;
+  writer->sink = sink;
+  writer->flush = flush;
+  writer->user = user;
+#ifdef _WIN32
+  writer->available = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+  if (writer->available == NULL) {
+    writer->ring = NULL;
+    return EXIT_FAILURE;
+  }
+  writer->thread = CreateThread(NULL, 0, pm_writer_run, writer, 0, NULL);
+  if (writer->thread == NULL) {
+    CloseHandle(writer->available);
+    writer->ring = NULL;
+    return EXIT_FAILURE;
+  }
+#else
+  if (sem_init(&writer->available, 0, 0) != 0) {
+    writer->ring = NULL;
+    return EXIT_FAILURE;
+  }
+  if (pthread_create(&writer->thread, NULL, pm_writer_run, writer) != 0) {
+    sem_destroy(&writer->available);
+    writer->ring = NULL;
+    return EXIT_FAILURE;
+  }
+#endif
+  writer->running = true;
+  return EXIT_SUCCESS;
+}
+
+/* The slot for the next record or NULL when the writer has fallen behind */
+struct pm_writer_record* pm_writer_claim(struct pm_writer* writer) {
+  size_t used = writer->head - PM_LOAD_ACQUIRE(&writer->tail);
+  if (used > writer->mask) {
+    ++writer->dropped;
+    return NULL;
+  }
+  if (used + 1 > writer->highwater) {
+    writer->highwater = used + 1;
+  }
+  return (struct pm_writer_record*)(
+    writer->ring + (writer->head & writer->mask) * writer->stride);
+}
+
+void pm_writer_publish(struct pm_writer* writer) {
+  PM_STORE_RELEASE(&writer->head, writer->head + 1);
+#ifdef _WIN32
+  ReleaseSemaphore(writer->available, 1, NULL);
+#else
+  sem_post(&writer->available);
+#endif
+}
+
+/* Drain what is left, flush a last time and join the writer thread */
+int pm_writer_stop(struct pm_writer* writer) {
+  if (!writer->running) {
+    return EXIT_SUCCESS;
+  }
+  PM_STORE_RELEASE(&writer->stopping, (size_t)(1));
+#ifdef _WIN32
+  ReleaseSemaphore(writer->available, 1, NULL);
+  WaitForSingleObject(writer->thread, INFINITE);
+  CloseHandle(writer->thread);
+  CloseHandle(writer->available);
+#else
+  sem_post(&writer->available);
+  pthread_join(writer->thread, NULL);
+  sem_destroy(&writer->available);
+#endif
+  writer->running = false;
+  writer->ring = NULL;
+  return PM_LOAD_ACQUIRE(&writer->failed) != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+size_t pm_writer_bytes(size_t columns, size_t slots) {
+  return pm_writer_slots(slots) * pm_writer_stride(columns);
+}
+
+bool pm_writer_failed(const struct pm_writer* writer) {
+  return PM_LOAD_ACQUIRE(&writer->failed) != 0;
+}
+
+void pm_writer_get_count(
+  const struct pm_writer* writer,
+  struct pm_writer_count* count) {
+  count->written = writer->written;
+  count->dropped = writer->dropped;
+  count->flushes = writer->flushes;
+  count->highwater = writer->highwater;
+  count->capacity = writer->capacity;
+}
+
+#ifdef _WIN32
+DWORD WINAPI pm_writer_run(LPVOID parameter) {
+#else
+void* pm_writer_run(void* parameter) {
+#endif
+  struct pm_writer* writer = (struct pm_writer*)(parameter);
+  unsigned long long lastflush = pm_writer_now(), now;
+  unsigned long unflushed = 0, wait;
+  size_t end;
+  bool last;
+  for (;;) {
+    wait = PM_WRITER_IDLE_WAIT;
+    if (writer->flushms > 0 && unflushed > 0) {
+      now = pm_writer_now();
+      wait = lastflush + writer->flushms > now ?
+        (unsigned long)(lastflush + writer->flushms - now) : 0;
+    }
+    pm_writer_wait(writer, wait);
+    last = PM_LOAD_ACQUIRE(&writer->stopping) != 0;
+    end = PM_LOAD_ACQUIRE(&writer->head);
+    while (writer->tail != end) {
+      if (writer->failed == 0 && writer->sink(
+        (const struct pm_writer_record*)(
+          writer->ring + (writer->tail & writer->mask) * writer->stride),
+        writer->user) != EXIT_SUCCESS) {
+        PM_STORE_RELEASE(&writer->failed, (size_t)(1));
+      }
+      PM_STORE_RELEASE(&writer->tail, writer->tail + 1);
+      ++writer->written;
+      if (writer->flushrows > 0 && ++unflushed >= writer->flushrows) {
+        pm_writer_flush_now(writer);
+        lastflush = pm_writer_now();
+        unflushed = 0;
+      } else if (writer->flushrows == 0) {
+        ++unflushed;
+      }
+    }
+    if (unflushed > 0 && (last || (writer->flushms > 0 &&
+      pm_writer_now() >= lastflush + writer->flushms))) {
+      pm_writer_flush_now(writer);
+      lastflush = pm_writer_now();
+      unflushed = 0;
+    }
+    if (last) {
+      break;
+    }
+  }
+#ifdef _WIN32
+  return 0;
+#else
+  return NULL;
+#endif
+}
+
+void pm_writer_flush_now(struct pm_writer* writer) {
+  ++writer->flushes;
+  if (writer->failed == 0 && writer->flush(writer->user) != EXIT_SUCCESS) {
+    PM_STORE_RELEASE(&writer->failed, (size_t)(1));
+  }
+}
+
+/* The slots rounded up to a power of two so an index wraps with a mask */
+size_t pm_writer_slots(size_t slots) {
+  size_t size = 1;
+  while (size < slots) {
+    size <<= 1;
+  }
+  return size;
+}
+
+size_t pm_writer_stride(size_t columns) {
+  return sizeof(struct pm_writer_record) +
+    columns * sizeof(unsigned long long);
+}
+
+unsigned long long pm_writer_now() {
+#ifdef _WIN32
+  return GetTickCount64();
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return 1000ULL * (unsigned long long)(now.tv_sec) +
+    (unsigned long long)(now.tv_nsec / 1000000L);
+#endif
+}
+
+/*
+ * Sleep until a record is published or ms have passed. The deadline is on
+ * the monotonic clock so that a change of the wall clock does not stretch
+ * or cut the wait; without sem_clockwait the wall clock is all there is.
+ */
+void pm_writer_wait(struct pm_writer* writer, unsigned long ms) {
+#ifdef _WIN32
+  WaitForSingleObject(writer->available, ms);
+#else
+  struct timespec deadline;
+  clock_gettime(PM_WRITER_CLOCK, &deadline);
+  deadline.tv_sec += (time_t)(ms / 1000);
+  deadline.tv_nsec += (long)(ms % 1000) * 1000000L;
+  if (deadline.tv_nsec >= 1000000000L) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
+  }
+  while (PM_WRITER_TIMEDWAIT(&writer->available, &deadline) != 0 &&
+    errno == EINTR) {
+  }
+#endif
+}
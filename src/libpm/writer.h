@@ -0,0 +1,92 @@
+#ifndef PM_WRITER_H_
+#define PM_WRITER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <semaphore.h>
+#endif
+
+#include <pm/pm.h>
+
+#include "arena.h"
+
+#define PM_WRITER_DEFAULT_CAPACITY 1024
+#define PM_WRITER_DEFAULT_ROWS 1
+
+/* One sampled row as it travels from the sampler to the writer thread */
+struct pm_writer_record {
+  long long time;
+  unsigned long long elapsed;
+  long long count;
+  unsigned long long values[];
+};
+
+typedef int (*pm_writer_sink)(
+  const struct pm_writer_record* record,
+  void* user);
+typedef int (*pm_writer_flush)(void* user);
+
+struct pm_writer {
+  unsigned char* ring;
+  size_t stride;
+  size_t mask;
+  size_t head;
+  size_t tail;
+  unsigned long flushrows;
+  unsigned long flushms;
+  pm_writer_sink sink;
+  pm_writer_flush flush;
+  void* user;
+  size_t stopping;
+  size_t failed;
+  bool running;
+  unsigned long long written;
+  unsigned long long dropped;
+  unsigned long long flushes;
+  size_t highwater;
+  size_t capacity;
+#ifdef _WIN32
+  HANDLE thread;
+  HANDLE available;
+#else
+  pthread_t thread;
+  sem_t available;
+#endif
+};
+
+/*
+ * The sampler claims a slot in a single producer single consumer ring,
+ * fills it and publishes it. The writer thread drains the ring into the
+ * sink and calls flush after a number of rows, after an interval in ms
+ * or when stopped. A zero rows or ms turns that trigger off. The sampler
+ * never waits; a record that finds the ring full is dropped and counted.
+ * The ring is carved from the arena as one part of pm_writer_bytes.
+ */
+void pm_writer_reset(struct pm_writer* writer);
+ int pm_writer_start(
+  struct pm_writer* writer,
+  size_t columns,
+  size_t capacity,
+  unsigned long rows,
+  unsigned long ms,
+  pm_writer_sink sink,
+  pm_writer_flush flush,
+  void* user,
+  struct pm_arena* arena);
+struct pm_writer_record* pm_writer_claim(struct pm_writer* writer);
+void pm_writer_publish(struct pm_writer* writer);
+ int pm_writer_stop(struct pm_writer* writer);
+
+size_t pm_writer_bytes(size_t columns, size_t slots);
+
+bool pm_writer_failed(const struct pm_writer* writer);
+void pm_writer_get_count(
+  const struct pm_writer* writer,
+  struct pm_writer_count* count);
+
+#endif
@@ -0,0 +1,190 @@
+#include <limits.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "encode.h"
+#include "encodebench.h"
+
+#define PM_ENCODEBENCH_TEXT_SIZE 256
+#define PM_ENCODEBENCH_ROWS_PER_SECOND 100
+#define PM_ENCODEBENCH_TIME 1760000000LL
+
+/* Lengths and carries where a digit conversion goes wrong first */
+static const unsigned long long pm_encodebench_value[] = {
+  0ULL,
+  1ULL,
+  9ULL,
+  10ULL,
+  99ULL,
+  100ULL,
+  101ULL,
+  999ULL,
+  1000ULL,
+  4294967295ULL,
+  4294967296ULL,
+  9999999999999999999ULL,
+  10000000000000000000ULL,
+  ULLONG_MAX
+};
+
+static void pm_encodebench_printf(
+  FILE* file,
+  long long time,
+  unsigned long long elapsed,
+  const unsigned long long* values,
+  size_t columns,
+  long long count);
+static int pm_encodebench_check(void);
+static unsigned long long pm_encodebench_clock(void);
+
+int pm_encodebench(unsigned long long rows, unsigned long columns) {
+  struct pm_encoder encoder;
+  unsigned long long* values;
+  unsigned long long start, elapsed[2], i;
+  char* buffer;
+  FILE* file;
+  size_t k;
+  int result = EXIT_FAILURE;
+
+  if (pm_encodebench_check() != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+  printf(
+    "The encoder agrees with printf on %zu edge values\n",
+    sizeof(pm_encodebench_value) / sizeof(pm_encodebench_value[0]));
+
+  values = (unsigned long long*)(malloc(columns * sizeof(unsigned long long)));
+  buffer = (char*)(malloc(pm_encode_bytes(columns)));
+  file = fopen("/dev/null", "w");
+  if (values == NULL || buffer == NULL || file == NULL) {
+    fprintf(stderr, "Failed to set up the encoder benchmark\n");
+    goto pm_encodebench_exit;
+  }
+  for (k = 0; k < columns; ++k) {
+    values[k] = 1000000ULL * (unsigned long long)(k + 1) + 4096ULL * k;
+  }
+  pm_encoder_init(&encoder, buffer);
+
+  start = pm_encodebench_clock();
+  for (i = 0; i < rows; ++i) {
+    values[i % columns] += 4096;
+    pm_encodebench_printf(
+      file,
+      PM_ENCODEBENCH_TIME + (long long)(i / PM_ENCODEBENCH_ROWS_PER_SECOND),
+      10 * i,
+      values,
+      columns,
+      512);
+  }
+  fflush(file);
+  elapsed[0] = pm_encodebench_clock() - start;
+
+  start = pm_encodebench_clock();
+  for (i = 0; i < rows; ++i) {
+    values[i % columns] += 4096;
+    fwrite(buffer, 1, pm_encode_row(
+      &encoder,
+      PM_ENCODEBENCH_TIME + (long long)(i / PM_ENCODEBENCH_ROWS_PER_SECOND),
+      10 * i,
+      values,
+      columns,
+      512), file);
+  }
+  fflush(file);
+  elapsed[1] = pm_encodebench_clock() - start;
+
+  printf(
+    "\n%-8s %8s %14s %14s %10s\n",
+    "rows", "columns", "printf rows/s", "encode rows/s", "speedup");
+  printf(
+    "%-8llu %8lu %14.0f %14.0f %10.1f\n",
+    rows,
+    columns,
+    1e9 * (double)(rows) / (double)(elapsed[0]),
+    1e9 * (double)(rows) / (double)(elapsed[1]),
+    (double)(elapsed[0]) / (double)(elapsed[1]));
+  result = EXIT_SUCCESS;
+
+pm_encodebench_exit:
+  if (file != NULL) {
+    fclose(file);
+  }
+  free(buffer);
+  free(values);
+  return result;
+}
+
+/* The baseline: the row as the csv writer formatted it before the encoder */
+void pm_encodebench_printf(
+  FILE* file,
+  long long time,
+  unsigned long long elapsed,
+  const unsigned long long* values,
+  size_t columns,
+  long long count) {
+  char text[PM_ENCODEBENCH_TEXT_SIZE];
+  struct tm tsr;
+  time_t t = (time_t)(time);
+  size_t k;
+  gmtime_r(&t, &tsr);
+  strftime(text, PM_ENCODEBENCH_TEXT_SIZE, "%y-%m-%d,%H:%M:%S", &tsr);
+  fprintf(file, "%s", text);
+  fprintf(file, ",%llu", elapsed);
+  for (k = 0; k < columns; ++k) {
+    fprintf(file, ",%llu", values[k]);
+  }
+  fprintf(file, ",%lld\n", count);
+}
+
+/* Rows of the edge values, also across a change of second, and a -1 count */
+int pm_encodebench_check(void) {
+  const size_t count =
+    sizeof(pm_encodebench_value) / sizeof(pm_encodebench_value[0]);
+  char expected[PM_ENCODEBENCH_TEXT_SIZE * 2];
+  char buffer[PM_ENCODEBENCH_TEXT_SIZE * 2];
+  struct pm_encoder encoder;
+  FILE* file;
+  size_t length, written;
+  long long second;
+
+  if (pm_encode_bytes(count) > sizeof(buffer)) {
+    return EXIT_FAILURE;
+  }
+  pm_encoder_init(&encoder, buffer);
+  for (second = 0; second < 3; ++second) {
+    if ((file = fmemopen(expected, sizeof(expected), "w")) == NULL) {
+      return EXIT_FAILURE;
+    }
+    pm_encodebench_printf(
+      file,
+      PM_ENCODEBENCH_TIME + second / 2,
+      pm_encodebench_value[(size_t)(second) + 10],
+      pm_encodebench_value,
+      count,
+      second - 1);
+    written = (size_t)(ftell(file));
+    fclose(file);
+    length = pm_encode_row(
+      &encoder,
+      PM_ENCODEBENCH_TIME + second / 2,
+      pm_encodebench_value[(size_t)(second) + 10],
+      pm_encodebench_value,
+      count,
+      second - 1);
+    if (length != written || memcmp(buffer, expected, length) != 0) {
+      fprintf(stderr, "The encoder wrote %.*s instead of %.*s",
+        (int)(length), buffer, (int)(written), expected);
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+unsigned long long pm_encodebench_clock(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return 1000000000ULL * (unsigned long long)(now.tv_sec) +
+    (unsigned long long)(now.tv_nsec);
+}
@@ -0,0 +1,10 @@
+#ifndef PM_ENCODEBENCH_H_
+#define PM_ENCODEBENCH_H_
+
+/*
+ * Check the row encoder against printf on edge values and time rows of
+ * the given columns written to /dev/null both ways over the given rows.
+ */
+int pm_encodebench(unsigned long long rows, unsigned long columns);
+
+#endif
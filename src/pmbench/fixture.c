@@ -0,0 +1,150 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "fixture.h"
+
+#define PM_FIXTURE_PATH_SIZE 4096
+#define PM_FIXTURE_FANOUT 8
+#define PM_FIXTURE_SEED 0x2545f4914f6cdd1dULL
+#define PM_FIXTURE_COMPLETE ".complete"
+
+static unsigned long long pm_fixture_next(unsigned long long* state);
+static int pm_fixture_write(
+  char* path,
+  size_t length,
+  const char* name,
+  const char* text);
+
+/* A tree made by an earlier run is reused as generating one takes a while */
+int pm_fixture_create(const char* root, size_t count) {
+  char path[PM_FIXTURE_PATH_SIZE];
+  char text[1024];
+  unsigned long long state = PM_FIXTURE_SEED;
+  unsigned long long size, resident, faults;
+  struct stat info;
+  size_t pid, length;
+  int parent;
+
+  snprintf(path, sizeof(path), "%s/" PM_FIXTURE_COMPLETE, root);
+  if (stat(path, &info) == 0) {
+    printf("Reusing the fixture of %zu processes in %s\n", count, root);
+    return EXIT_SUCCESS;
+  }
+  if (mkdir(root, 0755) != 0 && stat(root, &info) != 0) {
+    fprintf(stderr, "Failed to create the fixture directory '%s'\n", root);
+    return EXIT_FAILURE;
+  }
+
+  printf("Generating a fixture of %zu processes in %s\n", count, root);
+  for (pid = 1; pid <= count; ++pid) {
+    length = (size_t)(snprintf(path, sizeof(path), "%s/%zu", root, pid));
+    if (length + 16 >= sizeof(path) ||
+      (mkdir(path, 0755) != 0 && stat(path, &info) != 0)) {
+      fprintf(stderr, "Failed to create the fixture process '%s'\n", path);
+      return EXIT_FAILURE;
+    }
+    parent = pid > 1 ? (int)((pid - 2) / PM_FIXTURE_FANOUT + 1) : 0;
+    resident = 64 + pm_fixture_next(&state) % 65536;
+    size = resident + pm_fixture_next(&state) % 262144;
+    faults = pm_fixture_next(&state) % 100000;
+
+    snprintf(text, sizeof(text), "proc%zu\n", pid % 100);
+    if (pm_fixture_write(path, length, "comm", text) != EXIT_SUCCESS) {
+      return EXIT_FAILURE;
+    }
+    snprintf(
+      text,
+      sizeof(text),
+      "%zu (proc%zu) S %d %zu %zu 0 -1 4194560 %llu 0 %llu 0 12 4 0 0 20 0 "
+      "1 0 %zu %llu %llu 18446744073709551615 1 1 0 0 0 0 0 0 0 0 0 0 17 "
+      "0 0 0 0 0 0\n",
+      pid,
+      pid % 100,
+      parent,
+      pid,
+      pid,
+      faults,
+      faults / 100,
+      1000 + pid,
+      size * 4096,
+      resident);
+    if (pm_fixture_write(path, length, "stat", text) != EXIT_SUCCESS) {
+      return EXIT_FAILURE;
+    }
+    snprintf(
+      text,
+      sizeof(text),
+      "%llu %llu %llu 1 0 %llu 0\n",
+      size,
+      resident,
+      resident / 4,
+      resident / 2);
+    if (pm_fixture_write(path, length, "statm", text) != EXIT_SUCCESS) {
+      return EXIT_FAILURE;
+    }
+    snprintf(
+      text,
+      sizeof(text),
+      "Name:\tproc%zu\nUmask:\t0022\nState:\tS (sleeping)\nTgid:\t%zu\n"
+      "Ngid:\t0\nPid:\t%zu\nPPid:\t%d\nTracerPid:\t0\nUid:\t0\t0\t0\t0\n"
+      "Gid:\t0\t0\t0\t0\nFDSize:\t64\nGroups:\t\nVmPeak:\t%8llu kB\n"
+      "VmSize:\t%8llu kB\nVmLck:\t%8llu kB\nVmPin:\t       0 kB\n"
+      "VmHWM:\t%8llu kB\nVmRSS:\t%8llu kB\nRssAnon:\t%8llu kB\n"
+      "RssFile:\t%8llu kB\nRssShmem:\t       0 kB\nVmData:\t%8llu kB\n"
+      "VmStk:\t     132 kB\nVmExe:\t       4 kB\nVmLib:\t    2048 kB\n"
+      "VmPTE:\t%8llu kB\nVmSwap:\t       0 kB\nThreads:\t1\n",
+      pid % 100,
+      pid,
+      pid,
+      parent,
+      4 * size + 4096,
+      4 * size,
+      resident % 16,
+      4 * resident + 1024,
+      4 * resident,
+      3 * resident,
+      resident,
+      2 * resident,
+      size / 256 + 4);
+    if (pm_fixture_write(path, length, "status", text) != EXIT_SUCCESS) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  snprintf(path, sizeof(path), "%s/" PM_FIXTURE_COMPLETE, root);
+  if (pm_fixture_write(path, strlen(path), "", "") != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/* xorshift64* */
+unsigned long long pm_fixture_next(unsigned long long* state) {
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 0x2545f4914f6cdd1dULL;
+}
+
+/* Write text to the file name in the directory path, or to path itself */
+int pm_fixture_write(
+  char* path,
+  size_t length,
+  const char* name,
+  const char* text) {
+  FILE* file;
+  if (*name != '\0') {
+    snprintf(path + length, PM_FIXTURE_PATH_SIZE - length, "/%s", name);
+  }
+  file = fopen(path, "w");
+  if (file == NULL || fputs(text, file) < 0 || fclose(file) != 0) {
+    fprintf(stderr, "Failed to write the fixture file '%s'\n", path);
+    return EXIT_FAILURE;
+  }
+  path[length] = '\0';
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,14 @@
+#ifndef PM_FIXTURE_H_
+#define PM_FIXTURE_H_
+
+#include <stddef.h>
+
+/*
+ * A synthetic procfs tree of count processes with the IDs 1 to count,
+ * each with the comm, stat, statm and status files libpm reads. The
+ * processes form a tree where each has up to eight children, and their
+ * sizes come from a fixed seed so every run samples the same values.
+ */
+int pm_fixture_create(const char* root, size_t count);
+
+#endif
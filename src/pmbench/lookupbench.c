@@ -0,0 +1,286 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "arena.h"
+#include "lookup.h"
+#include "lookupbench.h"
+
+#define PM_LOOKUPBENCH_NAME_SIZE 16
+#define PM_LOOKUPBENCH_ROUNDS 5
+#define PM_LOOKUPBENCH_LOOKUPS 2000000UL
+#define PM_LOOKUPBENCH_LINEAR_LIMIT 2000
+/*
+ * A miss in a table at most half full takes 2.5 slots on average with
+ * linear probing, and a process misses the ID table before the name table
+ */
+#define PM_LOOKUPBENCH_PROBE_LIMIT 6.0
+
+/* The target counts, every one with half ID and half name targets */
+static const unsigned long pm_lookupbench_targets[] = {
+  2UL, 20UL, 200UL, 2000UL, 20000UL
+};
+
+/*
+ * The processes and targets of one run. Process k has the ID k + 1 and the
+ * name "proc<k>", and every other target matches one of them.
+ */
+struct pm_lookupbench_set {
+  unsigned long processes;
+  unsigned long targets;
+  char* names;
+  int* ids;
+  char* targetnames;
+  struct pm_arena arena;
+  struct pm_lookup idlookup;
+  struct pm_lookup namelookup;
+};
+
+static int pm_lookupbench_create(
+  struct pm_lookupbench_set* set,
+  unsigned long processes,
+  unsigned long targets);
+static void pm_lookupbench_destroy(struct pm_lookupbench_set* set);
+static int pm_lookupbench_hashed(
+  const struct pm_lookupbench_set* set,
+  unsigned long k);
+static int pm_lookupbench_linear(
+  const struct pm_lookupbench_set* set,
+  unsigned long k);
+static unsigned long pm_lookupbench_probes(
+  const struct pm_lookupbench_set* set,
+  unsigned long k);
+static unsigned long pm_lookupbench_compares(
+  const struct pm_lookupbench_set* set,
+  unsigned long k);
+static unsigned long long pm_lookupbench_time(
+  const struct pm_lookupbench_set* set,
+  int (*lookup)(const struct pm_lookupbench_set*, unsigned long),
+  unsigned long passes,
+  unsigned long long* matched);
+static unsigned long long pm_lookupbench_clock(void);
+
+/*
+ * The pass or fail is on the slots the lookups touch, which only depend on
+ * the targets and the hashes. The times are printed next to them.
+ */
+int pm_lookupbench(unsigned long processes) {
+  const size_t count =
+    sizeof(pm_lookupbench_targets) / sizeof(pm_lookupbench_targets[0]);
+  struct pm_lookupbench_set set;
+  unsigned long long elapsed, matched, linearmatched, probes, compares;
+  unsigned long passes, k;
+  double slots, hashed, linear;
+  size_t t;
+  int result = EXIT_SUCCESS;
+
+  passes = PM_LOOKUPBENCH_LOOKUPS / processes + 1;
+  printf(
+    "\n%-10s %8s %10s %11s %11s %11s %11s\n",
+    "processes", "targets", "matched", "hash slots", "scan slots",
+    "hash ns", "scan ns");
+  for (t = 0; t < count; ++t) {
+    if (pm_lookupbench_create(
+      &set, processes, pm_lookupbench_targets[t]) != EXIT_SUCCESS) {
+      fprintf(stderr, "Failed to set up the lookup benchmark\n");
+      return EXIT_FAILURE;
+    }
+    probes = 0;
+    compares = 0;
+    for (k = 0; k < processes; ++k) {
+      if (pm_lookupbench_hashed(&set, k) !=
+        pm_lookupbench_linear(&set, k)) {
+        fprintf(
+          stderr,
+          "The lookup of process %lu disagrees with the linear scan for "
+          "%lu targets\n",
+          k + 1,
+          set.targets);
+        pm_lookupbench_destroy(&set);
+        return EXIT_FAILURE;
+      }
+      probes += pm_lookupbench_probes(&set, k);
+      compares += pm_lookupbench_compares(&set, k);
+    }
+    slots = (double)(probes) / (double)(processes);
+    elapsed = pm_lookupbench_time(
+      &set, pm_lookupbench_hashed, passes, &matched);
+    hashed = (double)(elapsed) / (double)(passes * processes);
+    if (set.targets <= PM_LOOKUPBENCH_LINEAR_LIMIT) {
+      elapsed = pm_lookupbench_time(
+        &set, pm_lookupbench_linear, 1, &linearmatched);
+      linear = (double)(elapsed) / (double)(processes);
+      printf(
+        "%-10lu %8lu %10llu %11.2f %11.1f %11.1f %11.1f\n",
+        processes, set.targets, matched, slots,
+        (double)(compares) / (double)(processes), hashed, linear);
+    } else {
+      printf(
+        "%-10lu %8lu %10llu %11.2f %11.1f %11.1f %11s\n",
+        processes, set.targets, matched, slots,
+        (double)(compares) / (double)(processes), hashed, "-");
+    }
+    if (slots > PM_LOOKUPBENCH_PROBE_LIMIT) {
+      fprintf(
+        stderr,
+        "A lookup for %lu targets touched %.2f slots, more than %.1f\n",
+        set.targets,
+        slots,
+        PM_LOOKUPBENCH_PROBE_LIMIT);
+      result = EXIT_FAILURE;
+    }
+    pm_lookupbench_destroy(&set);
+  }
+  return result;
+}
+
+/* Targets past the processes match nothing, as targets that exited */
+int pm_lookupbench_create(
+  struct pm_lookupbench_set* set,
+  unsigned long processes,
+  unsigned long targets) {
+  unsigned long half = targets / 2, k;
+  size_t size;
+  memset(set, 0x00, sizeof(struct pm_lookupbench_set));
+  set->processes = processes;
+  set->targets = targets;
+  set->names = (char*)(malloc(processes * PM_LOOKUPBENCH_NAME_SIZE));
+  set->ids = (int*)(malloc(half * sizeof(int)));
+  set->targetnames = (char*)(malloc(half * PM_LOOKUPBENCH_NAME_SIZE));
+  size = pm_lookup_bytes(half) * 2;
+  if (set->names == NULL || set->ids == NULL || set->targetnames == NULL ||
+    pm_arena_create(&set->arena, size) != EXIT_SUCCESS ||
+    pm_lookup_create(&set->idlookup, half, &set->arena) != EXIT_SUCCESS ||
+    pm_lookup_create(&set->namelookup, half, &set->arena) != EXIT_SUCCESS) {
+    pm_lookupbench_destroy(set);
+    return EXIT_FAILURE;
+  }
+  for (k = 0; k < processes; ++k) {
+    snprintf(
+      set->names + k * PM_LOOKUPBENCH_NAME_SIZE,
+      PM_LOOKUPBENCH_NAME_SIZE,
+      "proc%lu",
+      k);
+  }
+  for (k = 0; k < half; ++k) {
+    set->ids[k] = (int)(2 * k * (processes / targets + 1) + 1);
+    snprintf(
+      set->targetnames + k * PM_LOOKUPBENCH_NAME_SIZE,
+      PM_LOOKUPBENCH_NAME_SIZE,
+      "proc%lu",
+      (2 * k + 1) * (processes / targets + 1));
+    pm_lookup_add_id(&set->idlookup, set->ids[k], (int)(k));
+    pm_lookup_add_name(
+      &set->namelookup,
+      set->targetnames + k * PM_LOOKUPBENCH_NAME_SIZE,
+      (int)(half + k));
+  }
+  return EXIT_SUCCESS;
+}
+
+void pm_lookupbench_destroy(struct pm_lookupbench_set* set) {
+  pm_lookup_destroy(&set->idlookup);
+  pm_lookup_destroy(&set->namelookup);
+  pm_arena_destroy(&set->arena);
+  free(set->targetnames);
+  free(set->ids);
+  free(set->names);
+}
+
+/* As pm_loop matches an enumerated process, by ID first and then by name */
+int pm_lookupbench_hashed(
+  const struct pm_lookupbench_set* set,
+  unsigned long k) {
+  int target = pm_lookup_id(&set->idlookup, (int)(k + 1));
+  if (target < 0) {
+    target = pm_lookup_name(
+      &set->namelookup, set->names + k * PM_LOOKUPBENCH_NAME_SIZE);
+  }
+  return target;
+}
+
+/* The baseline: the scans pm_loop made before the lookup */
+int pm_lookupbench_linear(
+  const struct pm_lookupbench_set* set,
+  unsigned long k) {
+  const char* name = set->names + k * PM_LOOKUPBENCH_NAME_SIZE;
+  unsigned long half = set->targets / 2, i;
+  for (i = 0; i < half; ++i) {
+    if (set->ids[i] == (int)(k + 1)) {
+      return (int)(i);
+    }
+  }
+  for (i = 0; i < half; ++i) {
+    if (strncmp(
+      set->targetnames + i * PM_LOOKUPBENCH_NAME_SIZE,
+      name,
+      PM_LOOKUPBENCH_NAME_SIZE) == 0) {
+      return (int)(half + i);
+    }
+  }
+  return -1;
+}
+
+/* The slots of both tables a lookup of the process touches */
+unsigned long pm_lookupbench_probes(
+  const struct pm_lookupbench_set* set,
+  unsigned long k) {
+  unsigned long probes = pm_lookup_probes_id(&set->idlookup, (int)(k + 1));
+  if (pm_lookup_id(&set->idlookup, (int)(k + 1)) < 0) {
+    probes += pm_lookup_probes_name(
+      &set->namelookup, set->names + k * PM_LOOKUPBENCH_NAME_SIZE);
+  }
+  return probes;
+}
+
+/* The targets the linear scan compares the process with */
+unsigned long pm_lookupbench_compares(
+  const struct pm_lookupbench_set* set,
+  unsigned long k) {
+  unsigned long half = set->targets / 2;
+  int target = pm_lookupbench_linear(set, k);
+  return target < 0 ? 2 * half : (unsigned long)(target) + 1;
+}
+
+/*
+ * The fastest of the rounds, so a busy host does not make a step. Every
+ * result goes to a volatile sink so the lookups stay between the clocks.
+ */
+unsigned long long pm_lookupbench_time(
+  const struct pm_lookupbench_set* set,
+  int (*lookup)(const struct pm_lookupbench_set*, unsigned long),
+  unsigned long passes,
+  unsigned long long* matched) {
+  volatile int sink = 0;
+  unsigned long long start, elapsed, best = 0;
+  unsigned long pass, k;
+  int round, target;
+  for (round = 0; round < PM_LOOKUPBENCH_ROUNDS; ++round) {
+    *matched = 0;
+    start = pm_lookupbench_clock();
+    for (pass = 0; pass < passes; ++pass) {
+      for (k = 0; k < set->processes; ++k) {
+        target = lookup(set, k);
+        sink = target;
+        if (target >= 0) {
+          ++*matched;
+        }
+      }
+    }
+    elapsed = pm_lookupbench_clock() - start;
+    if (round == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  (void)(sink);
+  *matched /= passes;
+  return best;
+}
+
+unsigned long long pm_lookupbench_clock(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return 1000000000ULL * (unsigned long long)(now.tv_sec) +
+    (unsigned long long)(now.tv_nsec);
+}
@@ -0,0 +1,11 @@
+#ifndef PM_LOOKUPBENCH_H_
+#define PM_LOOKUPBENCH_H_
+
+/*
+ * Check the target lookup against a linear scan and time both for the
+ * given processes as the target count grows. Fails when the slots the
+ * lookup touches per process do not stay few.
+ */
+int pm_lookupbench(unsigned long processes);
+
+#endif
@@ -0,0 +1,264 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "parse.h"
+#include "parsebench.h"
+
+#define PM_PARSEBENCH_BUFFER_SIZE 4096
+#define PM_PARSEBENCH_STAT_FIELDS \
+  (PM_PARSE_STAT_FIELD(PM_PARSE_STAT_PPID) | \
+  PM_PARSE_STAT_FIELD(PM_PARSE_STAT_MINFLT) | \
+  PM_PARSE_STAT_FIELD(PM_PARSE_STAT_MAJFLT) | \
+  PM_PARSE_STAT_FIELD(PM_PARSE_STAT_UTIME) | \
+  PM_PARSE_STAT_FIELD(PM_PARSE_STAT_STIME) | \
+  PM_PARSE_STAT_FIELD(PM_PARSE_STAT_THREADS) | \
+  PM_PARSE_STAT_FIELD(PM_PARSE_STAT_STARTTIME))
+#define PM_PARSEBENCH_STATUS_KEYS \
+  (PM_PARSE_STATUS_KEY(PM_PARSE_STATUS_VMPEAK) | \
+  PM_PARSE_STATUS_KEY(PM_PARSE_STATUS_VMLCK) | \
+  PM_PARSE_STATUS_KEY(PM_PARSE_STATUS_VMHWM) | \
+  PM_PARSE_STATUS_KEY(PM_PARSE_STATUS_VMPTE))
+
+/* Names a process can give itself, at most 15 bytes like the kernel */
+static const char* pm_parsebench_comm[] = {
+  "bash",
+  "",
+  "a b c",
+  "a) S 1 2 3",
+  ") (",
+  "((((",
+  "))))",
+  "x)",
+  "(x",
+  "12345 678",
+  "tab\there",
+  "new\nline",
+  "123456789012345",
+  ") 9 9 9 9 9 9 9"
+};
+
+static const char pm_parsebench_status[] =
+  "Name:\tbash\nUmask:\t0022\nState:\tS (sleeping)\nTgid:\t4242\n"
+  "Ngid:\t0\nPid:\t4242\nPPid:\t4241\nTracerPid:\t0\nUid:\t0\t0\t0\t0\n"
+  "Gid:\t0\t0\t0\t0\nFDSize:\t256\nGroups:\t0\nNStgid:\t4242\n"
+  "NSpid:\t4242\nNSpgid:\t4242\nNSsid:\t4242\nVmPeak:\t   12100 kB\n"
+  "VmSize:\t   12036 kB\nVmLck:\t       8 kB\nVmPin:\t       0 kB\n"
+  "VmHWM:\t    5320 kB\nVmRSS:\t    5244 kB\nRssAnon:\t    1752 kB\n"
+  "RssFile:\t    3492 kB\nRssShmem:\t       0 kB\nVmData:\t    1932 kB\n"
+  "VmStk:\t     132 kB\nVmExe:\t     892 kB\nVmLib:\t    1816 kB\n"
+  "VmPTE:\t      60 kB\nVmSwap:\t       0 kB\nHugetlbPages:\t       0 kB\n"
+  "CoreDumping:\t0\nTHP_enabled:\t1\nThreads:\t1\n"
+  "SigQ:\t0/63450\nSigPnd:\t0000000000000000\n";
+
+static const unsigned long long pm_parsebench_status_expected[] = {
+  12100, 8, 5320, 60
+};
+
+static int pm_parsebench_line(
+  char* buffer,
+  const char* comm,
+  const unsigned long long* value);
+static int pm_parsebench_sscanf_stat(
+  const char* buffer,
+  unsigned long long* value);
+static int pm_parsebench_sscanf_status(
+  const char* buffer,
+  unsigned long long* value);
+static int pm_parsebench_check(void);
+static unsigned long long pm_parsebench_clock(void);
+
+int pm_parsebench(unsigned long long iterations) {
+  char buffer[PM_PARSEBENCH_BUFFER_SIZE];
+  unsigned long long value[PM_PARSE_STAT_FIELD_COUNT];
+  unsigned long long start, elapsed[4], i;
+  volatile unsigned long long sink = 0;
+  size_t length, statuslength = sizeof(pm_parsebench_status) - 1;
+  int j;
+
+  if (pm_parsebench_check() != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+  printf(
+    "The parsers agree with sscanf on %zu adversarial comm names\n",
+    sizeof(pm_parsebench_comm) / sizeof(pm_parsebench_comm[0]));
+
+  memset(value, 0x00, sizeof(value));
+  for (j = 0; j < PM_PARSE_STAT_FIELD_COUNT; ++j) {
+    value[j] = 1000000ULL * (unsigned long long)(j + 1);
+  }
+  length = (size_t)(pm_parsebench_line(buffer, "kworker/u16:2", value));
+
+  start = pm_parsebench_clock();
+  for (i = 0; i < iterations; ++i) {
+    pm_parse_stat(buffer, length, PM_PARSEBENCH_STAT_FIELDS, value);
+    sink += value[PM_PARSE_STAT_UTIME];
+  }
+  elapsed[0] = pm_parsebench_clock() - start;
+
+  start = pm_parsebench_clock();
+  for (i = 0; i < iterations; ++i) {
+    pm_parsebench_sscanf_stat(buffer, value);
+    sink += value[PM_PARSE_STAT_UTIME];
+  }
+  elapsed[1] = pm_parsebench_clock() - start;
+
+  start = pm_parsebench_clock();
+  for (i = 0; i < iterations; ++i) {
+    pm_parse_status(
+      pm_parsebench_status,
+      statuslength,
+      PM_PARSEBENCH_STATUS_KEYS,
+      value);
+    sink += value[PM_PARSE_STATUS_VMPTE];
+  }
+  elapsed[2] = pm_parsebench_clock() - start;
+
+  start = pm_parsebench_clock();
+  for (i = 0; i < iterations; ++i) {
+    pm_parsebench_sscanf_status(pm_parsebench_status, value);
+    sink += value[PM_PARSE_STATUS_VMPTE];
+  }
+  elapsed[3] = pm_parsebench_clock() - start;
+  (void)(sink);
+
+  printf("\n%-8s %12s %12s %10s\n", "file", "parse ns", "sscanf ns", "speedup");
+  printf(
+    "%-8s %12.1f %12.1f %10.1f\n",
+    "stat",
+    (double)(elapsed[0]) / (double)(iterations),
+    (double)(elapsed[1]) / (double)(iterations),
+    (double)(elapsed[1]) / (double)(elapsed[0]));
+  printf(
+    "%-8s %12.1f %12.1f %10.1f\n",
+    "status",
+    (double)(elapsed[2]) / (double)(iterations),
+    (double)(elapsed[3]) / (double)(iterations),
+    (double)(elapsed[3]) / (double)(elapsed[2]));
+  return EXIT_SUCCESS;
+}
+
+/* A stat line as the kernel writes it, with the values of the fields */
+int pm_parsebench_line(
+  char* buffer,
+  const char* comm,
+  const unsigned long long* value) {
+  return snprintf(
+    buffer,
+    PM_PARSEBENCH_BUFFER_SIZE,
+    "4242 (%s) S %llu 4242 4242 34816 4242 4194304 %llu 0 %llu 0 %llu %llu "
+    "0 0 20 0 %llu 0 %llu 12324864 1311 18446744073709551615 "
+    "94230452727808 94230453641613 140729620523488 0 0 0 65536 3686404 "
+    "1266761467 1 0 0 17 3 0 0 0 0 0\n",
+    comm,
+    value[PM_PARSE_STAT_PPID],
+    value[PM_PARSE_STAT_MINFLT],
+    value[PM_PARSE_STAT_MAJFLT],
+    value[PM_PARSE_STAT_UTIME],
+    value[PM_PARSE_STAT_STIME],
+    value[PM_PARSE_STAT_THREADS],
+    value[PM_PARSE_STAT_STARTTIME]);
+}
+
+/* The baseline: the last ')' found with strrchr and the fields with sscanf */
+int pm_parsebench_sscanf_stat(
+  const char* buffer,
+  unsigned long long* value) {
+  const char* p = strrchr(buffer, ')');
+  if (p == NULL || sscanf(
+    p + 1,
+    " %*c %llu %*d %*d %*d %*d %*u %llu %*u %llu %*u %llu %llu %*d %*d %*d "
+    "%*d %llu %*d %llu",
+    &value[PM_PARSE_STAT_PPID],
+    &value[PM_PARSE_STAT_MINFLT],
+    &value[PM_PARSE_STAT_MAJFLT],
+    &value[PM_PARSE_STAT_UTIME],
+    &value[PM_PARSE_STAT_STIME],
+    &value[PM_PARSE_STAT_THREADS],
+    &value[PM_PARSE_STAT_STARTTIME]) != 7) {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/* The baseline: every key found with strstr and its value with sscanf */
+int pm_parsebench_sscanf_status(
+  const char* buffer,
+  unsigned long long* value) {
+  static const char* key[PM_PARSE_STATUS_KEY_COUNT] = {
+    "VmPeak:",
+    "VmLck:",
+    "VmHWM:",
+    "VmPTE:"
+  };
+  const char* p;
+  int k;
+  for (k = 0; k < PM_PARSE_STATUS_KEY_COUNT; ++k) {
+    if ((p = strstr(buffer, key[k])) == NULL ||
+      sscanf(p + strlen(key[k]), "%llu", &value[k]) != 1) {
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+int pm_parsebench_check(void) {
+  char buffer[PM_PARSEBENCH_BUFFER_SIZE];
+  unsigned long long expected[PM_PARSE_STAT_FIELD_COUNT];
+  unsigned long long parsed[PM_PARSE_STAT_FIELD_COUNT];
+  unsigned long long baseline[PM_PARSE_STAT_FIELD_COUNT];
+  const char* name;
+  size_t i, length, namelength;
+  int j;
+
+  for (i = 0; i < sizeof(pm_parsebench_comm) / sizeof(pm_parsebench_comm[0]);
+    ++i) {
+    memset(expected, 0x00, sizeof(expected));
+    memset(parsed, 0x00, sizeof(parsed));
+    memset(baseline, 0x00, sizeof(baseline));
+    for (j = 0; j < PM_PARSE_STAT_FIELD_COUNT; ++j) {
+      if (PM_PARSEBENCH_STAT_FIELDS & PM_PARSE_STAT_FIELD(j)) {
+        expected[j] = 18446744073709551615ULL / (unsigned long long)(i + j + 2);
+      }
+    }
+    length = (size_t)(pm_parsebench_line(buffer, pm_parsebench_comm[i], expected));
+    if (pm_parse_comm(buffer, length, &name, &namelength) == NULL ||
+      namelength != strlen(pm_parsebench_comm[i]) ||
+      memcmp(name, pm_parsebench_comm[i], namelength) != 0 ||
+      pm_parse_stat(buffer, length, PM_PARSEBENCH_STAT_FIELDS, parsed) !=
+        EXIT_SUCCESS ||
+      pm_parsebench_sscanf_stat(buffer, baseline) != EXIT_SUCCESS ||
+      memcmp(parsed, expected, sizeof(expected)) != 0 ||
+      memcmp(baseline, expected, sizeof(expected)) != 0) {
+      fprintf(stderr, "The stat parser failed on comm '%s'\n",
+        pm_parsebench_comm[i]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  memset(parsed, 0x00, sizeof(parsed));
+  memset(baseline, 0x00, sizeof(baseline));
+  pm_parse_status(
+    pm_parsebench_status,
+    sizeof(pm_parsebench_status) - 1,
+    PM_PARSEBENCH_STATUS_KEYS,
+    parsed);
+  if (pm_parsebench_sscanf_status(pm_parsebench_status, baseline) !=
+    EXIT_SUCCESS ||
+    memcmp(parsed, pm_parsebench_status_expected,
+      sizeof(pm_parsebench_status_expected)) != 0 ||
+    memcmp(baseline, pm_parsebench_status_expected,
+      sizeof(pm_parsebench_status_expected)) != 0) {
+    fprintf(stderr, "The status parser failed\n");
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+unsigned long long pm_parsebench_clock(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return 1000000000ULL * (unsigned long long)(now.tv_sec) +
+    (unsigned long long)(now.tv_nsec);
+}
@@ -0,0 +1,10 @@
+#ifndef PM_PARSEBENCH_H_
+#define PM_PARSEBENCH_H_
+
+/*
+ * Check the procfs parsers against stat lines with adversarial comm names
+ * and time them against a sscanf baseline over the given iterations.
+ */
+int pm_parsebench(unsigned long long iterations);
+
+#endif
@@ -0,0 +1,374 @@
+#include <stdbool.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <optparse.h>
+
+#include <pm/context.h>
+#include <pm/version.h>
+
+#include "encodebench.h"
+#include "fixture.h"
+#include "lookupbench.h"
+#include "parsebench.h"
+#include "schedule.h"
+
+#define PM_BENCH_DEFAULT_PROCESSES "1000,10000,100000"
+#define PM_BENCH_DEFAULT_FIXTURE "pm_bench_fixture"
+#define PM_BENCH_DEFAULT_TICKS 100
+#define PM_BENCH_DEFAULT_TOP "20"
+#define PM_BENCH_DEFAULT_BY "wss"
+#define PM_BENCH_MAX_RUNS 16
+#define PM_BENCH_PARSE_ITERATIONS 1000000ULL
+#define PM_BENCH_ENCODE_ROWS 200000ULL
+#define PM_BENCH_PATH_SIZE 4096
+#define LONG_OPTIONS_COUNT 13
+#define LONG_OPTIONS_HELP_SPACE 38
+#define TEXT_BUFFER_SIZE 256
+
+#define OPTION_DESCRIPTION_H "produce help message"
+#define OPTION_DESCRIPTION_V "print version string"
+#define OPTION_DESCRIPTION_P "fixture process counts (default 1000,10000,100000)"
+#define OPTION_DESCRIPTION_D "fixture directory (default pm_bench_fixture)"
+#define OPTION_DESCRIPTION_T "measured ticks for each count (default 100)"
+#define OPTION_DESCRIPTION_K "top count of the fixture processes (default 20)"
+#define OPTION_DESCRIPTION_B "memory type the top processes are ranked by"
+#define OPTION_DESCRIPTION_J "sampler threads (default 1)"
+#define OPTION_DESCRIPTION_E "fail when a tick takes more CPU like 5ms"
+#define OPTION_DESCRIPTION_R "check and time the procfs parsers instead"
+#define OPTION_DESCRIPTION_A "read flat processes at most every ticks"
+#define OPTION_DESCRIPTION_N "check and time the csv encoder for columns"
+#define OPTION_DESCRIPTION_L "check and time the target lookup for processes"
+
+struct optparse_description {
+  const char* description;
+  size_t length;
+};
+
+/* The measured ticks of one fixture */
+struct pm_bench_run {
+  size_t processes;
+  unsigned long long ticks;
+  unsigned long long wall;
+  unsigned long long cpu;
+};
+
+static char text_buffer[TEXT_BUFFER_SIZE];
+
+static struct optparse_long longopts[LONG_OPTIONS_COUNT] = {
+    {"help", 'h', OPTPARSE_NONE},
+    {"version", 'v', OPTPARSE_NONE},
+    {"processes", 'p', OPTPARSE_REQUIRED},
+    {"fixture", 'd', OPTPARSE_REQUIRED},
+    {"ticks", 't', OPTPARSE_REQUIRED},
+    {"top", 'k', OPTPARSE_REQUIRED},
+    {"by", 'b', OPTPARSE_REQUIRED},
+    {"threads", 'j', OPTPARSE_REQUIRED},
+    {"budget", 'e', OPTPARSE_REQUIRED},
+    {"parse", 'r', OPTPARSE_NONE},
+    {"adaptive", 'a', OPTPARSE_REQUIRED},
+    {"encode", 'n', OPTPARSE_REQUIRED},
+    {"lookup", 'l', OPTPARSE_REQUIRED}
+};
+
+static struct optparse_description longoptsdesc[LONG_OPTIONS_COUNT] = {
+  { OPTION_DESCRIPTION_H, sizeof(OPTION_DESCRIPTION_H) },
+  { OPTION_DESCRIPTION_V, sizeof(OPTION_DESCRIPTION_V) },
+  { OPTION_DESCRIPTION_P, sizeof(OPTION_DESCRIPTION_P) },
+  { OPTION_DESCRIPTION_D, sizeof(OPTION_DESCRIPTION_D) },
+  { OPTION_DESCRIPTION_T, sizeof(OPTION_DESCRIPTION_T) },
+  { OPTION_DESCRIPTION_K, sizeof(OPTION_DESCRIPTION_K) },
+  { OPTION_DESCRIPTION_B, sizeof(OPTION_DESCRIPTION_B) },
+  { OPTION_DESCRIPTION_J, sizeof(OPTION_DESCRIPTION_J) },
+  { OPTION_DESCRIPTION_E, sizeof(OPTION_DESCRIPTION_E) },
+  { OPTION_DESCRIPTION_R, sizeof(OPTION_DESCRIPTION_R) },
+  { OPTION_DESCRIPTION_A, sizeof(OPTION_DESCRIPTION_A) },
+  { OPTION_DESCRIPTION_N, sizeof(OPTION_DESCRIPTION_N) },
+  { OPTION_DESCRIPTION_L, sizeof(OPTION_DESCRIPTION_L) }
+};
+
+static int bench(
+  const char* root,
+  unsigned long long ticks,
+  char* top,
+  char* by,
+  char* threads,
+  char* adaptive,
+  struct pm_bench_run* run);
+static unsigned long long bench_clock(clockid_t clock);
+static void show_help_item(const int index);
+static void show_help(char* name);
+static void show_version();
+
+int main(int argc, char* argv[]) {
+  struct pm_bench_run run[PM_BENCH_MAX_RUNS];
+  char path[PM_BENCH_PATH_SIZE];
+  struct optparse options;
+  const char* fixture = PM_BENCH_DEFAULT_FIXTURE;
+  char* processes = PM_BENCH_DEFAULT_PROCESSES;
+  char* top = PM_BENCH_DEFAULT_TOP;
+  char* by = PM_BENCH_DEFAULT_BY;
+  char* threads = "1";
+  char* adaptive = NULL;
+  char *p, *next;
+  unsigned long long ticks = PM_BENCH_DEFAULT_TICKS, budget = 0, cpu;
+  size_t runcount = 0, i;
+  int option, longindex, result = EXIT_SUCCESS;
+
+  (void)(argc);
+
+  optparse_init(&options, argv);
+  while ((option = optparse_long(&options, longopts, &longindex)) != -1) {
+    switch (option) {
+
+    case '?':
+    case 'h':
+      show_help(argv[0]);
+      return EXIT_FAILURE;
+
+    case 'v':
+      show_version();
+      return EXIT_FAILURE;
+
+    case 'p':
+      processes = options.optarg;
+      break;
+
+    case 'd':
+      fixture = options.optarg;
+      break;
+
+    case 't':
+      ticks = strtoull(options.optarg, NULL, 10);
+      if (ticks == 0) {
+        fprintf(stderr, "Ticks must be a positive number. "
+          "Use --help for usage.\n");
+        return EXIT_FAILURE;
+      }
+      break;
+
+    case 'k':
+      top = options.optarg;
+      break;
+
+    case 'b':
+      by = options.optarg;
+      break;
+
+    case 'j':
+      threads = options.optarg;
+      break;
+
+    case 'e':
+      budget = pm_schedule_parse(options.optarg);
+      if (budget == 0) {
+        fprintf(stderr, "Budget must be a number with an optional "
+          "us, ms or s unit. Use --help for usage.\n");
+        return EXIT_FAILURE;
+      }
+      break;
+
+    case 'r':
+      return pm_parsebench(PM_BENCH_PARSE_ITERATIONS);
+
+    case 'a':
+      adaptive = options.optarg;
+      break;
+
+    case 'n':
+      if (strtoul(options.optarg, NULL, 10) == 0) {
+        fprintf(stderr, "Columns must be a positive number. "
+          "Use --help for usage.\n");
+        return EXIT_FAILURE;
+      }
+      return pm_encodebench(
+        PM_BENCH_ENCODE_ROWS,
+        strtoul(options.optarg, NULL, 10));
+
+    case 'l':
+      if (strtoul(options.optarg, NULL, 10) == 0) {
+        fprintf(stderr, "Processes must be a positive number. "
+          "Use --help for usage.\n");
+        return EXIT_FAILURE;
+      }
+      return pm_lookupbench(strtoul(options.optarg, NULL, 10));
+    }
+  }
+
+  if ((processes = strdup(processes)) == NULL) {
+    fprintf(stderr, "Out of memory\n");
+    return EXIT_FAILURE;
+  }
+  if (mkdir(fixture, 0755) != 0 && errno != EEXIST) {
+    fprintf(stderr, "Failed to create the fixture directory '%s'\n", fixture);
+    free(processes);
+    return EXIT_FAILURE;
+  }
+
+  for (p = processes; *p != '\0'; p = next) {
+    if ((next = strchr(p, ',')) != NULL) {
+      *next++ = '\0';
+    } else {
+      next = p + strlen(p);
+    }
+    if (runcount >= PM_BENCH_MAX_RUNS) {
+      fprintf(stderr, "At most %d process counts are benchmarked\n",
+        PM_BENCH_MAX_RUNS);
+      result = EXIT_FAILURE;
+      break;
+    }
+    run[runcount].processes = (size_t)(strtoull(p, NULL, 10));
+    if (run[runcount].processes == 0) {
+      fprintf(stderr, "Process count '%s' is not a positive number\n", p);
+      result = EXIT_FAILURE;
+      break;
+    }
+    snprintf(path, sizeof(path), "%s/%zu", fixture, run[runcount].processes);
+    if (pm_fixture_create(path, run[runcount].processes) != EXIT_SUCCESS ||
+      bench(path, ticks, top, by, threads, adaptive, &run[runcount]) !=
+        EXIT_SUCCESS) {
+      result = EXIT_FAILURE;
+      break;
+    }
+    ++runcount;
+  }
+  free(processes);
+
+  printf(
+    "\n%10s %10s %12s %12s %12s %12s\n",
+    "processes", "ticks", "ticks/s", "wall us", "cpu us", "ns/process");
+  for (i = 0; i < runcount; ++i) {
+    cpu = run[i].cpu / run[i].ticks;
+    printf(
+      "%10zu %10llu %12.1f %12.1f %12.1f %12.1f\n",
+      run[i].processes,
+      run[i].ticks,
+      1e9 * (double)(run[i].ticks) / (double)(run[i].wall),
+      (double)(run[i].wall) / (double)(run[i].ticks) / 1000.0,
+      (double)(cpu) / 1000.0,
+      (double)(cpu) / (double)(run[i].processes));
+    if (budget > 0 && cpu > budget) {
+      fprintf(
+        stderr,
+        "A tick of %zu processes took %.1f us of CPU, over the budget of "
+        "%.1f us\n",
+        run[i].processes,
+        (double)(cpu) / 1000.0,
+        (double)(budget) / 1000.0);
+      result = EXIT_FAILURE;
+    }
+  }
+
+  return result;
+}
+
+/*
+ * Monitor the top processes of the fixture at root without output. The
+ * first tick opens and sizes everything so it is left out of the time.
+ */
+int bench(
+  const char* root,
+  unsigned long long ticks,
+  char* top,
+  char* by,
+  char* threads,
+  char* adaptive,
+  struct pm_bench_run* run) {
+  struct pm_context* context;
+  unsigned long long wall, cpu, i;
+  int result = EXIT_FAILURE;
+  char* format = "none";
+  char* procfs;
+
+  if ((context = pm_create()) == NULL) {
+    fprintf(stderr, "Out of memory\n");
+    return EXIT_FAILURE;
+  }
+  procfs = strdup(root);
+  if (procfs != NULL &&
+    pm_context_set_procfs(context, procfs) == EXIT_SUCCESS &&
+    pm_context_set_top(context, top) == EXIT_SUCCESS &&
+    pm_context_set_by(context, by) == EXIT_SUCCESS &&
+    pm_context_set_threads(context, threads) == EXIT_SUCCESS &&
+    (adaptive == NULL ||
+      pm_context_set_adaptive(context, adaptive) == EXIT_SUCCESS) &&
+    pm_context_set_format(context, format) == EXIT_SUCCESS &&
+    pm_context_init(context) == EXIT_SUCCESS) {
+    pm_context_start(context);
+    if (pm_sample(context, NULL) == EXIT_SUCCESS) {
+      wall = bench_clock(CLOCK_MONOTONIC);
+      cpu = bench_clock(CLOCK_PROCESS_CPUTIME_ID);
+      for (i = 0; i < ticks; ++i) {
+        if (pm_sample(context, NULL) != EXIT_SUCCESS) {
+          break;
+        }
+      }
+      run->ticks = i;
+      run->wall = bench_clock(CLOCK_MONOTONIC) - wall;
+      run->cpu = bench_clock(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+      result = i == ticks ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    pm_context_stop(context);
+  }
+  if (result != EXIT_SUCCESS) {
+    fprintf(stderr, "Failed to benchmark the fixture in %s\n", root);
+  }
+  free(procfs);
+  pm_destroy(context);
+  return result;
+}
+
+unsigned long long bench_clock(clockid_t clock) {
+  struct timespec now;
+  clock_gettime(clock, &now);
+  return 1000000000ULL * (unsigned long long)(now.tv_sec) +
+    (unsigned long long)(now.tv_nsec);
+}
+
+void show_help_item(const int index) {
+  const char* description;
+  char* text;
+  int length;
+  description = longoptsdesc[index].description;
+  memset(text_buffer, 0x20, TEXT_BUFFER_SIZE);
+  length = snprintf(
+    text_buffer,
+    TEXT_BUFFER_SIZE,
+    "-%c [ --%s ]",
+    longopts[index].shortname,
+    longopts[index].longname);
+  text = text_buffer;
+  if (length < 200) {
+    text += length;
+    *text = (char)(0x20);
+    text += (size_t)(LONG_OPTIONS_HELP_SPACE - (size_t)(length));
+    memcpy(text, description, longoptsdesc[index].length);
+  }
+  printf("  %s\n", text_buffer);
+}
+
+void show_help(char* n) {
+  int i;
+  printf("%s usage:\n\n", n);
+  for (i = 0; i < LONG_OPTIONS_COUNT; ++i) {
+    show_help_item(i);
+  }
+  printf("\nExamples:\n\n");
+  printf("  %s\n", n);
+  printf("  %s --processes 100000 --ticks 20 --budget 50ms\n", n);
+  printf("  %s --processes 10000 --top 100 --by pfc --threads 4\n", n);
+  printf("  %s --processes 10000 --adaptive 16\n", n);
+  printf("  %s --parse\n", n);
+  printf("  %s --encode 200\n", n);
+  printf("  %s --lookup 10000\n", n);
+}
+
+void show_version() {
+  printf("%s\n", PM_VERSION_TEXT_WITH_ALL);
+}
@@ -1,45 +1,70 @@
 #include <stdbool.h>
 #include <string.h>
 #include <stdlib.h>
-#include <assert.h>
 #include <stdio.h>
 
 #ifdef _WIN32
 #include <windows.h>
 #else
-#include <pthread.h>
+#include <signal.h>
 #include <time.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
 #endif
 
 #include <optparse.h>
 
 #include <pm/pm.h>
+#include <pm/share.h>
 #include <pm/version.h>
 
-#define PM_DEFAULT_INTERVAL 60000
-#define LONG_OPTIONS_COUNT 7
+#include "schedule.h"
+
+#define PM_DEFAULT_INTERVAL 60000000000ULL
+#define PM_PROGRESS_INTERVAL 1000000000ULL
+#define PM_TIMER_SLACK_INTERVAL 10000000ULL
+#define PM_MICROSECONDS_INTERVAL 1000000ULL
+#define PM_ATTACH_INTERVAL 1000000000ULL
+#define PM_ATTACH_NAME_WIDTH 20
+#define PM_ATTACH_VALUE_WIDTH 14
+#define LONG_OPTIONS_COUNT 27
 #define LONG_OPTIONS_HELP_SPACE 38
 #define TEXT_BUFFER_SIZE 256
+#define TICKS_BUFFER_SIZE 32
 
 #define OPTION_DESCRIPTION_H "produce help message"
 #define OPTION_DESCRIPTION_V "print version string"
 #define OPTION_DESCRIPTION_O "output file name"
-#define OPTION_DESCRIPTION_I "interval in ms (default 60000)"
+#define OPTION_DESCRIPTION_I "interval like 250us, 10ms or 2s (default 60000ms)"
 #define OPTION_DESCRIPTION_P "monitoring process id (multiple separated by ,)"
 #define OPTION_DESCRIPTION_N "monitoring process name (multiple separated by ;)"
-#define OPTION_DESCRIPTION_T "memory type (see list below)"
-#define OPTION_DESCRIPTION_C "configuration file name"
+#define OPTION_DESCRIPTION_G "process tree root id (multiple separated by ,)"
+#define OPTION_DESCRIPTION_T "memory types (multiple separated by ,)"
+#define OPTION_DESCRIPTION_F "output format csv, bin, pack or none (default csv)"
+#define OPTION_DESCRIPTION_L "flush after rows, ms or on shutdown (default 1)"
+#define OPTION_DESCRIPTION_Q "writer queue size in rows (default 1024)"
+#define OPTION_DESCRIPTION_J "sampler threads (default 1)"
+#define OPTION_DESCRIPTION_R "rows kept in memory for the summary (default 0)"
+#define OPTION_DESCRIPTION_U "rollup window like 60 or 5m (default off)"
+#define OPTION_DESCRIPTION_K "monitor the top count of all processes"
+#define OPTION_DESCRIPTION_B "memory type the top processes are ranked by"
+#define OPTION_DESCRIPTION_S "print the time each phase of a tick took"
+#define OPTION_DESCRIPTION_X "trace file name in Chrome trace event format"
+#define OPTION_DESCRIPTION_M "missed deadlines skip or catchup (default skip)"
+#define OPTION_DESCRIPTION_C "ticks between reads of costly types (default 30)"
+#define OPTION_DESCRIPTION_A "adapt up to a longest interval like 10s"
+#define OPTION_DESCRIPTION_E "rules like wss>2G:5 or wss+100M/h (separated by ,)"
+#define OPTION_DESCRIPTION_W "events file name (default pm_events.csv)"
+#define OPTION_DESCRIPTION_D "serve metrics on unix:/path or a loopback port"
+#define OPTION_DESCRIPTION_Y "share the live view in shared memory by name"
+#define OPTION_DESCRIPTION_Z "show the live view a monitor shares by name"
+#define OPTION_DESCRIPTION_CAPACITY "processes the tables hold (default 2x at start)"
 
 #ifdef _WIN32
 #define SLEEPER_NAME "Sleeper"
 #define MUTEX_NAME "BreakMutex"
 #define MUTEX_WAIT_TIME 10000
-#else
-#ifdef CLOCK_MONOTONIC
-#define PM_CLOCK CLOCK_MONOTONIC
-#else
-#define PM_CLOCK CLOCK_REALTIME
-#endif
 #endif
 
 #ifdef _WIN32
@@ -62,7 +87,27 @@ static struct optparse_long longopts[LONG_OPTIONS_COUNT] = {
     {"interval", 'i', OPTPARSE_REQUIRED},
     {"process-id", 'p', OPTPARSE_REQUIRED},
     {"process-name", 'n', OPTPARSE_REQUIRED},
-    {"type", 't', OPTPARSE_REQUIRED}
+    {"tree", 'g', OPTPARSE_REQUIRED},
+    {"type", 't', OPTPARSE_REQUIRED},
+    {"format", 'f', OPTPARSE_REQUIRED},
+    {"flush", 'l', OPTPARSE_REQUIRED},
+    {"queue", 'q', OPTPARSE_REQUIRED},
+    {"missed", 'm', OPTPARSE_REQUIRED},
+    {"threads", 'j', OPTPARSE_REQUIRED},
+    {"retention", 'r', OPTPARSE_REQUIRED},
+    {"rollup", 'u', OPTPARSE_REQUIRED},
+    {"top", 'k', OPTPARSE_REQUIRED},
+    {"by", 'b', OPTPARSE_REQUIRED},
+    {"self-stats", 's', OPTPARSE_NONE},
+    {"trace", 'x', OPTPARSE_REQUIRED},
+    {"cadence", 'c', OPTPARSE_REQUIRED},
+    {"adaptive", 'a', OPTPARSE_REQUIRED},
+    {"rule", 'e', OPTPARSE_REQUIRED},
+    {"events", 'w', OPTPARSE_REQUIRED},
+    {"listen", 'd', OPTPARSE_REQUIRED},
+    {"share", 'y', OPTPARSE_REQUIRED},
+    {"attach", 'z', OPTPARSE_REQUIRED},
+    {"capacity", 'P', OPTPARSE_REQUIRED}
 };
 
 static struct optparse_description longoptsdesc[LONG_OPTIONS_COUNT] = {
@@ -72,12 +117,37 @@ static struct optparse_description longoptsdesc[LONG_OPTIONS_COUNT] = {
   { OPTION_DESCRIPTION_I, sizeof(OPTION_DESCRIPTION_I) },
   { OPTION_DESCRIPTION_P, sizeof(OPTION_DESCRIPTION_P) },
   { OPTION_DESCRIPTION_N, sizeof(OPTION_DESCRIPTION_N) },
-  { OPTION_DESCRIPTION_T, sizeof(OPTION_DESCRIPTION_T) }
+  { OPTION_DESCRIPTION_G, sizeof(OPTION_DESCRIPTION_G) },
+  { OPTION_DESCRIPTION_T, sizeof(OPTION_DESCRIPTION_T) },
+  { OPTION_DESCRIPTION_F, sizeof(OPTION_DESCRIPTION_F) },
+  { OPTION_DESCRIPTION_L, sizeof(OPTION_DESCRIPTION_L) },
+  { OPTION_DESCRIPTION_Q, sizeof(OPTION_DESCRIPTION_Q) },
+  { OPTION_DESCRIPTION_M, sizeof(OPTION_DESCRIPTION_M) },
+  { OPTION_DESCRIPTION_J, sizeof(OPTION_DESCRIPTION_J) },
+  { OPTION_DESCRIPTION_R, sizeof(OPTION_DESCRIPTION_R) },
+  { OPTION_DESCRIPTION_U, sizeof(OPTION_DESCRIPTION_U) },
+  { OPTION_DESCRIPTION_K, sizeof(OPTION_DESCRIPTION_K) },
+  { OPTION_DESCRIPTION_B, sizeof(OPTION_DESCRIPTION_B) },
+  { OPTION_DESCRIPTION_S, sizeof(OPTION_DESCRIPTION_S) },
+  { OPTION_DESCRIPTION_X, sizeof(OPTION_DESCRIPTION_X) },
+  { OPTION_DESCRIPTION_C, sizeof(OPTION_DESCRIPTION_C) },
+  { OPTION_DESCRIPTION_A, sizeof(OPTION_DESCRIPTION_A) },
+  { OPTION_DESCRIPTION_E, sizeof(OPTION_DESCRIPTION_E) },
+  { OPTION_DESCRIPTION_W, sizeof(OPTION_DESCRIPTION_W) },
+  { OPTION_DESCRIPTION_D, sizeof(OPTION_DESCRIPTION_D) },
+  { OPTION_DESCRIPTION_Y, sizeof(OPTION_DESCRIPTION_Y) },
+  { OPTION_DESCRIPTION_Z, sizeof(OPTION_DESCRIPTION_Z) },
+  { OPTION_DESCRIPTION_CAPACITY, sizeof(OPTION_DESCRIPTION_CAPACITY) }
 };
 
-static bool _go;
+static volatile bool _go;
 
 static void stop_go();
+static int attach(const char* name, struct pm_schedule* schedule);
+static void show_view(
+  const struct pm_share* share,
+  const struct pm_share_row* row,
+  const unsigned long long* values);
 static void show_types();
 static void show_help_item(const int index);
 static void show_help(char* name);
@@ -86,21 +156,27 @@ static void show_version();
 #ifdef _WIN32
 static BOOL WINAPI CtrlHandler(DWORD fdwCtrlType);
 #else
+static void signal_handler(int signal);
 #endif
 
 int main(int argc, char* argv[]) {
 #ifdef _WIN32
-  DWORD wait, sleep;
-  ULONGLONG begining, conclusion, elapsed;
-  DWORD interval = PM_DEFAULT_INTERVAL;
+  DWORD wait;
 #else
-  struct timespec begining, conclusion;
+  struct sigaction action;
 #endif
+  struct pm_schedule schedule;
+  unsigned long long progress, adaptive = 0;
   struct optparse options;
+  char ticks[TICKS_BUFFER_SIZE];
+  char* attachname = NULL;
 
   int option, longindex, result = EXIT_SUCCESS;
   bool go;
 
+  schedule.interval = PM_DEFAULT_INTERVAL;
+  schedule.policy = PM_SCHEDULE_SKIP;
+
   optparse_init(&options, argv);
   while ((option = optparse_long(&options, longopts, &longindex)) != -1) {
     switch (option) {
@@ -128,12 +204,12 @@ int main(int argc, char* argv[]) {
 
     case 'i':
       if (options.optarg) {
-        interval = atoi(options.optarg);
-        if (interval > 0) {
-          printf("Interval is set to %d\n", interval);
+        schedule.interval = pm_schedule_parse(options.optarg);
+        if (schedule.interval > 0) {
+          printf("Interval is set to %s\n", options.optarg);
         } else {
-          fprintf(stderr, "Interval must be a number. "
-            "Use --help for usage.\n");
+          fprintf(stderr, "Interval must be a number with an optional "
+            "us, ms or s unit. Use --help for usage.\n");
           goto pm_cli_exit_failure;
         }
       } else {
@@ -167,6 +243,18 @@ int main(int argc, char* argv[]) {
       }
       break;
 
+    case 'g':
+      if (options.optarg) {
+        if ((result = pm_add_trees(options.optarg)) != EXIT_SUCCESS) {
+          goto pm_cli_exit_cleanup;
+        }
+      } else {
+        fprintf(stderr, "Process Tree not specified. "
+          "Use --help for usage.\n");
+        goto pm_cli_exit_failure;
+      }
+      break;
+
     case 't':
       if (options.optarg) {
         if ((result = pm_set_types(options.optarg)) != EXIT_SUCCESS) {
@@ -178,10 +266,249 @@ int main(int argc, char* argv[]) {
         goto pm_cli_exit_failure;
       }
       break;
+
+    case 'f':
+      if (options.optarg) {
+        if ((result = pm_set_format(options.optarg)) != EXIT_SUCCESS) {
+          goto pm_cli_exit_cleanup;
+        }
+      } else {
+        fprintf(stderr, "Format not specified. "
+          "Use --help for usage.\n");
+        goto pm_cli_exit_failure;
+      }
+      break;
+
+    case 'l':
+      if (options.optarg) {
+        if ((result = pm_set_flush(options.optarg)) != EXIT_SUCCESS) {
+          goto pm_cli_exit_cleanup;
+        }
+      } else {
+        fprintf(stderr, "Flush policy not specified. "
+          "Use --help for usage.\n");
+        goto pm_cli_exit_failure;
+      }
+      break;
+
+    case 'q':
+      if (options.optarg) {
+        if ((result = pm_set_queue(options.optarg)) != EXIT_SUCCESS) {
+          goto pm_cli_exit_cleanup;
+        }
+      } else {
+        fprintf(stderr, "Queue size not specified. "
+          "Use --help for usage.\n");
+        goto pm_cli_exit_failure;
+      }
+      break;
+
+    case 'P':
+      if (options.optarg) {
+        if ((result = pm_set_capacity(options.optarg)) != EXIT_SUCCESS) {
+          goto pm_cli_exit_cleanup;
+        }
+      } else {
+        fprintf(stderr, "Capacity not specified. "
+          "Use --help for usage.\n");
+        goto pm_cli_exit_failure;
+      }
+      break;
+
+    case 'm':
+      if (options.optarg && strncmp(options.optarg, "skip", 0x10) == 0) {
+        schedule.policy = PM_SCHEDULE_SKIP;
+      } else if (options.optarg &&
+        strncmp(options.optarg, "catchup", 0x10) == 0) {
+        schedule.policy = PM_SCHEDULE_CATCH_UP;
+      } else {
+        fprintf(stderr, "Missed deadline policy must be skip or catchup. "
+          "Use --help for usage.\n");
+        goto pm_cli_exit_failure;
+      }
+      break;
+
+    case 'j':
+      if (options.optarg) {
+        if ((result = pm_set_threads(options.optarg)) != EXIT_SUCCESS) {
+          goto pm_cli_exit_cleanup;
+        }
+      } else {
+        fprintf(stderr, "Thread count not specified. "
+          "Use --help for usage.\n");
+        goto pm_cli_exit_failure;
+      }
+      break;
+
+    case 'r':
+      if (options.optarg) {
+        if ((result = pm_set_retention(options.optarg)) != EXIT_SUCCESS) {
+          goto pm_cli_exit_cleanup;
+        }
+      } else {
+        fprintf(stderr, "Retention not specified. "
+          "Use --help for usage.\n");
+        goto pm_cli_exit_failure;
+      }
+      break;
+
+    case 'u':
+      if (options.optarg) {
+        if ((result = pm_set_rollup(options.optarg)) != EXIT_SUCCESS) {
+          goto pm_cli_exit_cleanup;
+        }
+      } else {
+        fprintf(stderr, "Rollup window not specified. "
+          "Use --help for usage.\n");
+        goto pm_cli_exit_failure;
+      }
+      break;
+
+    case 'k':
+      if (options.optarg) {
+        if ((result = pm_set_top(options.optarg)) != EXIT_SUCCESS) {
+          goto pm_cli_exit_cleanup;
+        }
+      } else {
+        fprintf(stderr, "Top count not specified. "
+          "Use --help for usage.\n");
+        goto pm_cli_exit_failure;
+      }
+      break;
+
+    case 'b':
+      if (options.optarg) {
+        if ((result = pm_set_by(options.optarg)) != EXIT_SUCCESS) {
+          goto pm_cli_exit_cleanup;
+        }
+      } else {
+        fprintf(stderr, "Ranking type not specified. "
+          "Use --help for usage.\n");
+        goto pm_cli_exit_failure;
+      }
+      break;
+
+    case 's':
+      if ((result = pm_set_self_stats(1)) != EXIT_SUCCESS) {
+        goto pm_cli_exit_cleanup;
+      }
+      break;
+
+    case 'x':
+      if (options.optarg) {
+        if ((result = pm_set_trace(options.optarg)) != EXIT_SUCCESS) {
+          goto pm_cli_exit_cleanup;
+        }
+      } else {
+        fprintf(stderr, "Trace file name not specified. "
+          "Use --help for usage.\n");
+        goto pm_cli_exit_failure;
+      }
+      break;
+
+    case 'c':
+      if (options.optarg) {
+        if ((result = pm_set_cadence(options.optarg)) != EXIT_SUCCESS) {
+          goto pm_cli_exit_cleanup;
+        }
+      } else {
+        fprintf(stderr, "Cadence not specified. "
+          "Use --help for usage.\n");
+        goto pm_cli_exit_failure;
+      }
+      break;
+
+    case 'a':
+      if (options.optarg) {
+        adaptive = pm_schedule_parse(options.optarg);
+        if (adaptive == 0) {
+          fprintf(stderr, "Longest interval must be a number with an "
+            "optional us, ms or s unit. Use --help for usage.\n");
+          goto pm_cli_exit_failure;
+        }
+      } else {
+        fprintf(stderr, "Longest interval not specified. "
+          "Use --help for usage.\n");
+        goto pm_cli_exit_failure;
+      }
+      break;
+
+    case 'e':
+      if (options.optarg) {
+        if ((result = pm_add_rules(options.optarg)) != EXIT_SUCCESS) {
+          goto pm_cli_exit_cleanup;
+        }
+      } else {
+        fprintf(stderr, "Rule not specified. "
+          "Use --help for usage.\n");
+        goto pm_cli_exit_failure;
+      }
+      break;
+
+    case 'w':
+      if (options.optarg) {
+        if ((result = pm_set_events(options.optarg)) != EXIT_SUCCESS) {
+          goto pm_cli_exit_cleanup;
+        }
+      } else {
+        fprintf(stderr, "Events file name not specified. "
+          "Use --help for usage.\n");
+        goto pm_cli_exit_failure;
+      }
+      break;
+
+    case 'd':
+      if (options.optarg) {
+        if ((result = pm_set_listen(options.optarg)) != EXIT_SUCCESS) {
+          goto pm_cli_exit_cleanup;
+        }
+      } else {
+        fprintf(stderr, "Listen address not specified. "
+          "Use --help for usage.\n");
+        goto pm_cli_exit_failure;
+      }
+      break;
+
+    case 'y':
+      if (options.optarg) {
+        if ((result = pm_set_share(options.optarg)) != EXIT_SUCCESS) {
+          goto pm_cli_exit_cleanup;
+        }
+      } else {
+        fprintf(stderr, "Shared view name not specified. "
+          "Use --help for usage.\n");
+        goto pm_cli_exit_failure;
+      }
+      break;
+
+    case 'z':
+      if (options.optarg) {
+        attachname = options.optarg;
+      } else {
+        fprintf(stderr, "Shared view name not specified. "
+          "Use --help for usage.\n");
+        goto pm_cli_exit_failure;
+      }
+      break;
     }
   }
 
-  if ((result = pm_init()) != EXIT_SUCCESS) {
+  /* The interval is the shortest and the ticks run at it */
+  if (adaptive > 0) {
+    snprintf(ticks, sizeof(ticks), "%llu", adaptive / schedule.interval);
+    if ((result = pm_set_adaptive(ticks)) != EXIT_SUCCESS) {
+      goto pm_cli_exit_cleanup;
+    }
+  }
+
+  /* Below a ms every row would have about the same elapsed ms */
+  if (schedule.interval < PM_MICROSECONDS_INTERVAL &&
+    (result = pm_set_microseconds(1)) != EXIT_SUCCESS) {
+    goto pm_cli_exit_cleanup;
+  }
+
+  /* Attaching only reads the view of another monitor */
+  if (attachname == NULL && (result = pm_init()) != EXIT_SUCCESS) {
     goto pm_cli_exit_cleanup;
   }
 
@@ -209,46 +536,56 @@ int main(int argc, char* argv[]) {
     goto pm_cli_exit_failure;
   }
 #else
+  memset(&action, 0x00, sizeof(action));
+  action.sa_handler = signal_handler;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGINT, &action, NULL) != 0 ||
+    sigaction(SIGTERM, &action, NULL) != 0) {
+    fprintf(stderr, "Failed to set signal handler\n");
+    goto pm_cli_exit_failure;
+  }
+#ifdef __linux__
+  /* Let short sleeps wake close to their deadline */
+  if (schedule.interval < PM_TIMER_SLACK_INTERVAL) {
+    prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+  }
+#endif
 #endif
 
+  if (attachname != NULL) {
+    _go = true;
+    result = attach(attachname, &schedule);
+    goto pm_cli_exit_cleanup;
+  }
+
   _go = go = true;
 
   printf("Press Ctrl-C or Ctrl-Break to stop!\n");
 
+  /* At short intervals only print progress about once a second */
+  progress = schedule.interval < PM_PROGRESS_INTERVAL ?
+    PM_PROGRESS_INTERVAL / schedule.interval : 1;
+
   pm_start();
-  while (go) {
 #ifdef _WIN32
-    begining = GetTickCount64();
+  pm_schedule_start(&schedule, ghSleeper);
 #else
-    clock_gettime(PM_CLOCK, &begining);
+  pm_schedule_start(&schedule);
 #endif
-    printf(".");
+  while (go) {
+    if (schedule.ticks % progress == 0) {
+      printf(".");
+      fflush(stdout);
+    }
 
     if ((result = pm_loop()) != EXIT_SUCCESS) {
       goto pm_cli_exit_cleanup;
     }
 
-#ifdef _WIN32
-    conclusion = GetTickCount64();
-    elapsed = conclusion - begining;
-    if (elapsed < interval) {
-      sleep = interval - (DWORD)(elapsed);
-      assert(sleep <= interval);
-      wait = WaitForSingleObject(ghSleeper, sleep);
-      switch (wait) {
-      case WAIT_OBJECT_0:
-      case WAIT_TIMEOUT:
-        break;
-      case WAIT_ABANDONED:
-      case WAIT_FAILED:
-      default:
-        fprintf(stderr, "Waiting for the go lock failed\n");
-        goto pm_cli_exit_failure;
-      }
+    if (!pm_schedule_wait(&schedule)) {
+      fprintf(stderr, "Waiting for the next tick failed\n");
+      goto pm_cli_exit_failure;
     }
-#else
-    clock_gettime(PM_CLOCK, &begining);
-#endif
 
 #ifdef _WIN32
     wait = WaitForSingleObject(ghMutex, MUTEX_WAIT_TIME);
@@ -268,10 +605,13 @@ int main(int argc, char* argv[]) {
       goto pm_cli_exit_failure;
     }
 #else
+    go = _go;
 #endif
   }
   printf("\n");
 
+  pm_schedule_report(&schedule);
+
   printf("Exiting and cleanup\n");
 
 
@@ -305,8 +645,8 @@ pm_cli_exit_cleanup:
 }
 
 void stop_go() {
-  DWORD wait;
 #ifdef _WIN32
+  DWORD wait;
   if (!SetEvent(ghSleeper)) {
     fprintf(stderr, "Setting the sleeper event failed\n");
   }
@@ -326,9 +666,120 @@ void stop_go() {
     fprintf(stderr, "Failed to release the go lock\n");
   }
 #else
+  _go = false;
 #endif
 }
 
+/*
+ * Map the view and redraw it on every interval until stopped. A refresh
+ * only reads the mapped memory and never holds up the monitor, which
+ * does not know it is watched.
+ */
+int attach(const char* name, struct pm_schedule* schedule) {
+  const struct pm_share_layout* layout;
+  struct pm_share share;
+  struct pm_share_row row;
+  unsigned long long* values;
+  pm_share_reset(&share);
+  if (pm_share_attach(&share, name) != EXIT_SUCCESS) {
+    fprintf(stderr, "Failed to attach to the shared view '%s'\n", name);
+    return EXIT_FAILURE;
+  }
+  layout = pm_share_get_layout(&share);
+  values = (unsigned long long*)(
+    malloc((layout->columns + 1) * sizeof(unsigned long long)));
+  if (values == NULL) {
+    fprintf(stderr, "Out of memory\n");
+    pm_share_detach(&share);
+    return EXIT_FAILURE;
+  }
+  if (schedule->interval == PM_DEFAULT_INTERVAL) {
+    schedule->interval = PM_ATTACH_INTERVAL;
+  }
+#ifdef _WIN32
+  pm_schedule_start(schedule, ghSleeper);
+#else
+  pm_schedule_start(schedule);
+#endif
+  while (_go) {
+    if (pm_share_read(&share, &row, values) == EXIT_SUCCESS) {
+      show_view(&share, &row, values);
+      if (row.stopped) {
+        printf("The monitor stopped\n");
+        break;
+      }
+    }
+    if (!pm_schedule_wait(schedule)) {
+      fprintf(stderr, "Waiting for the next refresh failed\n");
+      break;
+    }
+  }
+  free(values);
+  pm_share_detach(&share);
+  return EXIT_SUCCESS;
+}
+
+/* One line for each target with its extra, its values and its age */
+void show_view(
+  const struct pm_share* share,
+  const struct pm_share_row* row,
+  const unsigned long long* values) {
+  const struct pm_share_layout* layout = pm_share_get_layout(share);
+  const char* extra[] = { NULL, "pid", "members" };
+  size_t target, k;
+  printf("\033[H\033[J");
+  printf(
+    "%s tick %llu, %lld processes, %llu.%03llu s elapsed\n\n",
+    share->name,
+    row->tick,
+    row->count,
+    row->elapsed / 1000,
+    row->elapsed % 1000);
+  printf("%-*s", PM_ATTACH_NAME_WIDTH, "target");
+  if (layout->extrakind != PM_SHARE_EXTRA_NONE) {
+    printf(" %*s", PM_ATTACH_VALUE_WIDTH, extra[layout->extrakind]);
+  }
+  for (k = 0; k < layout->types; ++k) {
+    printf(" %*s", PM_ATTACH_VALUE_WIDTH, pm_share_get_type(share, k));
+  }
+  if (layout->agecount > 0) {
+    printf(" %*s", PM_ATTACH_VALUE_WIDTH, "age ms");
+  }
+  printf("\n");
+  for (target = 0; target < layout->targets; ++target) {
+    printf(
+      "%-*.*s",
+      PM_ATTACH_NAME_WIDTH,
+      PM_ATTACH_NAME_WIDTH,
+      pm_share_get_target(share, target));
+    if (layout->extrakind != PM_SHARE_EXTRA_NONE) {
+      if (target >= layout->extrafirst &&
+        target - layout->extrafirst < layout->extracount) {
+        printf(
+          " %*llu",
+          PM_ATTACH_VALUE_WIDTH,
+          values[layout->extrastart + target - layout->extrafirst]);
+      } else {
+        printf(" %*s", PM_ATTACH_VALUE_WIDTH, "");
+      }
+    }
+    for (k = 0; k < layout->types; ++k) {
+      printf(
+        " %*llu",
+        PM_ATTACH_VALUE_WIDTH,
+        values[target * layout->types + k]);
+    }
+    if (target < layout->agecount &&
+      values[layout->agestart + target] == PM_AGE_NEVER) {
+      printf(" %*s", PM_ATTACH_VALUE_WIDTH, "-");
+    } else if (target < layout->agecount) {
+      printf(" %*llu", PM_ATTACH_VALUE_WIDTH, values[layout->agestart + target]);
+    }
+    printf("\n");
+  }
+  fflush(stdout);
+}
+
 void show_types() {
   int i;
   printf("\nTypes\n\n");
@@ -380,6 +831,15 @@ void show_help(char* n) {
   show_types();
   printf("\nExamples:\n\n");
   printf("  %s --process-id 1234,5678\n", n);
+  printf("  %s --process-id 1234 --type wss,pfu,pfc\n", n);
+  printf("  %s --process-id 1234 --interval 1ms --missed skip\n", n);
+  printf("  %s --process-id 1234 --interval 100ms --adaptive 10s\n", n);
+  printf("  %s --process-id 1234 --rule wss>2G:5,wss+100M/h:60\n", n);
+#ifndef _WIN32
+  printf("  %s --top 20 --by pss --listen 9464\n", n);
+  printf("  %s --top 20 --share pm --format none\n", n);
+  printf("  %s --attach pm --interval 500ms\n", n);
+#endif
 #ifdef _WIN32
   printf("  %s --process-name a.exe;b.exe;%s\n", n, n);
   printf("  %s  --process-id 1234,5678 --process-name a.exe;b.exe;%s\n", n, n);
@@ -426,4 +886,8 @@ BOOL WINAPI CtrlHandler(DWORD fdwCtrlType) {
   }
 }
 #else
+void signal_handler(int signal) {
+  (void)(signal);
+  stop_go();
+}
 #endif
@@ -0,0 +1,157 @@
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <time.h>
+#endif
+
+#include "schedule.h"
+
+#define PM_SCHEDULE_NS_PER_US 1000ULL
+#define PM_SCHEDULE_NS_PER_MS 1000000ULL
+#define PM_SCHEDULE_NS_PER_S 1000000000ULL
+
+#ifndef _WIN32
+#ifdef CLOCK_MONOTONIC
+#define PM_SCHEDULE_CLOCK CLOCK_MONOTONIC
+#else
+#define PM_SCHEDULE_CLOCK CLOCK_REALTIME
+#endif
+#endif
+
+static unsigned long long pm_schedule_now();
+static void pm_schedule_record(struct pm_schedule* schedule);
+
+/* A number with an optional us, ms or s unit. Without a unit it is ms. */
+unsigned long long pm_schedule_parse(const char* text) {
+  unsigned long long value;
+  char* end;
+  value = strtoull(text, &end, 10);
+  if (end == text || value == 0) {
+    return 0;
+  }
+  if (*end == '\0' || strncmp(end, "ms", 0x10) == 0) {
+    return value * PM_SCHEDULE_NS_PER_MS;
+  } else if (strncmp(end, "us", 0x10) == 0) {
+    return value * PM_SCHEDULE_NS_PER_US;
+  } else if (strncmp(end, "s", 0x10) == 0) {
+    return value * PM_SCHEDULE_NS_PER_S;
+  }
+  return 0;
+}
+
+#ifdef _WIN32
+void pm_schedule_start(struct pm_schedule* schedule, HANDLE wake) {
+  schedule->wake = wake;
+#else
+void pm_schedule_start(struct pm_schedule* schedule) {
+#endif
+  schedule->deadline = pm_schedule_now();
+  schedule->ticks = 0;
+  schedule->missed = 0;
+  schedule->jittermin = 0;
+  schedule->jittermax = 0;
+  schedule->jittersum = 0;
+}
+
+/*
+ * Wait for the deadline after the current one. Returns false only when
+ * waiting failed. An interrupted wait returns early so the caller can
+ * check whether it should stop.
+ */
+bool pm_schedule_wait(struct pm_schedule* schedule) {
+  unsigned long long now = pm_schedule_now(), late;
+#ifdef _WIN32
+  DWORD wait;
+#else
+  struct timespec deadline;
+#endif
+  schedule->deadline += schedule->interval;
+  if (now > schedule->deadline) {
+    if (schedule->policy == PM_SCHEDULE_SKIP) {
+      late = (now - schedule->deadline) / schedule->interval + 1;
+      schedule->deadline += late * schedule->interval;
+      schedule->missed += late;
+    } else {
+      schedule->missed++;
+      pm_schedule_record(schedule);
+      return true;
+    }
+  }
+
+#ifdef _WIN32
+  while ((now = pm_schedule_now()) < schedule->deadline) {
+    wait = (DWORD)((schedule->deadline - now + PM_SCHEDULE_NS_PER_MS - 1) /
+      PM_SCHEDULE_NS_PER_MS);
+    switch (WaitForSingleObject(schedule->wake, wait)) {
+    case WAIT_OBJECT_0:
+      return true;
+    case WAIT_TIMEOUT:
+      break;
+    default:
+      return false;
+    }
+  }
+#else
+  deadline.tv_sec = (time_t)(schedule->deadline / PM_SCHEDULE_NS_PER_S);
+  deadline.tv_nsec = (long)(schedule->deadline % PM_SCHEDULE_NS_PER_S);
+  if (clock_nanosleep(
+    PM_SCHEDULE_CLOCK,
+    TIMER_ABSTIME,
+    &deadline,
+    NULL) != 0) {
+    return true;
+  }
+#endif
+  pm_schedule_record(schedule);
+  return true;
+}
+
+void pm_schedule_report(const struct pm_schedule* schedule) {
+  if (schedule->ticks > 0) {
+    printf(
+      "Wake-up jitter min %.3f us, max %.3f us, mean %.3f us "
+      "over %llu ticks, %llu deadlines missed\n",
+      (double)(schedule->jittermin) / PM_SCHEDULE_NS_PER_US,
+      (double)(schedule->jittermax) / PM_SCHEDULE_NS_PER_US,
+      (double)(schedule->jittersum) / schedule->ticks / PM_SCHEDULE_NS_PER_US,
+      schedule->ticks,
+      schedule->missed);
+  }
+}
+
+/* The wake-up time relative to the deadline */
+void pm_schedule_record(struct pm_schedule* schedule) {
+  long long jitter = (long long)(pm_schedule_now() - schedule->deadline);
+  if (schedule->ticks == 0 || jitter < schedule->jittermin) {
+    schedule->jittermin = jitter;
+  }
+  if (schedule->ticks == 0 || jitter > schedule->jittermax) {
+    schedule->jittermax = jitter;
+  }
+  schedule->jittersum += jitter;
+  schedule->ticks++;
+}
+
+unsigned long long pm_schedule_now() {
+#ifdef _WIN32
+  static LARGE_INTEGER frequency;
+  LARGE_INTEGER counter;
+  if (frequency.QuadPart == 0) {
+    QueryPerformanceFrequency(&frequency);
+  }
+  QueryPerformanceCounter(&counter);
+  return (unsigned long long)(counter.QuadPart / frequency.QuadPart) *
+    PM_SCHEDULE_NS_PER_S +
+    (unsigned long long)(counter.QuadPart % frequency.QuadPart) *
+    PM_SCHEDULE_NS_PER_S / (unsigned long long)(frequency.QuadPart);
+#else
+  struct timespec now;
+  clock_gettime(PM_SCHEDULE_CLOCK, &now);
+  return (unsigned long long)(now.tv_sec) * PM_SCHEDULE_NS_PER_S +
+    (unsigned long long)(now.tv_nsec);
+#endif
+}
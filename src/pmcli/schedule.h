@@ -0,0 +1,43 @@
+#ifndef PM_SCHEDULE_H_
+#define PM_SCHEDULE_H_
+
+#include <stdbool.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#define PM_SCHEDULE_SKIP 0
+#define PM_SCHEDULE_CATCH_UP 1
+
+/*
+ * Ticks are due at absolute deadlines start + n * interval so a slow tick
+ * does not push the later ones back. A missed deadline is either skipped,
+ * continuing with the next one still ahead, or caught up by running the
+ * late ticks back to back.
+ */
+struct pm_schedule {
+  unsigned long long interval;
+  unsigned long long deadline;
+  int policy;
+  unsigned long long ticks;
+  unsigned long long missed;
+  long long jittermin;
+  long long jittermax;
+  long long jittersum;
+#ifdef _WIN32
+  HANDLE wake;
+#endif
+};
+
+unsigned long long pm_schedule_parse(const char* text);
+
+#ifdef _WIN32
+void pm_schedule_start(struct pm_schedule* schedule, HANDLE wake);
+#else
+void pm_schedule_start(struct pm_schedule* schedule);
+#endif
+bool pm_schedule_wait(struct pm_schedule* schedule);
+void pm_schedule_report(const struct pm_schedule* schedule);
+
+#endif
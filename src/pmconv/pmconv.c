@@ -0,0 +1,984 @@
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include <pm/pm.h>
+#include <pm/format.h>
+#include <pm/pack.h>
+#include <pm/sketch.h>
+#include <pm/version.h>
+
+#define TEXT_BUFFER_SIZE 256
+#define ROLLUP_FIXED_COUNT 4
+#define ROLLUP_TARGET_COUNT 7
+#define ROLLUP_KEY_SIZE 17
+#define BENCH_MINIMUM_TIME 1000000000ULL
+
+static unsigned char fixed[PM_FORMAT_FIXED_HEADER_SIZE];
+static unsigned char* header = NULL;
+static unsigned char* record = NULL;
+static char** targets = NULL;
+static int* types = NULL;
+static char* row = NULL;
+static size_t rowsize;
+
+static unsigned char* payload = NULL;
+static size_t payloadsize;
+static size_t blocksize;
+static long long* packedtime = NULL;
+static unsigned long long* packedelapsed = NULL;
+static unsigned long long* packedvalues = NULL;
+static long long* packedcount = NULL;
+static unsigned char* packedwindow = NULL;
+static bool packed;
+
+static unsigned int headersize;
+static unsigned int recordsize;
+static unsigned int version;
+static unsigned int targetcount;
+static unsigned int typecount;
+static unsigned int extracount;
+static unsigned int unit = PM_FORMAT_UNIT_MS;
+static size_t columncount;
+static unsigned long long recordcount;
+
+static FILE* input = NULL;
+static FILE* output = NULL;
+
+static void show_help(char* name);
+static int read_header();
+static int read_packed_header();
+static int load_names(
+  const unsigned char** p,
+  const unsigned char* end,
+  unsigned int from,
+  unsigned int to);
+static int read_names(unsigned int from, unsigned int to);
+static int grow_targets();
+static int allocate_rows();
+static int read_block(size_t* rows);
+static int write_header();
+static int write_record();
+static int write_block(size_t rows);
+static int format_row(
+  long long time,
+  unsigned long long elapsed,
+  const unsigned long long* values,
+  long long count);
+static int bench();
+static unsigned long long now();
+static int merge_rollups(int count, char* files[]);
+static int merge_row(
+  FILE** inputs,
+  char** lines,
+  size_t* sizes,
+  bool* selected,
+  int count,
+  const char* key,
+  struct pm_sketch* sketches,
+  size_t rollups);
+static const char* skip_fields(const char* p, int count);
+static int read_line(FILE* file, char** line, size_t* size);
+static void store32(unsigned char* p, unsigned int value);
+static unsigned int load32(const unsigned char* p);
+static unsigned long long load64(const unsigned char* p);
+
+int main(int argc, char* argv[]) {
+  char magic[PM_FORMAT_MAGIC_SIZE];
+  unsigned long long r;
+  unsigned int k;
+  size_t rows;
+  int result = EXIT_SUCCESS;
+  bool benchmark;
+
+  if (argc > 3 && strcmp(argv[1], "--merge") == 0) {
+    return merge_rollups(argc - 2, argv + 2);
+  }
+
+  benchmark = argc == 3 && strcmp(argv[1], "--bench") == 0;
+  if (!benchmark && (argc < 2 || argc > 3 || argv[1][0] == '-')) {
+    show_help(argv[0]);
+    goto pm_conv_exit_failure;
+  }
+
+  input = fopen(argv[benchmark ? 2 : 1], "rb");
+  if (input == NULL) {
+    fprintf(stderr, "Failed to open input file '%s'\n",
+      argv[benchmark ? 2 : 1]);
+    goto pm_conv_exit_failure;
+  }
+
+  packed = fread(magic, 1, PM_PACK_MAGIC_SIZE, input) == PM_PACK_MAGIC_SIZE &&
+    memcmp(magic, PM_PACK_MAGIC, PM_PACK_MAGIC_SIZE) == 0;
+  rewind(input);
+  if ((result = packed ? read_packed_header() : read_header()) !=
+    EXIT_SUCCESS) {
+    goto pm_conv_exit_cleanup;
+  }
+
+  if (benchmark) {
+    if (!packed) {
+      fprintf(stderr, "The benchmark needs a packed file\n");
+      goto pm_conv_exit_failure;
+    }
+    result = bench();
+    goto pm_conv_exit_cleanup;
+  }
+
+  if (argc > 2) {
+    output = fopen(argv[2], "w");
+    if (output == NULL) {
+      fprintf(stderr, "Failed to open output file '%s'\n", argv[2]);
+      goto pm_conv_exit_failure;
+    }
+  } else {
+    output = stdout;
+  }
+
+  if ((result = write_header()) != EXIT_SUCCESS) {
+    goto pm_conv_exit_cleanup;
+  }
+
+  while (packed) {
+    if ((result = read_block(&rows)) != EXIT_SUCCESS) {
+      goto pm_conv_exit_cleanup;
+    }
+    if (rows == 0) {
+      break;
+    }
+    if ((result = write_block(rows)) != EXIT_SUCCESS) {
+      goto pm_conv_exit_cleanup;
+    }
+  }
+
+  for (r = 0; !packed && r < recordcount; ++r) {
+    if (fread(record, 1, recordsize, input) != recordsize) {
+      fprintf(stderr, "The input file ends after %llu records\n", r);
+      break;
+    }
+    if ((result = write_record()) != EXIT_SUCCESS) {
+      goto pm_conv_exit_cleanup;
+    }
+  }
+
+  goto pm_conv_exit_cleanup;
+
+pm_conv_exit_failure:
+  result = EXIT_FAILURE;
+
+pm_conv_exit_cleanup:
+  if (output != NULL && output != stdout) {
+    if (fclose(output) != 0) {
+      fprintf(stderr, "Failed to close the output file\n");
+      result = EXIT_FAILURE;
+    }
+  }
+  if (input != NULL) {
+    fclose(input);
+  }
+  if (targets != NULL) {
+    for (k = 0; k < targetcount + extracount; ++k) {
+      free(targets[k]);
+    }
+    free(targets);
+  }
+  free(types);
+  free(record);
+  free(header);
+  free(row);
+  free(payload);
+  free(packedtime);
+  free(packedelapsed);
+  free(packedvalues);
+  free(packedcount);
+  free(packedwindow);
+  return result;
+}
+
+void show_help(char* n) {
+  printf("%s\n", PM_VERSION_TEXT_WITH_ALL);
+  printf("%s usage:\n\n", n);
+  printf("  %s <binary input file> [csv output file]\n\n", n);
+  printf("Converts a file written by pmcli --format bin or pack to the csv\n");
+  printf("layout. The csv is written to the standard output if no file is\n");
+  printf("given.\n");
+  printf("\n  %s --bench <packed input file>\n\n", n);
+  printf("Measures the size and decoding speed of a packed file against\n");
+  printf("the csv layout.\n");
+  printf("\n  %s --merge <csv output file> <rollup csv file>...\n\n", n);
+  printf("Merges files written by pmcli --rollup with the same columns,\n");
+  printf("for example from several hosts, into one row per window.\n");
+}
+
+int read_header() {
+  const unsigned char* p;
+  const unsigned char* end;
+  unsigned int k, length;
+  if (fread(fixed, 1, PM_FORMAT_FIXED_HEADER_SIZE, input) !=
+    PM_FORMAT_FIXED_HEADER_SIZE ||
+    memcmp(fixed, PM_FORMAT_MAGIC, PM_FORMAT_MAGIC_SIZE) != 0) {
+    fprintf(stderr, "The input file is not a binary monitoring file\n");
+    return EXIT_FAILURE;
+  }
+  version = load32(fixed + PM_FORMAT_OFFSET_VERSION);
+  if (version == 0 || version > PM_FORMAT_VERSION) {
+    fprintf(stderr, "Unsupported binary file version %u\n", version);
+    return EXIT_FAILURE;
+  }
+  headersize = load32(fixed + PM_FORMAT_OFFSET_HEADER_SIZE);
+  recordsize = load32(fixed + PM_FORMAT_OFFSET_RECORD_SIZE);
+  targetcount = load32(fixed + PM_FORMAT_OFFSET_TARGET_COUNT);
+  typecount = load32(fixed + PM_FORMAT_OFFSET_TYPE_COUNT);
+  recordcount = load64(fixed + PM_FORMAT_OFFSET_RECORD_COUNT);
+  if (headersize < PM_FORMAT_FIXED_HEADER_SIZE ||
+    typecount == 0 || typecount > PM_TYPE_COUNT ||
+    recordsize < PM_FORMAT_RECORD_SIZE(
+      (unsigned long long)(targetcount) * typecount)) {
+    fprintf(stderr, "The binary file header is corrupt\n");
+    return EXIT_FAILURE;
+  }
+
+  header = (unsigned char*)(malloc(headersize));
+  record = (unsigned char*)(malloc(recordsize));
+  targets = (char**)(calloc(targetcount + 1, sizeof(char*)));
+  types = (int*)(malloc(typecount * sizeof(int)));
+  if (header == NULL || record == NULL || targets == NULL || types == NULL) {
+    fprintf(stderr, "Memory error\n");
+    return EXIT_FAILURE;
+  }
+  length = headersize - PM_FORMAT_FIXED_HEADER_SIZE;
+  if (fread(header, 1, length, input) != length) {
+    fprintf(stderr, "The binary file header is truncated\n");
+    return EXIT_FAILURE;
+  }
+
+  p = header;
+  for (k = 0; k < typecount; ++k, p += 4) {
+    types[k] = (int)(load32(p));
+    if (types[k] <= PM_TYPE_UNDEFINED || types[k] >= PM_TYPE_UNKNOWN) {
+      fprintf(stderr, "Unknown memory type %d\n", types[k]);
+      return EXIT_FAILURE;
+    }
+  }
+  end = header + headersize - PM_FORMAT_FIXED_HEADER_SIZE;
+  if (load_names(&p, end, 0, targetcount) != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+  if (version > 1) {
+    if (p + 4 > end) {
+      fprintf(stderr, "The binary file header is corrupt\n");
+      return EXIT_FAILURE;
+    }
+    extracount = load32(p);
+    p += 4;
+    if (grow_targets() != EXIT_SUCCESS ||
+      load_names(&p, end, targetcount, targetcount + extracount) !=
+      EXIT_SUCCESS) {
+      return EXIT_FAILURE;
+    }
+  }
+  if (version > 2) {
+    if (p + 4 > end) {
+      fprintf(stderr, "The binary file header is corrupt\n");
+      return EXIT_FAILURE;
+    }
+    unit = load32(p);
+    if (unit != PM_FORMAT_UNIT_MS && unit != PM_FORMAT_UNIT_US) {
+      fprintf(stderr, "The binary file header is corrupt\n");
+      return EXIT_FAILURE;
+    }
+  }
+  columncount = (size_t)(targetcount) * typecount + extracount;
+  if (recordsize != PM_FORMAT_RECORD_SIZE(columncount)) {
+    fprintf(stderr, "The binary file header is corrupt\n");
+    return EXIT_FAILURE;
+  }
+  return allocate_rows();
+}
+
+int read_packed_header() {
+  unsigned char p[PM_PACK_FIXED_HEADER_SIZE];
+  unsigned int k;
+  if (fread(p, 1, PM_PACK_FIXED_HEADER_SIZE, input) !=
+    PM_PACK_FIXED_HEADER_SIZE) {
+    fprintf(stderr, "The packed file header is truncated\n");
+    return EXIT_FAILURE;
+  }
+  version = load32(p + PM_PACK_OFFSET_VERSION);
+  if (version == 0 || version > PM_PACK_VERSION) {
+    fprintf(stderr, "Unsupported packed file version %u\n", version);
+    return EXIT_FAILURE;
+  }
+  targetcount = load32(p + PM_PACK_OFFSET_TARGET_COUNT);
+  typecount = load32(p + PM_PACK_OFFSET_TYPE_COUNT);
+  if (typecount == 0 || typecount > PM_TYPE_COUNT) {
+    fprintf(stderr, "The packed file header is corrupt\n");
+    return EXIT_FAILURE;
+  }
+  targets = (char**)(calloc(targetcount + 1, sizeof(char*)));
+  types = (int*)(malloc(typecount * sizeof(int)));
+  if (targets == NULL || types == NULL) {
+    fprintf(stderr, "Memory error\n");
+    return EXIT_FAILURE;
+  }
+  for (k = 0; k < typecount; ++k) {
+    if (fread(p, 1, 4, input) != 4) {
+      fprintf(stderr, "The packed file header is truncated\n");
+      return EXIT_FAILURE;
+    }
+    types[k] = (int)(load32(p));
+    if (types[k] <= PM_TYPE_UNDEFINED || types[k] >= PM_TYPE_UNKNOWN) {
+      fprintf(stderr, "Unknown memory type %d\n", types[k]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (read_names(0, targetcount) != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+  if (version > 1) {
+    if (fread(p, 1, 4, input) != 4) {
+      fprintf(stderr, "The packed file header is truncated\n");
+      return EXIT_FAILURE;
+    }
+    extracount = load32(p);
+    if (grow_targets() != EXIT_SUCCESS ||
+      read_names(targetcount, targetcount + extracount) != EXIT_SUCCESS) {
+      return EXIT_FAILURE;
+    }
+  }
+  if (version > 2) {
+    if (fread(p, 1, 4, input) != 4) {
+      fprintf(stderr, "The packed file header is truncated\n");
+      return EXIT_FAILURE;
+    }
+    unit = load32(p);
+    if (unit != PM_FORMAT_UNIT_MS && unit != PM_FORMAT_UNIT_US) {
+      fprintf(stderr, "The packed file header is corrupt\n");
+      return EXIT_FAILURE;
+    }
+  }
+  columncount = (size_t)(targetcount) * typecount + extracount;
+  packedtime = (long long*)(malloc(PM_PACK_BLOCK_ROWS * sizeof(long long)));
+  packedelapsed = (unsigned long long*)(
+    malloc(PM_PACK_BLOCK_ROWS * sizeof(unsigned long long)));
+  packedvalues = (unsigned long long*)(malloc(PM_PACK_BLOCK_ROWS *
+    (columncount + 1) * sizeof(unsigned long long)));
+  packedcount = (long long*)(malloc(PM_PACK_BLOCK_ROWS * sizeof(long long)));
+  packedwindow = (unsigned char*)(malloc(PM_PACK_WINDOW_SIZE(columncount)));
+  if (packedtime == NULL || packedelapsed == NULL ||
+    packedvalues == NULL || packedcount == NULL || packedwindow == NULL) {
+    fprintf(stderr, "Memory error\n");
+    return EXIT_FAILURE;
+  }
+  return allocate_rows();
+}
+
+/* The names from and up to to in the header of a binary file */
+int load_names(
+  const unsigned char** p,
+  const unsigned char* end,
+  unsigned int from,
+  unsigned int to) {
+  unsigned int k, length;
+  for (k = from; k < to; ++k) {
+    if (*p + 4 > end) {
+      fprintf(stderr, "The binary file header is corrupt\n");
+      return EXIT_FAILURE;
+    }
+    length = load32(*p);
+    *p += 4;
+    if (*p + length > end) {
+      fprintf(stderr, "The binary file header is corrupt\n");
+      return EXIT_FAILURE;
+    }
+    targets[k] = (char*)(malloc(length + 1));
+    if (targets[k] == NULL) {
+      fprintf(stderr, "Memory error\n");
+      return EXIT_FAILURE;
+    }
+    memcpy(targets[k], *p, length);
+    targets[k][length] = '\0';
+    *p += length;
+  }
+  return EXIT_SUCCESS;
+}
+
+/* The names from and up to to in the header of a packed file */
+int read_names(unsigned int from, unsigned int to) {
+  unsigned char p[4];
+  unsigned int k, length;
+  for (k = from; k < to; ++k) {
+    if (fread(p, 1, 4, input) != 4 ||
+      (length = load32(p)) > TEXT_BUFFER_SIZE) {
+      fprintf(stderr, "The packed file header is corrupt\n");
+      return EXIT_FAILURE;
+    }
+    targets[k] = (char*)(malloc(length + 1));
+    if (targets[k] == NULL) {
+      fprintf(stderr, "Memory error\n");
+      return EXIT_FAILURE;
+    }
+    if (fread(targets[k], 1, length, input) != length) {
+      fprintf(stderr, "The packed file header is truncated\n");
+      return EXIT_FAILURE;
+    }
+    targets[k][length] = '\0';
+  }
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Files from version 2 name the extra columns after the targets, such as
+ * the member counts of process trees. Their names follow the target names.
+ */
+int grow_targets() {
+  char** grown;
+  if (extracount > TEXT_BUFFER_SIZE) {
+    fprintf(stderr, "The file header is corrupt\n");
+    return EXIT_FAILURE;
+  }
+  grown = (char**)(realloc(
+    targets,
+    (targetcount + extracount + 1) * sizeof(char*)));
+  if (grown == NULL) {
+    fprintf(stderr, "Memory error\n");
+    return EXIT_FAILURE;
+  }
+  memset(grown + targetcount, 0x00, (extracount + 1) * sizeof(char*));
+  targets = grown;
+  return EXIT_SUCCESS;
+}
+
+/* A row of text has room for the date, time and every number */
+int allocate_rows() {
+  rowsize = TEXT_BUFFER_SIZE + 24 * columncount;
+  row = (char*)(malloc(rowsize));
+  if (row == NULL) {
+    fprintf(stderr, "Memory error\n");
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/* Read the next block into the payload, rows is zero at the end */
+int read_block(size_t* rows) {
+  unsigned char p[PM_PACK_BLOCK_HEADER_SIZE];
+  unsigned char* grown;
+  size_t size, read;
+  *rows = 0;
+  read = fread(p, 1, PM_PACK_BLOCK_HEADER_SIZE, input);
+  if (read == 0 && feof(input)) {
+    return EXIT_SUCCESS;
+  }
+  if (read != PM_PACK_BLOCK_HEADER_SIZE) {
+    fprintf(stderr, "The packed file ends in a block header\n");
+    return EXIT_FAILURE;
+  }
+  size = load32(p);
+  if (size > payloadsize) {
+    grown = (unsigned char*)(realloc(payload, size));
+    if (grown == NULL) {
+      fprintf(stderr, "Memory error\n");
+      return EXIT_FAILURE;
+    }
+    payload = grown;
+    payloadsize = size;
+  }
+  if (fread(payload, 1, size, input) != size) {
+    fprintf(stderr, "The packed file ends in a block\n");
+    return EXIT_FAILURE;
+  }
+  *rows = load32(p + 4);
+  blocksize = size;
+  if (pm_pack_decode(
+    payload,
+    size,
+    *rows,
+    columncount,
+    packedwindow,
+    packedtime,
+    packedelapsed,
+    packedvalues,
+    packedcount) != EXIT_SUCCESS) {
+    fprintf(stderr, "The packed file has a corrupt block\n");
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int write_header() {
+  unsigned int k, t;
+  fprintf(
+    output,
+    "date,time,%s",
+    unit == PM_FORMAT_UNIT_US ? "elapsed_us" : "elapsed");
+  for (k = 0; k < targetcount; ++k) {
+    for (t = 0; t < typecount; ++t) {
+      fprintf(output, ",%s", targets[k]);
+      if (typecount > 1) {
+        fprintf(output, ":%s", pm_type_arr[types[t] - 1].st);
+      }
+    }
+  }
+  for (k = targetcount; k < targetcount + extracount; ++k) {
+    fprintf(output, ",%s", targets[k]);
+  }
+  fprintf(output, ",count\n");
+  return EXIT_SUCCESS;
+}
+
+/* The values of a binary record are stored in place as they are loaded */
+int write_record() {
+  unsigned long long* values = (unsigned long long*)(record + 16);
+  size_t columns = columncount, c;
+  int length;
+  for (c = 0; c < columns; ++c) {
+    values[c] = load64(record + 16 + 8 * c);
+  }
+  length = format_row(
+    (long long)(load64(record)),
+    load64(record + 8),
+    values,
+    (long long)(load64(record + 16 + 8 * columns)));
+  if (length < 0 || fwrite(row, 1, (size_t)(length), output) !=
+    (size_t)(length)) {
+    fprintf(stderr, "Failed to write to the output file\n");
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int write_block(size_t rows) {
+  size_t columns = columncount, r;
+  int length;
+  for (r = 0; r < rows; ++r) {
+    length = format_row(
+      packedtime[r],
+      packedelapsed[r],
+      &packedvalues[r * columns],
+      packedcount[r]);
+    if (length < 0 || fwrite(row, 1, (size_t)(length), output) !=
+      (size_t)(length)) {
+      fprintf(stderr, "Failed to write to the output file\n");
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+/* Format a csv row into row and return its length */
+int format_row(
+  long long time,
+  unsigned long long elapsed,
+  const unsigned long long* values,
+  long long count) {
+  size_t columns = columncount, c, used;
+  struct tm tsr;
+  time_t t;
+  t = (time_t)(time);
+#ifdef _WIN32
+  gmtime_s(&tsr, &t);
+#else
+  gmtime_r(&t, &tsr);
+#endif
+  used = strftime(row, rowsize, "%y-%m-%d,%H:%M:%S", &tsr);
+  used += (size_t)(snprintf(row + used, rowsize - used, ",%llu", elapsed));
+  for (c = 0; c < columns; ++c) {
+    used += (size_t)(
+      snprintf(row + used, rowsize - used, ",%llu", values[c]));
+  }
+  used += (size_t)(snprintf(row + used, rowsize - used, ",%lld\n", count));
+  return used < rowsize ? (int)(used) : -1;
+}
+
+/*
+ * Read every block into memory, then time decoding all of them until at
+ * least a second has passed and time formatting the rows as csv once.
+ */
+int bench() {
+  unsigned char* blocks = NULL;
+  unsigned char* grown;
+  unsigned long long start, decoding, formatting, passes, rows = 0;
+  size_t used = 0, capacity = 0, position, size, r, n, columns;
+  long packedsize, header;
+  double csvsize = 0.0, recordbytes;
+  int length;
+
+  columns = columncount;
+  header = ftell(input);
+  packedsize = fseek(input, 0, SEEK_END) == 0 ? ftell(input) : -1L;
+  if (header < 0 || packedsize < 0 || fseek(input, header, SEEK_SET) != 0) {
+    fprintf(stderr, "Failed to read the input file\n");
+    return EXIT_FAILURE;
+  }
+  for (;;) {
+    if (read_block(&n) != EXIT_SUCCESS) {
+      free(blocks);
+      return EXIT_FAILURE;
+    }
+    if (n == 0) {
+      break;
+    }
+    size = PM_PACK_BLOCK_HEADER_SIZE + blocksize;
+    if (used + size > capacity) {
+      capacity = 2 * (used + size);
+      if ((grown = (unsigned char*)(realloc(blocks, capacity))) == NULL) {
+        fprintf(stderr, "Memory error\n");
+        free(blocks);
+        return EXIT_FAILURE;
+      }
+      blocks = grown;
+    }
+    store32(blocks + used, (unsigned int)(blocksize));
+    store32(blocks + used + 4, (unsigned int)(n));
+    memcpy(blocks + used + PM_PACK_BLOCK_HEADER_SIZE, payload, blocksize);
+    used += size;
+    rows += n;
+  }
+
+  start = now();
+  passes = 0;
+  do {
+    for (position = 0; position < used; position += size) {
+      size = load32(blocks + position);
+      pm_pack_decode(
+        blocks + position + PM_PACK_BLOCK_HEADER_SIZE,
+        size,
+        load32(blocks + position + 4),
+        columns,
+        packedwindow,
+        packedtime,
+        packedelapsed,
+        packedvalues,
+        packedcount);
+      size += PM_PACK_BLOCK_HEADER_SIZE;
+    }
+    ++passes;
+    decoding = now() - start;
+  } while (decoding < BENCH_MINIMUM_TIME);
+
+  start = now();
+  for (position = 0; position < used; position += size) {
+    size = load32(blocks + position);
+    n = load32(blocks + position + 4);
+    pm_pack_decode(
+      blocks + position + PM_PACK_BLOCK_HEADER_SIZE,
+      size,
+      n,
+      columns,
+      packedwindow,
+      packedtime,
+      packedelapsed,
+      packedvalues,
+      packedcount);
+    for (r = 0; r < n; ++r) {
+      length = format_row(
+        packedtime[r],
+        packedelapsed[r],
+        &packedvalues[r * columns],
+        packedcount[r]);
+      csvsize += length > 0 ? (double)(length) : 0.0;
+    }
+    size += PM_PACK_BLOCK_HEADER_SIZE;
+  }
+  formatting = now() - start;
+
+  recordbytes = (double)(rows) * PM_FORMAT_RECORD_SIZE(columns);
+  printf("%llu rows of %lu columns\n", rows, (unsigned long)(columns));
+  printf("Packed %ld bytes, csv %.0f bytes, binary %.0f bytes\n",
+    packedsize, csvsize, recordbytes);
+  printf("The packed file is %.1f times smaller than the csv and %.1f times "
+    "smaller than the binary file\n",
+    csvsize / (double)(packedsize), recordbytes / (double)(packedsize));
+  printf("Decoding %.1f MB/s of binary records, %.1f million rows/s\n",
+    recordbytes * (double)(passes) / ((double)(decoding) / 1e9) / 1e6,
+    (double)(rows * passes) / ((double)(decoding) / 1e9) / 1e6);
+  printf("Formatting csv %.1f MB/s\n",
+    csvsize / ((double)(formatting) / 1e9) / 1e6);
+  free(blocks);
+  return EXIT_SUCCESS;
+}
+
+/* A monotonic time in ns */
+unsigned long long now() {
+#ifdef _WIN32
+  LARGE_INTEGER counter, frequency;
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&frequency);
+  return (unsigned long long)(
+    (double)(counter.QuadPart) * 1e9 / (double)(frequency.QuadPart));
+#else
+  struct timespec current;
+  clock_gettime(CLOCK_MONOTONIC, &current);
+  return 1000000000ULL * (unsigned long long)(current.tv_sec) +
+    (unsigned long long)(current.tv_nsec);
+#endif
+}
+
+/*
+ * The files are sorted by window so they are merged like sorted runs. The
+ * rows of a window are combined by merging the sketch of every column and
+ * deriving the other summary columns from the merged sketch.
+ */
+int merge_rollups(int count, char* files[]) {
+  FILE** inputs = NULL;
+  char** lines = NULL;
+  size_t* sizes = NULL;
+  bool* selected = NULL;
+  struct pm_sketch* sketches = NULL;
+  const char* key;
+  size_t rollups = 0, fields;
+  int k, result = EXIT_SUCCESS;
+  char* p;
+
+  --count;
+  inputs = (FILE**)(calloc(count, sizeof(FILE*)));
+  lines = (char**)(calloc(count, sizeof(char*)));
+  sizes = (size_t*)(calloc(count, sizeof(size_t)));
+  selected = (bool*)(calloc(count, sizeof(bool)));
+  if (inputs == NULL || lines == NULL || sizes == NULL || selected == NULL) {
+    fprintf(stderr, "Memory error\n");
+    goto pm_merge_exit_failure;
+  }
+
+  for (k = 0; k < count; ++k) {
+    inputs[k] = fopen(files[k + 1], "r");
+    if (inputs[k] == NULL) {
+      fprintf(stderr, "Failed to open input file '%s'\n", files[k + 1]);
+      goto pm_merge_exit_failure;
+    }
+    if (read_line(inputs[k], &lines[k], &sizes[k]) != EXIT_SUCCESS ||
+      (k > 0 && strcmp(lines[k], lines[0]) != 0)) {
+      fprintf(stderr, "The input file '%s' does not have the rollup columns "
+        "of the first file\n", files[k + 1]);
+      goto pm_merge_exit_failure;
+    }
+  }
+
+  for (fields = 1, p = lines[0]; *p != '\0'; ++p) {
+    fields += *p == ',' ? 1 : 0;
+  }
+  if (fields > ROLLUP_FIXED_COUNT &&
+    (fields - ROLLUP_FIXED_COUNT) % ROLLUP_TARGET_COUNT == 0) {
+    rollups = (fields - ROLLUP_FIXED_COUNT) / ROLLUP_TARGET_COUNT;
+  }
+  if (rollups == 0 || strstr(lines[0], ":sketch,") == NULL) {
+    fprintf(stderr, "The input file '%s' is not a rollup file\n", files[1]);
+    goto pm_merge_exit_failure;
+  }
+  sketches = (struct pm_sketch*)(malloc(rollups * sizeof(struct pm_sketch)));
+  if (sketches == NULL) {
+    fprintf(stderr, "Memory error\n");
+    goto pm_merge_exit_failure;
+  }
+
+  output = fopen(files[0], "w");
+  if (output == NULL) {
+    fprintf(stderr, "Failed to open output file '%s'\n", files[0]);
+    goto pm_merge_exit_failure;
+  }
+  fprintf(output, "%s\n", lines[0]);
+
+  for (k = 0; k < count; ++k) {
+    selected[k] = read_line(inputs[k], &lines[k], &sizes[k]) == EXIT_SUCCESS;
+  }
+  for (;;) {
+    key = NULL;
+    for (k = 0; k < count; ++k) {
+      if (selected[k] &&
+        (key == NULL || strncmp(lines[k], key, ROLLUP_KEY_SIZE) < 0)) {
+        key = lines[k];
+      }
+    }
+    if (key == NULL) {
+      break;
+    }
+    if (merge_row(
+      inputs,
+      lines,
+      sizes,
+      selected,
+      count,
+      key,
+      sketches,
+      rollups) != EXIT_SUCCESS) {
+      goto pm_merge_exit_failure;
+    }
+  }
+  goto pm_merge_exit_cleanup;
+
+pm_merge_exit_failure:
+  result = EXIT_FAILURE;
+
+pm_merge_exit_cleanup:
+  if (output != NULL && fclose(output) != 0) {
+    fprintf(stderr, "Failed to close the output file\n");
+    result = EXIT_FAILURE;
+  }
+  for (k = 0; inputs != NULL && k < count; ++k) {
+    if (inputs[k] != NULL) {
+      fclose(inputs[k]);
+    }
+    free(lines[k]);
+  }
+  free(inputs);
+  free(lines);
+  free(sizes);
+  free(selected);
+  free(sketches);
+  return result;
+}
+
+/*
+ * Merge and write the rows of the window given by key and read the next
+ * row of every input that had one. An input without more rows is no
+ * longer selected.
+ */
+int merge_row(
+  FILE** inputs,
+  char** lines,
+  size_t* sizes,
+  bool* selected,
+  int count,
+  const char* key,
+  struct pm_sketch* sketches,
+  size_t rollups) {
+  struct pm_sketch sketch;
+  char text[PM_SKETCH_TEXT_SIZE];
+  char window[ROLLUP_KEY_SIZE + 1];
+  unsigned long long elapsed = 0, value;
+  long long processes = 0;
+  const char* p;
+  char* end;
+  size_t j;
+  int k;
+
+  memcpy(window, key, ROLLUP_KEY_SIZE);
+  window[ROLLUP_KEY_SIZE] = '\0';
+  for (j = 0; j < rollups; ++j) {
+    pm_sketch_reset(&sketches[j]);
+  }
+  for (k = 0; k < count; ++k) {
+    if (!selected[k] || strncmp(lines[k], window, ROLLUP_KEY_SIZE) != 0) {
+      continue;
+    }
+    p = lines[k] + ROLLUP_KEY_SIZE;
+    value = *p == ',' ? strtoull(p + 1, &end, 10) : 0;
+    elapsed = value > elapsed ? value : elapsed;
+    p = *p == ',' ? end : NULL;
+    for (j = 0; j < rollups && p != NULL; ++j) {
+      p = skip_fields(p, ROLLUP_TARGET_COUNT);
+      if (p == NULL || pm_sketch_parse(&sketch, p) != EXIT_SUCCESS) {
+        p = NULL;
+        break;
+      }
+      pm_sketch_merge(&sketches[j], &sketch);
+      p = strchr(p, ',');
+    }
+    if (p == NULL) {
+      fprintf(stderr, "The rollup row of %s is corrupt\n", window);
+      return EXIT_FAILURE;
+    }
+    processes += strtoll(p + 1, NULL, 10);
+    selected[k] = read_line(inputs[k], &lines[k], &sizes[k]) == EXIT_SUCCESS;
+  }
+
+  fprintf(output, "%s,%llu", window, elapsed);
+  for (j = 0; j < rollups; ++j) {
+    if (pm_sketch_format(&sketches[j], text, sizeof(text)) != EXIT_SUCCESS) {
+      fprintf(stderr, "Failed to format a rollup sketch\n");
+      return EXIT_FAILURE;
+    }
+    fprintf(
+      output,
+      ",%llu,%llu,%.1f,%llu,%llu,%llu,%s",
+      sketches[j].count > 0 ? sketches[j].min : 0ULL,
+      sketches[j].max,
+      sketches[j].count > 0 ?
+        (double)(sketches[j].sum) / (double)(sketches[j].count) : 0.0,
+      pm_sketch_quantile(&sketches[j], 0.50),
+      pm_sketch_quantile(&sketches[j], 0.95),
+      pm_sketch_quantile(&sketches[j], 0.99),
+      text);
+  }
+  if (fprintf(output, ",%lld\n", processes) < 0) {
+    fprintf(stderr, "Failed to write to the output file\n");
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/* The field after count more commas, or NULL if the line ends first */
+const char* skip_fields(const char* p, int count) {
+  while (p != NULL && count-- > 0) {
+    if ((p = strchr(p, ',')) != NULL) {
+      ++p;
+    }
+  }
+  return p;
+}
+
+/*
+ * Read the next line that is not empty, without its line break, into a
+ * buffer of size bytes that is grown as needed.
+ */
+int read_line(FILE* file, char** line, size_t* size) {
+  size_t length = 0;
+  char* grown;
+  if (*line == NULL) {
+    if ((*line = (char*)(malloc(TEXT_BUFFER_SIZE))) == NULL) {
+      return EXIT_FAILURE;
+    }
+    *size = TEXT_BUFFER_SIZE;
+  }
+  for (;;) {
+    if (fgets(*line + length, (int)(*size - length), file) == NULL) {
+      if (length == 0) {
+        return EXIT_FAILURE;
+      }
+      break;
+    }
+    length += strlen(*line + length);
+    while (length > 0 &&
+      ((*line)[length - 1] == '\n' || (*line)[length - 1] == '\r')) {
+      (*line)[--length] = '\0';
+    }
+    if (length + 1 < *size) {
+      if (length > 0) {
+        break;
+      }
+      continue;
+    }
+    if ((grown = (char*)(realloc(*line, 2 * *size))) == NULL) {
+      return EXIT_FAILURE;
+    }
+    *line = grown;
+    *size *= 2;
+  }
+  return EXIT_SUCCESS;
+}
+
+void store32(unsigned char* p, unsigned int value) {
+  p[0] = (unsigned char)(value);
+  p[1] = (unsigned char)(value >> 8);
+  p[2] = (unsigned char)(value >> 16);
+  p[3] = (unsigned char)(value >> 24);
+}
+
+unsigned int load32(const unsigned char* p) {
+  return (unsigned int)(p[0]) |
+    ((unsigned int)(p[1]) << 8) |
+    ((unsigned int)(p[2]) << 16) |
+    ((unsigned int)(p[3]) << 24);
+}
+
+unsigned long long load64(const unsigned char* p) {
+  return (unsigned long long)(load32(p)) |
+    ((unsigned long long)(load32(p + 4)) << 32);
+}
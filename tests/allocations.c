@@ -0,0 +1,306 @@
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <pm/context.h>
+
+#include "fixture.h"
+
+#define PM_TEST_PROCESSES 1400
+#define PM_TEST_HIDDEN_FROM 601
+#define PM_TEST_CHURN_PID 1000000
+#define PM_TEST_WARMUP_TICKS 3
+#define PM_TEST_TICKS 50
+#define PM_TEST_SETTLE_MS 200
+#define PM_TEST_PATH_SIZE 4096
+#define PM_TEST_OPTION_SIZE 256
+
+/*
+ * One way of running libpm. The options that are NULL are left at their
+ * defaults. With hide, the fixture processes from PM_TEST_HIDDEN_FROM are
+ * only shown after init, so the process tables reserved for the rest are
+ * too small and the overflow must be counted instead of growing them. A
+ * capacity below the fixture processes must overflow the same way.
+ */
+struct pm_test_config {
+  const char* name;
+  const char* format;
+  const char* output;
+  const char* top;
+  const char* by;
+  const char* trees;
+  const char* names;
+  const char* types;
+  const char* threads;
+  const char* cadence;
+  const char* adaptive;
+  const char* rollup;
+  const char* retention;
+  const char* rules;
+  const char* listen;
+  const char* share;
+  const char* capacity;
+  bool selfstats;
+  bool hide;
+};
+
+static const struct pm_test_config configs[] = {
+  { "top csv", "csv", "pm_test.csv", "20", "wss", NULL, NULL, "wss,pfc,cpu",
+    "2", NULL, NULL, NULL, "64", NULL, NULL, NULL, NULL, true, false },
+  { "tree pack", "pack", "pm_test.pack", NULL, NULL, "1", NULL, "wss,pss",
+    "3", "4", NULL, NULL, NULL, "wss>1M,wss+1K/h:4", "pm_test.sock", NULL,
+    NULL, false, false },
+  { "names rollup", "csv", "pm_test_rollup.csv", NULL, NULL, NULL,
+    "proc7;proc42", "wss,thr", "1", NULL, "16", "60", NULL, NULL, NULL,
+    NULL, NULL, false, false },
+  { "top bin", "bin", "pm_test.bin", "50", "pfc", NULL, NULL, "wss,pfc",
+    "4", NULL, NULL, NULL, NULL, NULL, NULL, "pm_test_allocations", NULL,
+    false, false },
+  { "top overflow", "csv", "pm_test_overflow.csv", "20", "wss", NULL, NULL,
+    "wss", "2", NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, false, true },
+  { "top capacity", "csv", "pm_test_capacity.csv", "20", "wss", NULL, NULL,
+    "wss", "2", NULL, NULL, NULL, NULL, NULL, NULL, NULL, "1000", false,
+    false }
+};
+
+/*
+ * malloc and its relatives are replaced for the whole process, also for
+ * the calls stdio and the threads make, and counted while counting is on.
+ */
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* p, size_t size);
+extern void __libc_free(void* p);
+
+static size_t counting = 0;
+static size_t calls = 0;
+
+void* malloc(size_t size) {
+  if (__atomic_load_n(&counting, __ATOMIC_ACQUIRE) != 0) {
+    __atomic_fetch_add(&calls, 1, __ATOMIC_RELAXED);
+  }
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+  if (__atomic_load_n(&counting, __ATOMIC_ACQUIRE) != 0) {
+    __atomic_fetch_add(&calls, 1, __ATOMIC_RELAXED);
+  }
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* p, size_t size) {
+  if (__atomic_load_n(&counting, __ATOMIC_ACQUIRE) != 0) {
+    __atomic_fetch_add(&calls, 1, __ATOMIC_RELAXED);
+  }
+  return __libc_realloc(p, size);
+}
+
+void free(void* p) {
+  if (p != NULL && __atomic_load_n(&counting, __ATOMIC_ACQUIRE) != 0) {
+    __atomic_fetch_add(&calls, 1, __ATOMIC_RELAXED);
+  }
+  __libc_free(p);
+}
+
+static int run(
+  const struct pm_test_config* config,
+  const char* fixture,
+  const char* directory);
+static int configure(
+  struct pm_context* context,
+  const struct pm_test_config* config,
+  const char* fixture,
+  const char* directory);
+static int set(
+  struct pm_context* context,
+  int (*setter)(struct pm_context*, char*),
+  const char* value);
+static void hide(const char* fixture, bool hidden);
+static void pause_ms(long ms);
+
+int main(int argc, char* argv[]) {
+  char fixture[PM_TEST_PATH_SIZE];
+  size_t k;
+  int result = EXIT_SUCCESS;
+
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s directory\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  snprintf(fixture, sizeof(fixture), "%s/pm_test_fixture", argv[1]);
+  if (pm_fixture_create(fixture, PM_TEST_PROCESSES) != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+  for (k = 0; k < sizeof(configs) / sizeof(configs[0]); ++k) {
+    if (run(&configs[k], fixture, argv[1]) != EXIT_SUCCESS) {
+      result = EXIT_FAILURE;
+    }
+  }
+  return result;
+}
+
+/*
+ * Warm up, then count every heap call of every thread over the steady
+ * ticks. A fixture process exits and a new one starts on every tick.
+ */
+int run(
+  const struct pm_test_config* config,
+  const char* fixture,
+  const char* directory) {
+  char churn[2][PM_TEST_PATH_SIZE];
+  struct pm_memory_count memory;
+  struct pm_context* context;
+  size_t counted;
+  int result = EXIT_FAILURE, k;
+
+  snprintf(churn[0], sizeof(churn[0]), "%s/%d", fixture, PM_TEST_PROCESSES);
+  snprintf(churn[1], sizeof(churn[1]), "%s/%d", fixture, PM_TEST_CHURN_PID);
+  rename(churn[1], churn[0]);
+  hide(fixture, config->hide);
+
+  if ((context = pm_create()) == NULL) {
+    return EXIT_FAILURE;
+  }
+  if (configure(context, config, fixture, directory) != EXIT_SUCCESS ||
+    pm_context_init(context) != EXIT_SUCCESS) {
+    fprintf(stderr, "Failed to initialize '%s'\n", config->name);
+    pm_destroy(context);
+    hide(fixture, false);
+    return EXIT_FAILURE;
+  }
+  pm_context_start(context);
+  for (k = 0; k < PM_TEST_WARMUP_TICKS; ++k) {
+    if (pm_sample(context, NULL) != EXIT_SUCCESS) {
+      break;
+    }
+  }
+  hide(fixture, false);
+  pause_ms(PM_TEST_SETTLE_MS);
+
+  if (k == PM_TEST_WARMUP_TICKS) {
+    __atomic_store_n(&calls, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&counting, 1, __ATOMIC_RELEASE);
+    for (k = 0; k < PM_TEST_TICKS; ++k) {
+      rename(churn[k % 2], churn[1 - k % 2]);
+      if (pm_sample(context, NULL) != EXIT_SUCCESS) {
+        break;
+      }
+    }
+    pause_ms(PM_TEST_SETTLE_MS);
+    __atomic_store_n(&counting, 0, __ATOMIC_RELEASE);
+    counted = __atomic_load_n(&calls, __ATOMIC_RELAXED);
+    pm_context_get_memory_count(context, &memory);
+    if (k != PM_TEST_TICKS) {
+      fprintf(stderr, "Failed to sample '%s'\n", config->name);
+    } else if (counted > 0) {
+      fprintf(
+        stderr,
+        "'%s' made %lu heap calls over %d steady ticks\n",
+        config->name,
+        (unsigned long)(counted),
+        PM_TEST_TICKS);
+    } else if ((config->hide || config->capacity != NULL) &&
+      memory.overflow == 0) {
+      fprintf(stderr, "'%s' counted no overflow\n", config->name);
+    } else {
+      printf(
+        "'%s' made no heap calls over %d steady ticks, %llu overflows\n",
+        config->name,
+        PM_TEST_TICKS,
+        memory.overflow);
+      result = EXIT_SUCCESS;
+    }
+  }
+  pm_context_stop(context);
+  pm_destroy(context);
+  rename(churn[1], churn[0]);
+  return result;
+}
+
+int configure(
+  struct pm_context* context,
+  const struct pm_test_config* config,
+  const char* fixture,
+  const char* directory) {
+  char path[PM_TEST_PATH_SIZE];
+  snprintf(path, sizeof(path), "%s/%s", directory, config->output);
+  if (set(context, pm_context_set_procfs, fixture) != EXIT_SUCCESS ||
+    set(context, pm_context_set_format, config->format) != EXIT_SUCCESS ||
+    set(context, pm_context_set_output, path) != EXIT_SUCCESS ||
+    set(context, pm_context_set_top, config->top) != EXIT_SUCCESS ||
+    set(context, pm_context_set_by, config->by) != EXIT_SUCCESS ||
+    set(context, pm_context_add_trees, config->trees) != EXIT_SUCCESS ||
+    set(context, pm_context_add_names, config->names) != EXIT_SUCCESS ||
+    set(context, pm_context_set_types, config->types) != EXIT_SUCCESS ||
+    set(context, pm_context_set_threads, config->threads) != EXIT_SUCCESS ||
+    set(context, pm_context_set_cadence, config->cadence) != EXIT_SUCCESS ||
+    set(context, pm_context_set_adaptive, config->adaptive) !=
+      EXIT_SUCCESS ||
+    set(context, pm_context_set_rollup, config->rollup) != EXIT_SUCCESS ||
+    set(context, pm_context_set_retention, config->retention) !=
+      EXIT_SUCCESS ||
+    set(context, pm_context_add_rules, config->rules) != EXIT_SUCCESS ||
+    set(context, pm_context_set_share, config->share) != EXIT_SUCCESS ||
+    set(context, pm_context_set_capacity, config->capacity) != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+  if (config->rules != NULL) {
+    snprintf(path, sizeof(path), "%s/pm_test_events.csv", directory);
+    if (set(context, pm_context_set_events, path) != EXIT_SUCCESS) {
+      return EXIT_FAILURE;
+    }
+  }
+  if (config->listen != NULL) {
+    snprintf(path, sizeof(path), "unix:%s/%s", directory, config->listen);
+    if (set(context, pm_context_set_listen, path) != EXIT_SUCCESS) {
+      return EXIT_FAILURE;
+    }
+  }
+  if (config->selfstats) {
+    snprintf(path, sizeof(path), "%s/pm_test_trace.json", directory);
+    if (pm_context_set_self_stats(context, 1) != EXIT_SUCCESS ||
+      set(context, pm_context_set_trace, path) != EXIT_SUCCESS) {
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+/* The setters may change the text they are given, so they get a copy */
+int set(
+  struct pm_context* context,
+  int (*setter)(struct pm_context*, char*),
+  const char* value) {
+  char option[PM_TEST_OPTION_SIZE];
+  if (value == NULL) {
+    return EXIT_SUCCESS;
+  }
+  snprintf(option, sizeof(option), "%s", value);
+  return setter(context, option);
+}
+
+/* A name that is not a number is not a process to libpm */
+void hide(const char* fixture, bool hidden) {
+  char shown[PM_TEST_PATH_SIZE];
+  char renamed[PM_TEST_PATH_SIZE];
+  int pid;
+  for (pid = PM_TEST_HIDDEN_FROM; pid <= PM_TEST_PROCESSES; ++pid) {
+    snprintf(shown, sizeof(shown), "%s/%d", fixture, pid);
+    snprintf(renamed, sizeof(renamed), "%s/hidden%d", fixture, pid);
+    if (hidden) {
+      rename(shown, renamed);
+    } else {
+      rename(renamed, shown);
+    }
+  }
+}
+
+void pause_ms(long ms) {
+  struct timespec wait;
+  wait.tv_sec = ms / 1000;
+  wait.tv_nsec = (ms % 1000) * 1000000L;
+  nanosleep(&wait, NULL);
+}
@@ -0,0 +1,232 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "parse.h"
+
+#define PM_TEST_UNTOUCHED 424242ULL
+#define PM_TEST_STAT_FIELDS \
+  (PM_PARSE_STAT_FIELD(PM_PARSE_STAT_PPID) | \
+  PM_PARSE_STAT_FIELD(PM_PARSE_STAT_MINFLT) | \
+  PM_PARSE_STAT_FIELD(PM_PARSE_STAT_MAJFLT) | \
+  PM_PARSE_STAT_FIELD(PM_PARSE_STAT_UTIME) | \
+  PM_PARSE_STAT_FIELD(PM_PARSE_STAT_STIME) | \
+  PM_PARSE_STAT_FIELD(PM_PARSE_STAT_THREADS) | \
+  PM_PARSE_STAT_FIELD(PM_PARSE_STAT_STARTTIME))
+#define PM_TEST_STATUS_KEYS \
+  (PM_PARSE_STATUS_KEY(PM_PARSE_STATUS_VMPEAK) | \
+  PM_PARSE_STATUS_KEY(PM_PARSE_STATUS_VMLCK) | \
+  PM_PARSE_STATUS_KEY(PM_PARSE_STATUS_VMHWM) | \
+  PM_PARSE_STATUS_KEY(PM_PARSE_STATUS_VMPTE))
+
+/* The fields of stat the monitor reads, in the order of PM_TEST_STAT_FIELDS */
+static const int pm_test_stat_field[] = {
+  PM_PARSE_STAT_PPID,
+  PM_PARSE_STAT_MINFLT,
+  PM_PARSE_STAT_MAJFLT,
+  PM_PARSE_STAT_UTIME,
+  PM_PARSE_STAT_STIME,
+  PM_PARSE_STAT_THREADS,
+  PM_PARSE_STAT_STARTTIME
+};
+
+#define PM_TEST_STAT_READ \
+  (sizeof(pm_test_stat_field) / sizeof(pm_test_stat_field[0]))
+
+/*
+ * A stat line as the kernel writes it, the comm it holds and the values of
+ * the fields read. A NULL comm is a line that is not a stat line, and a
+ * field the line ends before keeps its value.
+ */
+struct pm_test_stat {
+  const char* line;
+  const char* comm;
+  unsigned long long value[PM_TEST_STAT_READ];
+};
+
+static const struct pm_test_stat pm_test_stat_case[] = {
+  { "4242 (bash) S 4241 4242 4242 34816 4242 4194304 2001 0 3 0 405 106 "
+    "0 0 20 0 1 0 98765 12324864 1311 18446744073709551615\n",
+    "bash",
+    { 4241, 2001, 3, 405, 106, 1, 98765 } },
+  { "4243 () S 1 4243 4243 0 -1 4194560 11 0 0 0 0 0 0 0 20 0 1 0 500 "
+    "0 0 18446744073709551615\n",
+    "",
+    { 1, 11, 0, 0, 0, 1, 500 } },
+  { "4244 (a b c) R 2 0 0 0 -1 4194560 12 0 1 0 2 3 0 0 20 0 4 0 501 "
+    "0 0 0\n",
+    "a b c",
+    { 2, 12, 1, 2, 3, 4, 501 } },
+  { "4245 (a) S 1 2 3) S 3 0 0 0 -1 0 13 0 2 0 4 5 0 0 20 0 6 0 502\n",
+    "a) S 1 2 3",
+    { 3, 13, 2, 4, 5, 6, 502 } },
+  { "4246 () () S 4 0 0 0 -1 0 14 0 3 0 6 7 0 0 20 0 8 0 503\n",
+    ") (",
+    { 4, 14, 3, 6, 7, 8, 503 } },
+  { "4247 ((((() S 5 0 0 0 -1 0 15 0 4 0 8 9 0 0 20 0 10 0 504\n",
+    "((((",
+    { 5, 15, 4, 8, 9, 10, 504 } },
+  { "4248 ())))) S 6 0 0 0 -1 0 16 0 5 0 10 11 0 0 20 0 12 0 505\n",
+    "))))",
+    { 6, 16, 5, 10, 11, 12, 505 } },
+  { "4249 (x)) S 7 0 0 0 -1 0 17 0 6 0 12 13 0 0 20 0 14 0 506\n",
+    "x)",
+    { 7, 17, 6, 12, 13, 14, 506 } },
+  { "4250 ((x) S 8 0 0 0 -1 0 18 0 7 0 14 15 0 0 20 0 16 0 507\n",
+    "(x",
+    { 8, 18, 7, 14, 15, 16, 507 } },
+  { "4251 (12345 678) S 9 0 0 0 -1 0 19 0 8 0 16 17 0 0 20 0 18 0 508\n",
+    "12345 678",
+    { 9, 19, 8, 16, 17, 18, 508 } },
+  { "4252 (tab\there) S 10 0 0 0 -1 0 20 0 9 0 18 19 0 0 20 0 20 0 509\n",
+    "tab\there",
+    { 10, 20, 9, 18, 19, 20, 509 } },
+  { "4253 (new\nline) S 11 0 0 0 -1 0 21 0 10 0 20 21 0 0 20 0 22 0 510\n",
+    "new\nline",
+    { 11, 21, 10, 20, 21, 22, 510 } },
+  { "4254 (123456789012345) S 12 0 0 0 -1 0 22 0 11 0 22 23 0 0 20 0 24 0 "
+    "511\n",
+    "123456789012345",
+    { 12, 22, 11, 22, 23, 24, 511 } },
+  { "4255 () 9 9 9 9 9 9 9) S 13 0 0 0 -1 0 23 0 12 0 24 25 0 0 20 0 26 0 "
+    "512\n",
+    ") 9 9 9 9 9 9 9",
+    { 13, 23, 12, 24, 25, 26, 512 } },
+  { "4256 (kworker/u16:2) I 2 0 0 0 -1 69238880 0 0 0 0 18446744073709551615 "
+    "0 0 0 20 0 1 0 18446744073709551614\n",
+    "kworker/u16:2",
+    { 2, 0, 0, 18446744073709551615ULL, 0, 1, 18446744073709551614ULL } },
+  { "4257 (short) S 14 4257\n",
+    "short",
+    { 14, PM_TEST_UNTOUCHED, PM_TEST_UNTOUCHED, PM_TEST_UNTOUCHED,
+      PM_TEST_UNTOUCHED, PM_TEST_UNTOUCHED, PM_TEST_UNTOUCHED } },
+  { "4258 no comm S 1 0 0 0 -1 0 1 0 1 0 1 1 0 0 20 0 1 0 1\n",
+    NULL,
+    { PM_TEST_UNTOUCHED, PM_TEST_UNTOUCHED, PM_TEST_UNTOUCHED,
+      PM_TEST_UNTOUCHED, PM_TEST_UNTOUCHED, PM_TEST_UNTOUCHED,
+      PM_TEST_UNTOUCHED } },
+  { "4259 )reversed( S 1 0 0 0 -1 0 1 0 1 0 1 1 0 0 20 0 1 0 1\n",
+    NULL,
+    { PM_TEST_UNTOUCHED, PM_TEST_UNTOUCHED, PM_TEST_UNTOUCHED,
+      PM_TEST_UNTOUCHED, PM_TEST_UNTOUCHED, PM_TEST_UNTOUCHED,
+      PM_TEST_UNTOUCHED } }
+};
+
+/* A status file and the values of VmPeak, VmLck, VmHWM and VmPTE in kB */
+struct pm_test_status {
+  const char* text;
+  unsigned long long value[PM_PARSE_STATUS_KEY_COUNT];
+};
+
+static const struct pm_test_status pm_test_status_case[] = {
+  { "Name:\tbash\nUmask:\t0022\nState:\tS (sleeping)\nTgid:\t4242\n"
+    "Ngid:\t0\nPid:\t4242\nPPid:\t4241\nTracerPid:\t0\nUid:\t0\t0\t0\t0\n"
+    "Gid:\t0\t0\t0\t0\nFDSize:\t256\nGroups:\t0\nNStgid:\t4242\n"
+    "NSpid:\t4242\nNSpgid:\t4242\nNSsid:\t4242\nVmPeak:\t   12100 kB\n"
+    "VmSize:\t   12036 kB\nVmLck:\t       8 kB\nVmPin:\t       0 kB\n"
+    "VmHWM:\t    5320 kB\nVmRSS:\t    5244 kB\nRssAnon:\t    1752 kB\n"
+    "RssFile:\t    3492 kB\nRssShmem:\t       0 kB\nVmData:\t    1932 kB\n"
+    "VmStk:\t     132 kB\nVmExe:\t     892 kB\nVmLib:\t    1816 kB\n"
+    "VmPTE:\t      60 kB\nVmSwap:\t       0 kB\nThreads:\t1\n",
+    { 12100, 8, 5320, 60 } },
+  { "Name:\tVmPeak:\t1 kB\nUmask:\t0022\nState:\tS (sleeping)\n"
+    "VmPeak:\t  204800 kB\nVmSize:\t  204800 kB\nVmLck:\t       0 kB\n"
+    "VmHWM:\t   10240 kB\nVmPTE:\t     120 kB",
+    { 204800, 0, 10240, 120 } },
+  { "Name:\tkthreadd\nUmask:\t0000\nState:\tS (sleeping)\nTgid:\t2\n"
+    "Threads:\t1\nSigQ:\t0/63450\n",
+    { PM_TEST_UNTOUCHED, PM_TEST_UNTOUCHED, PM_TEST_UNTOUCHED,
+      PM_TEST_UNTOUCHED } }
+};
+
+static int pm_test_stat(void);
+static int pm_test_status(void);
+
+int main(int argc, char* argv[]) {
+  if (argc == 2 && strcmp(argv[1], "stat") == 0) {
+    return pm_test_stat();
+  }
+  if (argc == 2 && strcmp(argv[1], "status") == 0) {
+    return pm_test_status();
+  }
+  fprintf(stderr, "Usage: %s stat|status\n", argv[0]);
+  return EXIT_FAILURE;
+}
+
+int pm_test_stat(void) {
+  const size_t count =
+    sizeof(pm_test_stat_case) / sizeof(pm_test_stat_case[0]);
+  const struct pm_test_stat* test;
+  unsigned long long value[PM_PARSE_STAT_FIELD_COUNT];
+  const char* name;
+  size_t i, k, length, namelength;
+  int parsed, result = EXIT_SUCCESS;
+
+  for (i = 0; i < count; ++i) {
+    test = &pm_test_stat_case[i];
+    length = strlen(test->line);
+    for (k = 0; k < PM_PARSE_STAT_FIELD_COUNT; ++k) {
+      value[k] = PM_TEST_UNTOUCHED;
+    }
+    name = NULL;
+    namelength = 0;
+    if ((pm_parse_comm(test->line, length, &name, &namelength) != NULL) !=
+      (test->comm != NULL) ||
+      (test->comm != NULL && (namelength != strlen(test->comm) ||
+        memcmp(name, test->comm, namelength) != 0))) {
+      fprintf(stderr, "Stat line %zu gave the comm '%.*s'\n",
+        i, (int)(namelength), name != NULL ? name : "");
+      result = EXIT_FAILURE;
+      continue;
+    }
+    parsed = pm_parse_stat(test->line, length, PM_TEST_STAT_FIELDS, value);
+    if ((parsed == EXIT_SUCCESS) != (test->comm != NULL)) {
+      fprintf(stderr, "Stat line %zu was %s\n",
+        i, parsed == EXIT_SUCCESS ? "parsed" : "refused");
+      result = EXIT_FAILURE;
+      continue;
+    }
+    for (k = 0; k < PM_TEST_STAT_READ; ++k) {
+      if (value[pm_test_stat_field[k]] != test->value[k]) {
+        fprintf(stderr, "Stat line %zu gave %llu for field %d, not %llu\n",
+          i, value[pm_test_stat_field[k]], pm_test_stat_field[k],
+          test->value[k]);
+        result = EXIT_FAILURE;
+      }
+    }
+  }
+  if (result == EXIT_SUCCESS) {
+    printf("%zu stat lines parsed as expected\n", count);
+  }
+  return result;
+}
+
+int pm_test_status(void) {
+  const size_t count =
+    sizeof(pm_test_status_case) / sizeof(pm_test_status_case[0]);
+  unsigned long long value[PM_PARSE_STATUS_KEY_COUNT];
+  size_t i;
+  int k, result = EXIT_SUCCESS;
+
+  for (i = 0; i < count; ++i) {
+    for (k = 0; k < PM_PARSE_STATUS_KEY_COUNT; ++k) {
+      value[k] = PM_TEST_UNTOUCHED;
+    }
+    pm_parse_status(
+      pm_test_status_case[i].text,
+      strlen(pm_test_status_case[i].text),
+      PM_TEST_STATUS_KEYS,
+      value);
+    for (k = 0; k < PM_PARSE_STATUS_KEY_COUNT; ++k) {
+      if (value[k] != pm_test_status_case[i].value[k]) {
+        fprintf(stderr, "Status file %zu gave %llu for key %d, not %llu\n",
+          i, value[k], k, pm_test_status_case[i].value[k]);
+        result = EXIT_FAILURE;
+      }
+    }
+  }
+  if (result == EXIT_SUCCESS) {
+    printf("%zu status files parsed as expected\n", count);
+  }
+  return result;
+}